@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Keeps the compiler from optimizing away a value computed by a benchmarked kernel
+template <typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char *>(&value);
+#endif
+}
+
+struct BenchOptions {
+    int repetitions = 10;     // timed repetitions per benchmark; statistics are taken over these
+    double warmupMs = 100;    // untimed run before the first repetition (caches, branch predictors, CPU clock)
+    double minRepMs = 20;     // each repetition runs the kernel for at least this long
+    std::string filter;       // only benchmarks whose name contains this string are run
+};
+
+struct BenchResult {
+    std::string name;
+    std::string unit;         // what one operation is, e.g. "rays"
+    double medianNs = 0;      // ns per operation
+    double meanNs = 0;
+    double stddevNs = 0;
+    double minNs = 0;
+    double opsPerSec = 0;     // from the median
+};
+
+/**
+ * @brief runBenchmark times fn, which performs opsPerCall operations per call. fn is first run for the warmup period,
+ *          which also sizes the repetitions: every repetition makes the same number of calls, chosen so that it lasts
+ *          at least options.minRepMs.
+ */
+template <typename Fn>
+BenchResult runBenchmark(const std::string &name, const std::string &unit, const BenchOptions &options,
+                         std::size_t opsPerCall, Fn &&fn) {
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [](Clock::time_point start) {
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    };
+
+    // warm up and estimate the cost of one call
+    std::size_t warmupCalls = 0;
+    Clock::time_point warmupStart = Clock::now();
+    do {
+        fn();
+        warmupCalls++;
+    } while (elapsedNs(warmupStart) < options.warmupMs * 1e6);
+    double nsPerCall = elapsedNs(warmupStart) / warmupCalls;
+    std::size_t callsPerRep = std::max<std::size_t>(1, std::size_t(std::ceil(options.minRepMs * 1e6 / nsPerCall)));
+
+    std::vector<double> samples{};
+    for (int rep = 0; rep < std::max(1, options.repetitions); rep++) {
+        Clock::time_point start = Clock::now();
+        for (std::size_t call = 0; call < callsPerRep; call++) {
+            fn();
+        }
+        samples.push_back(elapsedNs(start) / double(callsPerRep * opsPerCall));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    BenchResult result{name, unit};
+    std::size_t n = samples.size();
+    result.medianNs = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    result.minNs = samples.front();
+    for (double sample : samples) {
+        result.meanNs += sample / n;
+    }
+    for (double sample : samples) {
+        result.stddevNs += (sample - result.meanNs) * (sample - result.meanNs) / std::max<std::size_t>(1, n - 1);
+    }
+    result.stddevNs = std::sqrt(result.stddevNs);
+    result.opsPerSec = 1e9 / result.medianNs;
+    return result;
+}
+
+inline void printBenchHeader() {
+    std::cout << std::left << std::setw(44) << "benchmark" << std::right
+              << std::setw(12) << "ns/op" << std::setw(10) << "stddev" << std::setw(12) << "min ns/op"
+              << std::setw(16) << "throughput" << std::endl;
+}
+
+inline void printBenchResult(const BenchResult &result) {
+    double relativeStddev = result.meanNs > 0 ? 100 * result.stddevNs / result.meanNs : 0;
+    std::cout << std::left << std::setw(44) << result.name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << result.medianNs
+              << std::setprecision(1) << std::setw(9) << relativeStddev << "%"
+              << std::setprecision(2) << std::setw(12) << result.minNs
+              << std::setprecision(2) << std::setw(10) << result.opsPerSec / 1e6 << " M " << result.unit << "/s"
+              << std::defaultfloat << std::endl;
+}
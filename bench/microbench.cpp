@@ -0,0 +1,373 @@
+// Microbenchmarks for the per-ray kernels of the ray tracer: primitive intersection, the quadratic solver, texture
+// lookups, spot light falloff, Phong shading and the Phong light kernel. Inputs are generated from fixed seeds, so runs are comparable.
+//
+// usage: raytracer_bench [--filter <substring>] [--repetitions <n>] [--warmup-ms <ms>] [--min-time-ms <ms>]
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include "benchharness.h"
+#include "lights/light.h"
+#include "lights/lightgrid.h"
+#include "lights/lighttable.h"
+#include "primitives/primitive.h"
+#include "ray/ray.h"
+#include "raytracer/phongkernel.h"
+#include "raytracer/raytracer.h"
+#include "texture/texture.h"
+
+// Reaches the private members of RayTracer (befriended in raytracer.h)
+class RayTracerBenchAccess {
+public:
+    // Makes lights the lights that phong shades with, as binding a scene would
+    static void bindLights(RayTracer &raytracer, const LightTable &lights, const LightGrid &grid) {
+        raytracer.m_lightTable = &lights;
+        raytracer.m_lightGrid = &grid;
+    }
+
+    // Shades one point (phong never spawns reflection rays)
+    static SceneColor phong(RayTracer &raytracer, vec3 position, vec3 normal, vec3 directionToCamera,
+                            const ShadingMaterial &material) {
+        return raytracer.phong(position, normal, directionToCamera, material, SceneColor(1), 0);
+    }
+};
+
+namespace {
+
+// Exposes the protected quadratic solver
+class QuadraticProbe : public Sphere {
+public:
+    using Primitive::solveQuadratic;
+};
+
+enum class RayDistribution {
+    Hit,     // aimed at points near the center of the primitive
+    Miss,    // passing at least 1 unit from the center, outside every unit primitive
+    Grazing  // passing 0.5 units from the center (within 0.1%): tangent to the sphere, near the other silhouettes
+};
+
+const int rayCount = 4096;
+
+vec3 randomUnitVector(std::mt19937 &rng) {
+    std::normal_distribution<float> normal(0.f, 1.f);
+    vec3 v;
+    do {
+        v = vec3(normal(rng), normal(rng), normal(rng));
+    } while (length(v) < 1e-6f);
+    return normalize(v);
+}
+
+/**
+ * @brief makeRays generates object-space rays starting 3 units from the origin, in the given distribution
+ */
+std::vector<Ray> makeRays(RayDistribution distribution, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<Ray> rays{};
+    rays.reserve(rayCount);
+    for (int i = 0; i < rayCount; i++) {
+        vec3 origin = 3.f * randomUnitVector(rng);
+        vec3 towardCenter = normalize(-origin);
+        // offset of the aimed-at point from the center, perpendicular to the ray
+        vec3 side = randomUnitVector(rng);
+        side = normalize(side - dot(side, towardCenter) * towardCenter);
+        float offset = 0;
+        switch (distribution) {
+            case RayDistribution::Hit:
+                offset = 0.2f * uniform(rng);
+                break;
+            case RayDistribution::Miss:
+                offset = 1.f + uniform(rng);
+                break;
+            case RayDistribution::Grazing:
+                offset = 0.5f * (1.f + 2e-3f * (uniform(rng) - 0.5f));
+                break;
+        }
+        vec3 target = offset * side;
+        rays.emplace_back(normalize(target - origin), origin);
+    }
+    return rays;
+}
+
+RenderShapeData makeShapeData(PrimitiveType type) {
+    RenderShapeData shapeData{};
+    shapeData.primitive.type = type;
+    shapeData.primitive.material.clear();
+    shapeData.ctm = mat4(1.f);
+    return shapeData;
+}
+
+std::vector<Light> makeLights(int count, std::optional<LightType> type = std::nullopt) {
+    std::vector<Light> lights{};
+    for (int i = 0; i < count; i++) {
+        SceneLightData lightData{};
+        lightData.id = i;
+        lightData.type = type.value_or(LightType(i % 3)); // by default point, directional and spot lights in turn
+        lightData.color = SceneColor(0.5f, 0.5f, 0.5f, 1);
+        lightData.function = vec3(1, 0.1f, 0.01f);
+        float angle = 2 * float(M_PI) * i / count;
+        lightData.pos = vec4(3 * std::cos(angle), 3, 3 * std::sin(angle), 1);
+        lightData.dir = vec4(-lightData.pos.x, -lightData.pos.y, -lightData.pos.z, 0);
+        lightData.angle = 0.6f;
+        lightData.penumbra = 0.2f;
+        lights.emplace_back(lightData);
+    }
+    return lights;
+}
+
+void intersectionBenchmarks(const BenchOptions &options, std::vector<BenchResult> &results) {
+    std::map<std::string, std::shared_ptr<Texture>> textures{};
+    MaterialTable materials{};
+    struct Candidate {
+        std::string name;
+        std::shared_ptr<Primitive> primitive;
+    };
+    std::vector<Candidate> primitives = {
+        {"Sphere",   std::make_shared<Sphere>(makeShapeData(PrimitiveType::PRIMITIVE_SPHERE), textures, materials, 0.5f)},
+        {"Cube",     std::make_shared<Cube>(makeShapeData(PrimitiveType::PRIMITIVE_CUBE), textures, materials, 1.f)},
+        {"Cone",     std::make_shared<Cone>(makeShapeData(PrimitiveType::PRIMITIVE_CONE), textures, materials, 0.5f, 1.f)},
+        {"Cylinder", std::make_shared<Cylinder>(makeShapeData(PrimitiveType::PRIMITIVE_CYLINDER), textures, materials, 1.f, 0.5f)},
+    };
+    std::pair<const char *, RayDistribution> distributions[] = {
+        {"hit", RayDistribution::Hit}, {"miss", RayDistribution::Miss}, {"grazing", RayDistribution::Grazing}
+    };
+
+    for (const Candidate &candidate : primitives) {
+        for (auto [distributionName, distribution] : distributions) {
+            std::string name = candidate.name + "::getIntersectionT/" + distributionName;
+            if (name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            std::vector<Ray> rays = makeRays(distribution, 42);
+            const Primitive &primitive = *candidate.primitive;
+            results.push_back(runBenchmark(name, "rays", options, rays.size(), [&]() {
+                for (const Ray &ray : rays) {
+                    doNotOptimize(primitive.getIntersectionT(ray));
+                }
+            }));
+            printBenchResult(results.back());
+        }
+    }
+}
+
+void quadraticBenchmark(const BenchOptions &options, std::vector<BenchResult> &results) {
+    std::string name = "Primitive::solveQuadratic/mixed";
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    // coefficients of the sphere equation for a mix of hitting and missing rays
+    std::vector<vec3> coefficients{};
+    for (RayDistribution distribution : {RayDistribution::Hit, RayDistribution::Miss, RayDistribution::Grazing}) {
+        for (const Ray &ray : makeRays(distribution, 7)) {
+            vec3 d = ray.getDir();
+            vec3 p = ray.getOrigin();
+            coefficients.emplace_back(dot(d, d), 2 * dot(p, d), dot(p, p) - 0.25f);
+        }
+    }
+    QuadraticProbe probe;
+    results.push_back(runBenchmark(name, "ops", options, coefficients.size(), [&]() {
+        for (const vec3 &c : coefficients) {
+            doNotOptimize(probe.solveQuadratic(c.x, c.y, c.z));
+        }
+    }));
+    printBenchResult(results.back());
+}
+
+void textureBenchmarks(const BenchOptions &options, std::vector<BenchResult> &results) {
+    // 512x512 checkerboard, large enough that random lookups miss the L1 cache
+    const int size = 512;
+    std::vector<RGBA> pixels(size * size);
+    for (int row = 0; row < size; row++) {
+        for (int col = 0; col < size; col++) {
+            std::uint8_t value = ((row / 32 + col / 32) % 2) ? 255 : 0;
+            pixels[row * size + col] = RGBA{value, value, std::uint8_t(row), 255};
+        }
+    }
+    Texture texture(size, size, pixels);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<vec2> uvs(rayCount);
+    for (vec2 &uv : uvs) {
+        uv = vec2(uniform(rng), uniform(rng));
+    }
+
+    for (int repeat : {1, 4}) {
+        std::string name = "Texture::getTextureColorAtUV/repeat" + std::to_string(repeat);
+        if (name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        results.push_back(runBenchmark(name, "lookups", options, uvs.size(), [&]() {
+            for (const vec2 &uv : uvs) {
+                doNotOptimize(texture.getTextureColorAtUV(uv, repeat, repeat));
+            }
+        }));
+        printBenchResult(results.back());
+    }
+}
+
+void spotLightBenchmarks(const BenchOptions &options, std::vector<BenchResult> &results) {
+    SceneLightData lightData{};
+    lightData.type = LightType::LIGHT_SPOT;
+    lightData.color = SceneColor(1);
+    lightData.function = vec3(1, 0, 0);
+    lightData.pos = vec4(0, 3, 0, 1);
+    lightData.dir = vec4(0, -1, 0, 0);
+    lightData.angle = 0.5f;
+    lightData.penumbra = 0.2f;
+    Light light(lightData);
+
+    // points on the ground plane: "mixed" covers the inner cone, the penumbra and the unlit outside in proportion to
+    // their areas, "penumbra" only hits the smooth falloff
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    auto pointsBetweenAngles = [&](float minAngle, float maxAngle) {
+        std::vector<vec3> points(rayCount);
+        for (vec3 &point : points) {
+            float angle = minAngle + (maxAngle - minAngle) * uniform(rng);
+            float azimuth = 2 * float(M_PI) * uniform(rng);
+            float radius = 3 * std::tan(angle);
+            point = vec3(radius * std::cos(azimuth), 0, radius * std::sin(azimuth));
+        }
+        return points;
+    };
+    std::pair<std::string, std::vector<vec3>> cases[] = {
+        {"mixed", pointsBetweenAngles(0.f, 0.8f)},
+        {"penumbra", pointsBetweenAngles(0.31f, 0.49f)},
+    };
+
+    for (const auto &spotCase : cases) {
+        std::string name = "Light::getColor/spot-" + spotCase.first;
+        if (name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        const std::vector<vec3> &points = spotCase.second;
+        results.push_back(runBenchmark(name, "ops", options, points.size(), [&]() {
+            for (const vec3 &point : points) {
+                doNotOptimize(light.getColor(point));
+            }
+        }));
+        printBenchResult(results.back());
+    }
+}
+
+void phongBenchmarks(const BenchOptions &options, std::vector<BenchResult> &results) {
+    // the ray tracer is not bound to a scene, so shadow rays test no primitives: this times the shading itself
+    RayTracer::Config config{};
+    config.enableShadow = true;
+    RayTracer raytracer{ config };
+    SceneGlobalData globalData{0.5f, 0.5f, 0.5f, 0};
+    SceneMaterial material{};
+    material.clear();
+    material.cAmbient = SceneColor(0.1f, 0.1f, 0.1f, 1);
+    material.cDiffuse = SceneColor(0.8f, 0.3f, 0.2f, 1);
+    material.cSpecular = SceneColor(1);
+    material.shininess = 25;
+    MaterialTable materials{ globalData };
+    const ShadingMaterial &shadingMaterial = materials[materials.intern(material)];
+
+    // surface points on the unit sphere, seen from a camera at +z
+    std::mt19937 rng(17);
+    struct ShadingPoint {
+        vec3 position;
+        vec3 normal;
+        vec3 directionToCamera;
+    };
+    std::vector<ShadingPoint> points(1024);
+    for (ShadingPoint &point : points) {
+        point.normal = randomUnitVector(rng);
+        point.position = 0.5f * point.normal;
+        point.directionToCamera = normalize(vec3(0, 0, 5) - point.position);
+    }
+
+    for (int lightCount : {1, 3, 8}) {
+        std::string name = "RayTracer::phong/" + std::to_string(lightCount) + "-lights";
+        if (name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        std::vector<Light> lights = makeLights(lightCount);
+        LightTable lightTable(lights);
+        LightGrid lightGrid(lightTable, AABB{}); // without a cutoff every light is global
+        RayTracerBenchAccess::bindLights(raytracer, lightTable, lightGrid);
+        results.push_back(runBenchmark(name, "shades", options, points.size(), [&]() {
+            for (const ShadingPoint &point : points) {
+                doNotOptimize(RayTracerBenchAccess::phong(raytracer, point.position, point.normal, point.directionToCamera,
+                                                          shadingMaterial));
+            }
+        }));
+        printBenchResult(results.back());
+    }
+
+    // the light kernel alone, on a full block of 8 lights of one type and of mixed types
+    PhongKernel::SurfaceTerms surface{shadingMaterial.diffuse, shadingMaterial.specular, shadingMaterial.shininess};
+    using Kernel = void (*)(const LightBlock &, const glm::vec3 &, const glm::vec3 &, const glm::vec3 &,
+                            const PhongKernel::SurfaceTerms &, PhongKernel::LightSamples &);
+    std::vector<std::pair<std::string, Kernel>> kernels{{"scalar", PhongKernel::shadeLightsScalar}};
+    if (PhongKernel::simdAvailable()) {
+        kernels.push_back({"avx2", PhongKernel::shadeLightsAvx2});
+    }
+    std::vector<std::pair<std::string, LightTable>> blocks{};
+    blocks.emplace_back("point", LightTable(makeLights(PhongKernel::lanes, LightType::LIGHT_POINT)));
+    blocks.emplace_back("mixed", LightTable(makeLights(PhongKernel::lanes)));
+    for (const auto &[kernelName, kernel] : kernels) {
+        for (const auto &[blockName, lightTable] : blocks) {
+            std::string name = "PhongKernel::shadeLights/" + kernelName + "-" + blockName;
+            if (name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            const LightBlock &block = lightTable.blocks()[0];
+            PhongKernel::LightSamples samples;
+            results.push_back(runBenchmark(name, "blocks", options, points.size(), [&]() {
+                for (const ShadingPoint &point : points) {
+                    kernel(block, point.position, point.normal, point.directionToCamera, surface, samples);
+                    doNotOptimize(samples.r[0]);
+                }
+            }));
+            printBenchResult(results.back());
+        }
+    }
+}
+
+void printUsage() {
+    std::cerr << "usage: raytracer_bench [--filter <substring>] [--repetitions <n>] [--warmup-ms <ms>] [--min-time-ms <ms>]" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options{};
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--filter") && hasValue) {
+            options.filter = argv[++i];
+        } else if (!std::strcmp(argv[i], "--repetitions") && hasValue) {
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--warmup-ms") && hasValue) {
+            options.warmupMs = std::atof(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--min-time-ms") && hasValue) {
+            options.minRepMs = std::atof(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::cout << options.repetitions << " repetitions of at least " << options.minRepMs << " ms after a "
+              << options.warmupMs << " ms warmup; ns/op is the median" << std::endl;
+    printBenchHeader();
+    std::vector<BenchResult> results{};
+    intersectionBenchmarks(options, results);
+    quadraticBenchmark(options, results);
+    textureBenchmarks(options, results);
+    spotLightBenchmarks(options, results);
+    phongBenchmarks(options, results);
+
+    if (results.empty()) {
+        std::cerr << "No benchmark matches the filter \"" << options.filter << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
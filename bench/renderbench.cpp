@@ -0,0 +1,355 @@
+// End-to-end render benchmark: renders every scene file of a directory at fixed resolutions with several feature-flag
+// combinations, writes the timings as JSON and optionally compares them against a stored baseline report.
+//
+// usage: raytracer_renderbench [--scenes <dir>] [--resolutions 320x240,640x480] [--configs serial,parallel,...]
+//                              [--repetitions <n>] [--filter <substring>] [--output <report.json>]
+//                              [--baseline <report.json>] [--threshold <fraction>]
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+#if defined(__linux__)
+#include <fstream>
+#include <string>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "stats/raystats.h"
+#include "utils/sceneparser.h"
+
+#ifndef RAYTRACER_SOURCE_DIR
+#define RAYTRACER_SOURCE_DIR "."
+#endif
+
+namespace {
+
+// A named combination of feature flags
+struct BenchConfig {
+    QString name;
+    RayTracer::Config rtConfig;
+};
+
+std::vector<BenchConfig> allConfigs() {
+    RayTracer::Config serial{};
+    RayTracer::Config parallel{};
+    parallel.enableParallelism = true;
+    RayTracer::Config parallelAccel = parallel;
+    parallelAccel.enableAcceleration = true;
+    RayTracer::Config full = parallelAccel;
+    full.enableShadow = true;
+    full.enableReflection = true;
+    full.enableTextureMap = true;
+    return {{"serial", serial}, {"parallel", parallel}, {"parallel-accel", parallelAccel}, {"full", full}};
+}
+
+// One scene rendered at one resolution with one config; times are medians over the repetitions
+struct BenchRun {
+    QString scene;
+    int width = 0;
+    int height = 0;
+    QString config;
+    qint64 primitives = 0;
+    qint64 lights = 0;
+    double parseMs = 0;
+    double buildMs = 0;   // primitives, BVH and texture decoding
+    double renderMs = 0;
+    int threads = 1;      // worker threads of the tile scheduler; 1 for serial renders
+    RayCounts rays;
+    qint64 peakRssKb = -1; // -1 if the platform does not report it
+
+    QString key() const {
+        return QString("%1@%2x%3/%4").arg(scene).arg(width).arg(height).arg(config);
+    }
+};
+
+/**
+ * @brief resetPeakRss restarts peak resident set size tracking, so that each run reports its own peak. Only Linux
+ *          supports this; elsewhere the reported peak is the highest since the process started.
+ */
+void resetPeakRss() {
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+/**
+ * @brief peakRssKb returns the peak resident set size of this process in KiB, or -1 if unavailable
+ */
+qint64 peakRssKb() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoll(line.substr(6));
+        }
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+double elapsedMs(const QElapsedTimer &timer) {
+    return timer.nsecsElapsed() / 1e6;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    std::size_t n = values.size();
+    return (n % 2) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+/**
+ * @brief runScene parses, builds and renders one scene repetitions times
+ * @return false if the scene could not be parsed
+ */
+bool runScene(const QString &scenePath, int width, int height, const BenchConfig &config, int repetitions, BenchRun &run) {
+    std::vector<double> parseMs{}, buildMs{}, renderMs{};
+    qint64 peakKb = -1;
+    resetPeakRss();
+    for (int rep = 0; rep < repetitions; rep++) {
+        QElapsedTimer timer;
+        timer.start();
+        RenderData metaData;
+        if (!SceneParser::parse(scenePath.toStdString(), metaData)) {
+            return false;
+        }
+        parseMs.push_back(elapsedMs(timer));
+        run.primitives = qint64(metaData.shapes.size());
+        run.lights = qint64(metaData.lights.size());
+
+        timer.restart();
+        RayTraceScene scene{ width, height, metaData };
+        scene.waitForTextures();
+        buildMs.push_back(elapsedMs(timer));
+
+        std::vector<SceneColor> framebuffer(std::size_t(width) * height);
+        RayTracer raytracer{ config.rtConfig };
+        RayCounts raysBefore = RayStats::snapshot();
+        timer.restart();
+        raytracer.render(framebuffer.data(), scene);
+        renderMs.push_back(elapsedMs(timer));
+        // every repetition traces the same rays
+        run.rays = RayStats::snapshot() - raysBefore;
+        const TileScheduleStats *scheduleStats = raytracer.lastScheduleStats();
+        run.threads = scheduleStats ? int(scheduleStats->workers.size()) : 1;
+        peakKb = std::max(peakKb, peakRssKb());
+    }
+    run.parseMs = median(parseMs);
+    run.buildMs = median(buildMs);
+    run.renderMs = median(renderMs);
+    run.peakRssKb = peakKb;
+    return true;
+}
+
+QJsonObject toJson(const BenchRun &run) {
+    double renderSecs = std::max(run.renderMs, 1e-6) / 1000;
+    QJsonObject raysPerSec{
+        {"primary", run.rays.primary / renderSecs},
+        {"shadow", run.rays.shadow / renderSecs},
+        {"reflection", run.rays.reflection / renderSecs},
+        {"total", run.rays.total() / renderSecs},
+    };
+    QJsonObject rays{
+        {"primary", qint64(run.rays.primary)},
+        {"shadow", qint64(run.rays.shadow)},
+        {"reflection", qint64(run.rays.reflection)},
+    };
+    return QJsonObject{
+        {"key", run.key()},
+        {"scene", run.scene},
+        {"width", run.width},
+        {"height", run.height},
+        {"config", run.config},
+        {"primitives", run.primitives},
+        {"lights", run.lights},
+        {"parseMs", run.parseMs},
+        {"buildMs", run.buildMs},
+        {"renderMs", run.renderMs},
+        {"threads", run.threads},
+        {"rays", rays},
+        {"raysPerSec", raysPerSec},
+        {"peakRssKb", run.peakRssKb},
+    };
+}
+
+/**
+ * @brief compareWithBaseline prints the change of every timing relative to the baseline report and flags slowdowns
+ *          beyond the threshold. Differences under 2 ms are treated as noise.
+ * @return the number of regressions
+ */
+int compareWithBaseline(const std::vector<BenchRun> &runs, const QJsonObject &baseline, double threshold) {
+    std::map<QString, QJsonObject> baselineRuns{};
+    for (const QJsonValue &value : baseline["runs"].toArray()) {
+        QJsonObject run = value.toObject();
+        baselineRuns[run["key"].toString()] = run;
+    }
+
+    const double noiseFloorMs = 2;
+    int regressions = 0;
+    std::cout << std::endl << "Comparison with the baseline (threshold " << threshold * 100 << "%):" << std::endl;
+    for (const BenchRun &run : runs) {
+        auto found = baselineRuns.find(run.key());
+        if (found == baselineRuns.end()) {
+            std::cout << "  " << run.key().toStdString() << ": not in the baseline" << std::endl;
+            continue;
+        }
+        std::pair<const char *, double> metrics[] = {{"parseMs", run.parseMs}, {"buildMs", run.buildMs}, {"renderMs", run.renderMs}};
+        for (auto [metric, current] : metrics) {
+            double previous = found->second[metric].toDouble();
+            double change = previous > 0 ? current / previous - 1 : 0;
+            bool regressed = change > threshold && current - previous > noiseFloorMs;
+            regressions += regressed;
+            std::cout << "  " << (regressed ? "REGRESSION " : "           ") << run.key().toStdString() << " " << metric
+                      << ": " << std::fixed << std::setprecision(1) << previous << " -> " << current << " ms ("
+                      << std::showpos << change * 100 << std::noshowpos << "%)" << std::defaultfloat << std::endl;
+        }
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption scenesOption("scenes", "Directory of scene files to render.", "dir", RAYTRACER_SOURCE_DIR "/scenefiles/xml");
+    QCommandLineOption resolutionsOption("resolutions", "Comma-separated canvas sizes.", "WxH,...", "320x240,640x480");
+    QCommandLineOption configsOption("configs", "Comma-separated feature-flag combinations: serial, parallel, parallel-accel, full.", "names", "serial,parallel,parallel-accel,full");
+    QCommandLineOption repetitionsOption("repetitions", "Renders per scene, resolution and config; the median is reported.", "n", "1");
+    QCommandLineOption filterOption("filter", "Only render scenes whose file name contains this string.", "substring");
+    QCommandLineOption outputOption("output", "Path of the JSON report.", "file", "renderbench.json");
+    QCommandLineOption baselineOption("baseline", "JSON report of an earlier run to compare against.", "file");
+    QCommandLineOption thresholdOption("threshold", "Relative slowdown reported as a regression.", "fraction", "0.1");
+    parser.addOptions({scenesOption, resolutionsOption, configsOption, repetitionsOption, filterOption, outputOption,
+                       baselineOption, thresholdOption});
+    parser.process(a);
+
+    std::vector<std::pair<int, int>> resolutions{};
+    for (const QString &resolution : parser.value(resolutionsOption).split(',', Qt::SkipEmptyParts)) {
+        QStringList size = resolution.split('x');
+        int width = size.size() == 2 ? size[0].toInt() : 0;
+        int height = size.size() == 2 ? size[1].toInt() : 0;
+        if (width <= 0 || height <= 0) {
+            std::cerr << "Error: invalid resolution \"" << resolution.toStdString() << "\", expected WxH" << std::endl;
+            return 1;
+        }
+        resolutions.emplace_back(width, height);
+    }
+
+    std::vector<BenchConfig> configs{};
+    for (const QString &name : parser.value(configsOption).split(',', Qt::SkipEmptyParts)) {
+        std::vector<BenchConfig> known = allConfigs();
+        auto found = std::find_if(known.begin(), known.end(), [&name](const BenchConfig &config) { return config.name == name; });
+        if (found == known.end()) {
+            std::cerr << "Error: unknown config \"" << name.toStdString() << "\"" << std::endl;
+            return 1;
+        }
+        configs.push_back(*found);
+    }
+
+    QDir sceneDir(parser.value(scenesOption));
+    QStringList sceneFiles = sceneDir.entryList(QStringList{"*.xml"}, QDir::Files, QDir::Name);
+    if (parser.isSet(filterOption)) {
+        sceneFiles = sceneFiles.filter(parser.value(filterOption));
+    }
+    if (sceneFiles.isEmpty()) {
+        std::cerr << "Error: no scene files in \"" << sceneDir.absolutePath().toStdString() << "\"" << std::endl;
+        return 1;
+    }
+    int repetitions = std::max(1, parser.value(repetitionsOption).toInt());
+
+    std::vector<BenchRun> runs{};
+    bool success = true;
+    for (const QString &sceneFile : sceneFiles) {
+        bool loaded = true;
+        for (auto [width, height] : resolutions) {
+            for (const BenchConfig &config : configs) {
+                if (!loaded) {
+                    break;
+                }
+                BenchRun run{};
+                run.scene = QFileInfo(sceneFile).completeBaseName();
+                run.width = width;
+                run.height = height;
+                run.config = config.name;
+                if (!runScene(sceneDir.filePath(sceneFile), width, height, config, repetitions, run)) {
+                    std::cerr << "Error loading scene: \"" << sceneFile.toStdString() << "\"" << std::endl;
+                    success = false;
+                    loaded = false;
+                    continue;
+                }
+                std::cout << std::left << std::setw(40) << run.key().toStdString() << std::right << std::fixed
+                          << std::setprecision(1) << " parse " << std::setw(7) << run.parseMs << " ms  build "
+                          << std::setw(7) << run.buildMs << " ms  render " << std::setw(9) << run.renderMs << " ms  "
+                          << std::setprecision(2) << run.rays.total() / (std::max(run.renderMs, 1e-6) * 1000)
+                          << " M rays/s" << std::defaultfloat << std::endl;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    QJsonArray runArray;
+    int threads = 1; // of the parallel configs
+    for (const BenchRun &run : runs) {
+        runArray.append(toJson(run));
+        threads = std::max(threads, run.threads);
+    }
+    QJsonObject report{
+        {"version", 1},
+        {"threads", threads},
+        {"repetitions", repetitions},
+        {"runs", runArray},
+    };
+    QFile reportFile(parser.value(outputOption));
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        reportFile.write(QJsonDocument(report).toJson()) < 0) {
+        std::cerr << "Error: failed to write \"" << parser.value(outputOption).toStdString() << "\"" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << runs.size() << " runs to \"" << parser.value(outputOption).toStdString() << "\"" << std::endl;
+
+    if (parser.isSet(baselineOption)) {
+        QFile baselineFile(parser.value(baselineOption));
+        QJsonDocument baseline;
+        if (baselineFile.open(QIODevice::ReadOnly)) {
+            baseline = QJsonDocument::fromJson(baselineFile.readAll());
+        }
+        if (!baseline.isObject()) {
+            std::cerr << "Error: could not read the baseline \"" << parser.value(baselineOption).toStdString() << "\"" << std::endl;
+            return 1;
+        }
+        int regressions = compareWithBaseline(runs, baseline.object(), parser.value(thresholdOption).toDouble());
+        std::cout << regressions << " regression(s)" << std::endl;
+        success = success && regressions == 0;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+// Thread-scaling benchmark: renders one scene with 1, 2, 4, ... N worker threads and reports strong-scaling speedup
+// and efficiency, per-thread busy and idle time, tile steals, load imbalance and lock contention.
+//
+// usage: raytracer_scalebench [scene.xml] [--width <px>] [--height <px>] [--max-threads <n>] [--repetitions <n>]
+//                             [--no-accel] [--output <report.json>]
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "stats/raystats.h"
+#include "utils/sceneparser.h"
+
+#ifndef RAYTRACER_SOURCE_DIR
+#define RAYTRACER_SOURCE_DIR "."
+#endif
+
+namespace {
+
+// The fastest of the repeated renders at one thread count
+struct ScalingRun {
+    int threads = 0;
+    TileScheduleStats schedule;
+    RayCounts rays;
+
+    double wallMs() const { return schedule.wallNs / 1e6; }
+
+    double busyMs() const {
+        double busy = 0;
+        for (const TileWorkerStats &worker : schedule.workers) {
+            busy += worker.busyNs / 1e6;
+        }
+        return busy;
+    }
+
+    double maxBusyMs() const {
+        double maxBusy = 0;
+        for (const TileWorkerStats &worker : schedule.workers) {
+            maxBusy = std::max(maxBusy, worker.busyNs / 1e6);
+        }
+        return maxBusy;
+    }
+
+    int steals() const {
+        int steals = 0;
+        for (const TileWorkerStats &worker : schedule.workers) {
+            steals += worker.steals;
+        }
+        return steals;
+    }
+
+    double lockWaitMs() const {
+        double wait = 0;
+        for (const TileWorkerStats &worker : schedule.workers) {
+            wait += worker.lockWaitNs / 1e6;
+        }
+        return wait;
+    }
+};
+
+// Derived metrics of a run relative to the single-threaded run
+struct ScalingMetrics {
+    double speedup;        // single-threaded wall time / wall time
+    double efficiency;     // speedup / threads
+    double utilization;    // fraction of threads x wall time spent rendering; the rest is idle (imbalance, scheduling)
+    double workInflation;  // total busy time / single-threaded busy time; above 1 the threads slow each other down
+                           // through shared caches, memory bandwidth, the allocator or shared counters
+    double imbalance;      // busiest thread / average thread - 1
+};
+
+ScalingMetrics computeMetrics(const ScalingRun &run, const ScalingRun &baseline) {
+    ScalingMetrics metrics{};
+    metrics.speedup = baseline.wallMs() / run.wallMs();
+    metrics.efficiency = metrics.speedup / run.threads;
+    metrics.utilization = run.busyMs() / (run.threads * run.wallMs());
+    metrics.workInflation = run.busyMs() / baseline.busyMs();
+    double meanBusy = run.busyMs() / run.threads;
+    metrics.imbalance = meanBusy > 0 ? run.maxBusyMs() / meanBusy - 1 : 0;
+    return metrics;
+}
+
+QJsonObject toJson(const ScalingRun &run, const ScalingMetrics &metrics) {
+    QJsonArray workers;
+    for (const TileWorkerStats &worker : run.schedule.workers) {
+        workers.append(QJsonObject{
+            {"busyMs", worker.busyNs / 1e6},
+            {"idleMs", run.wallMs() - worker.busyNs / 1e6},
+            {"lockWaitMs", worker.lockWaitNs / 1e6},
+            {"tiles", worker.tiles},
+            {"steals", worker.steals},
+            {"failedSteals", worker.failedSteals},
+        });
+    }
+    return QJsonObject{
+        {"threads", run.threads},
+        {"wallMs", run.wallMs()},
+        {"speedup", metrics.speedup},
+        {"efficiency", metrics.efficiency},
+        {"utilization", metrics.utilization},
+        {"workInflation", metrics.workInflation},
+        {"imbalance", metrics.imbalance},
+        {"steals", run.steals()},
+        {"lockWaitMs", run.lockWaitMs()},
+        {"raysPerSec", run.rays.total() / (run.wallMs() / 1000)},
+        {"workers", workers},
+    };
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("scene", "Scene file to render.", "[scene.xml]");
+    QCommandLineOption widthOption("width", "Canvas width.", "px", "640");
+    QCommandLineOption heightOption("height", "Canvas height.", "px", "480");
+    QCommandLineOption maxThreadsOption("max-threads", "Largest thread count; counts double from 1 up to it.", "n",
+                                        QString::number(QThread::idealThreadCount()));
+    QCommandLineOption repetitionsOption("repetitions", "Renders per thread count; the fastest is reported.", "n", "3");
+    QCommandLineOption noAccelOption("no-accel", "Test every primitive for every ray instead of using the BVH.");
+    QCommandLineOption outputOption("output", "Path of the JSON report.", "file", "scaling.json");
+    parser.addOptions({widthOption, heightOption, maxThreadsOption, repetitionsOption, noAccelOption, outputOption});
+    parser.process(a);
+
+    QString scenePath = parser.positionalArguments().value(0, RAYTRACER_SOURCE_DIR "/scenefiles/xml/shadow_test.xml");
+    int width = std::max(1, parser.value(widthOption).toInt());
+    int height = std::max(1, parser.value(heightOption).toInt());
+    int maxThreads = std::max(1, parser.value(maxThreadsOption).toInt());
+    int repetitions = std::max(1, parser.value(repetitionsOption).toInt());
+
+    RenderData metaData;
+    if (!SceneParser::parse(scenePath.toStdString(), metaData)) {
+        std::cerr << "Error loading scene: \"" << scenePath.toStdString() << "\"" << std::endl;
+        return 1;
+    }
+    RayTraceScene scene{ width, height, metaData };
+    scene.waitForTextures();
+
+    std::vector<int> threadCounts{};
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    RayTracer::Config config{};
+    config.enableShadow = true;
+    config.enableReflection = true;
+    config.enableTextureMap = true;
+    config.enableParallelism = true;
+    config.enableAcceleration = !parser.isSet(noAccelOption);
+
+    std::vector<SceneColor> framebuffer(std::size_t(width) * height);
+    std::vector<ScalingRun> runs{};
+    for (int threads : threadCounts) {
+        config.threadCount = threads;
+        // the scheduler's worker threads are started once per thread count, outside the timed renders
+        RayTracer raytracer{ config };
+        ScalingRun best{};
+        for (int rep = 0; rep < repetitions; rep++) {
+            RayCounts raysBefore = RayStats::snapshot();
+            raytracer.render(framebuffer.data(), scene);
+            const TileScheduleStats &schedule = *raytracer.lastScheduleStats();
+            if (rep == 0 || schedule.wallNs < best.schedule.wallNs) {
+                best = ScalingRun{threads, schedule, RayStats::snapshot() - raysBefore};
+            }
+        }
+        runs.push_back(best);
+    }
+
+    std::cout << scenePath.toStdString() << " at " << width << "x" << height << ", fastest of " << repetitions
+              << " renders per thread count" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(11) << "wall ms" << std::setw(9) << "speedup"
+              << std::setw(11) << "efficiency" << std::setw(12) << "utilization" << std::setw(11) << "inflation"
+              << std::setw(11) << "imbalance" << std::setw(8) << "steals" << std::setw(13) << "lock wait ms"
+              << std::setw(13) << "M rays/s" << std::endl;
+    QJsonArray runArray;
+    for (const ScalingRun &run : runs) {
+        ScalingMetrics metrics = computeMetrics(run, runs.front());
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << run.threads << std::setw(11) << run.wallMs()
+                  << std::setw(9) << metrics.speedup << std::setw(10) << metrics.efficiency * 100 << "%"
+                  << std::setw(11) << metrics.utilization * 100 << "%" << std::setw(11) << metrics.workInflation
+                  << std::setw(10) << metrics.imbalance * 100 << "%" << std::setw(8) << run.steals()
+                  << std::setw(13) << run.lockWaitMs() << std::setw(13) << run.rays.total() / (run.wallMs() * 1000)
+                  << std::defaultfloat << std::endl;
+        runArray.append(toJson(run, metrics));
+    }
+    std::cout << "inflation above 1 means threads slow each other down while busy (shared caches, memory bandwidth, "
+                 "allocator, shared counters); utilization below 100% is idle time from imbalance or scheduling" << std::endl;
+
+    QJsonObject report{
+        {"scene", scenePath},
+        {"width", width},
+        {"height", height},
+        {"acceleration", config.enableAcceleration},
+        {"repetitions", repetitions},
+        {"runs", runArray},
+    };
+    QFile reportFile(parser.value(outputOption));
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        reportFile.write(QJsonDocument(report).toJson()) < 0) {
+        std::cerr << "Error: failed to write \"" << parser.value(outputOption).toStdString() << "\"" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote \"" << parser.value(outputOption).toStdString() << "\"" << std::endl;
+    return 0;
+}
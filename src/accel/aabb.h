@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <limits>
+#include "ray/ray.h"
+
+// Axis-aligned bounding box. A default-constructed box is empty (contains no points).
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    void expand(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB &box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    glm::vec3 centroid() const {
+        return 0.5f * (min + max);
+    }
+
+    float surfaceArea() const {
+        glm::vec3 extent = glm::max(max - min, glm::vec3(0));
+        return 2.f * (extent.x*extent.y + extent.y*extent.z + extent.z*extent.x);
+    }
+
+    // Returns the distance along the ray at which it enters the box, or infinity if it misses the box or only reaches
+    // it outside the ray's (tMin, tMax) interval. The direction's sign bits pick the near and far plane of each slab.
+    float intersect(const Ray &ray) const {
+        const glm::vec3 &origin = ray.getOrigin();
+        const glm::vec3 &invDir = ray.getInvDir();
+        float tEnter = ray.getTMin();
+        float tExit = ray.getTMax();
+        for (int axis = 0; axis < 3; axis++) {
+            int sign = ray.getSign(axis);
+            tEnter = std::max(tEnter, ((sign ? max : min)[axis] - origin[axis]) * invDir[axis]);
+            tExit = std::min(tExit, ((sign ? min : max)[axis] - origin[axis]) * invDir[axis]);
+        }
+        return (tEnter <= tExit) ? tEnter : std::numeric_limits<float>::infinity();
+    }
+};
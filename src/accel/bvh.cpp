@@ -0,0 +1,113 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+constexpr int binCount = 12;
+
+}
+
+/**
+ * @brief BVH::BVH builds the hierarchy over the given primitives. Leaves refer to primitives by their index in the given list.
+ */
+BVH::BVH(const std::vector<std::shared_ptr<Primitive>> &primitives) {
+    if (primitives.empty()) {
+        return;
+    }
+    std::vector<AABB> primitiveBounds{};
+    primitiveBounds.reserve(primitives.size());
+    for (const auto &primitive : primitives) {
+        primitiveBounds.push_back(primitive->getWorldSpaceBounds());
+    }
+
+    m_primitiveIndices.resize(primitives.size());
+    std::iota(m_primitiveIndices.begin(), m_primitiveIndices.end(), 0);
+    m_nodes.reserve(2 * primitives.size());
+    m_nodes.push_back(Node{});
+    buildNode(0, primitiveBounds, 0, primitives.size(), 0);
+}
+
+bool BVH::empty() const {
+    return m_nodes.empty();
+}
+
+/**
+ * @brief BVH::buildNode recursively builds the subtree at m_nodes[nodeIdx] over m_primitiveIndices[begin, end).
+ *          The range is split where the surface area heuristic estimates the lowest traversal cost, evaluated at
+ *          binCount evenly spaced planes along the axis in which the primitive centroids are most spread out.
+ */
+void BVH::buildNode(int nodeIdx, const std::vector<AABB> &primitiveBounds, int begin, int end, int depth) {
+    AABB bounds;
+    AABB centroidBounds;
+    for (int i = begin; i < end; i++) {
+        bounds.expand(primitiveBounds[m_primitiveIndices[i]]);
+        centroidBounds.expand(primitiveBounds[m_primitiveIndices[i]].centroid());
+    }
+    int count = end - begin;
+    m_nodes[nodeIdx] = Node{bounds, begin, count};
+
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    if (count <= maxLeafSize || depth >= maxDepth || extent[axis] <= 0.f) {
+        return;
+    }
+
+    // bin the centroids along the split axis
+    auto binOf = [&](int primitiveIdx) {
+        float offset = (primitiveBounds[primitiveIdx].centroid()[axis] - centroidBounds.min[axis]) / extent[axis];
+        return std::min(int(offset * binCount), binCount - 1);
+    };
+    AABB binBounds[binCount];
+    int binSizes[binCount] = {};
+    for (int i = begin; i < end; i++) {
+        int bin = binOf(m_primitiveIndices[i]);
+        binBounds[bin].expand(primitiveBounds[m_primitiveIndices[i]]);
+        binSizes[bin]++;
+    }
+
+    // cost of splitting after bin b is area(left) * count(left) + area(right) * count(right)
+    float leftCosts[binCount - 1];
+    AABB leftBounds;
+    int leftSize = 0;
+    for (int b = 0; b < binCount - 1; b++) {
+        leftBounds.expand(binBounds[b]);
+        leftSize += binSizes[b];
+        leftCosts[b] = leftBounds.surfaceArea() * leftSize;
+    }
+    int bestSplit = -1;
+    float bestCost = std::numeric_limits<float>::infinity();
+    AABB rightBounds;
+    int rightSize = 0;
+    for (int b = binCount - 1; b > 0; b--) {
+        rightBounds.expand(binBounds[b]);
+        rightSize += binSizes[b];
+        float cost = leftCosts[b - 1] + rightBounds.surfaceArea() * rightSize;
+        if (rightSize < count && cost < bestCost) {
+            bestCost = cost;
+            bestSplit = b;
+        }
+    }
+
+    int mid;
+    if (bestSplit > 0) {
+        mid = std::partition(m_primitiveIndices.begin() + begin, m_primitiveIndices.begin() + end,
+                             [&](int primitiveIdx) { return binOf(primitiveIdx) < bestSplit; }) - m_primitiveIndices.begin();
+    } else {
+        mid = begin;
+    }
+    if (mid == begin || mid == end) {
+        // all centroids fell into one bin: fall back to a median split
+        mid = begin + count / 2;
+        std::nth_element(m_primitiveIndices.begin() + begin, m_primitiveIndices.begin() + mid, m_primitiveIndices.begin() + end,
+                         [&](int a, int b) { return primitiveBounds[a].centroid()[axis] < primitiveBounds[b].centroid()[axis]; });
+    }
+
+    int left = m_nodes.size();
+    m_nodes.push_back(Node{});
+    m_nodes.push_back(Node{});
+    m_nodes[nodeIdx] = Node{bounds, left, 0};
+    buildNode(left, primitiveBounds, begin, mid, depth + 1);
+    buildNode(left + 1, primitiveBounds, mid, end, depth + 1);
+}
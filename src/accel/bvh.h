@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "aabb.h"
+#include "primitives/primitive.h"
+#include "stats/memstats.h"
+
+// A bounding volume hierarchy over the world-space bounds of a scene's primitives, used to skip intersection tests
+// with primitives a ray cannot reach. Built with a binned surface area heuristic.
+class BVH {
+public:
+    BVH() = default;
+    explicit BVH(const std::vector<std::shared_ptr<Primitive>> &primitives);
+
+    bool empty() const;
+
+    // Calls testPrimitive(i) for every primitive i whose bounds the ray enters within its (tMin, tMax) interval,
+    // visiting nearer nodes first. testPrimitive is expected to shrink the ray's tMax when it finds a closer hit.
+    // Returns the number of nodes visited.
+    template <typename TestFn>
+    int traverse(const Ray &ray, TestFn testPrimitive) const;
+
+private:
+    static constexpr int maxDepth = 64;    // deeper nodes become leaves, which bounds the traversal stack
+    static constexpr int maxLeafSize = 4;  // ranges this small always become leaves
+
+    // Interior nodes store their children at m_nodes[first] and m_nodes[first + 1].
+    // Leaves (count > 0) store their primitives at m_primitiveIndices[first, first + count).
+    struct Node {
+        AABB bounds;
+        int first;
+        int count;
+    };
+
+    void buildNode(int nodeIdx, const std::vector<AABB> &primitiveBounds, int begin, int end, int depth);
+
+    MemoryStats::TrackedVector<Node, MemoryCategory::MEM_ACCELERATION> m_nodes{};
+    MemoryStats::TrackedVector<int, MemoryCategory::MEM_ACCELERATION> m_primitiveIndices{};
+};
+
+template <typename TestFn>
+int BVH::traverse(const Ray &ray, TestFn testPrimitive) const {
+    if (m_nodes.empty()) {
+        return 0;
+    }
+
+    int stack[maxDepth + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    int nodesVisited = 0;
+    while (stackSize > 0) {
+        const Node &node = m_nodes[stack[--stackSize]];
+        nodesVisited++;
+        // tMax may have shrunk since this node was pushed
+        if (node.bounds.intersect(ray) == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                testPrimitive(m_primitiveIndices[i]);
+            }
+            continue;
+        }
+        // push the farther child first so that the nearer one is visited first; skip children the ray misses
+        int nearChild = node.first;
+        int farChild = node.first + 1;
+        float tNear = m_nodes[nearChild].bounds.intersect(ray);
+        float tFar = m_nodes[farChild].bounds.intersect(ray);
+        if (tFar < tNear) {
+            std::swap(nearChild, farChild);
+            std::swap(tNear, tFar);
+        }
+        if (tFar < std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = farChild;
+        }
+        if (tNear < std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = nearChild;
+        }
+    }
+    return nodesVisited;
+}
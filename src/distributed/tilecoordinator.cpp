@@ -0,0 +1,238 @@
+#include "tilecoordinator.h"
+#include "tileprotocol.h"
+
+#include <iostream>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QTimer>
+
+TileCoordinator::TileCoordinator(const QString &configPath, const RenderSettings &settings) :
+    m_configPath(QFileInfo(configPath).absoluteFilePath()), // workers may run from a different directory
+    m_settings(settings)
+{}
+
+TileCoordinator::~TileCoordinator() {
+    for (auto &process : m_localWorkers) {
+        if (process->state() != QProcess::NotRunning && !process->waitForFinished(5000)) {
+            process->kill();
+            process->waitForFinished();
+        }
+    }
+}
+
+/**
+ * @brief TileCoordinator::render runs the coordinator's event loop until all tiles have been received from the workers.
+ * @param imageData pointer to the HDR framebuffer holding the crop window of the canvas
+ * @return true if every tile was rendered
+ */
+bool TileCoordinator::render(SceneColor *imageData) {
+    m_imageData = imageData;
+    m_tiles = splitIntoTiles(m_settings.crop, m_settings.tileSize);
+    m_tileDone.assign(m_tiles.size(), false);
+    m_pendingTiles.clear();
+    for (const Tile &tile : m_tiles) {
+        m_pendingTiles.push_back(tile.index);
+    }
+    m_tilesRemaining = m_tiles.size();
+    if (m_tilesRemaining == 0) {
+        return true;
+    }
+
+    if (!m_server.listen(QHostAddress(m_settings.host), m_settings.port)) {
+        std::cerr << "Error: coordinator could not listen on " << m_settings.host.toStdString() << ":" << m_settings.port
+                  << ": " << m_server.errorString().toStdString() << std::endl;
+        return false;
+    }
+    std::cout << "Coordinator listening on " << m_settings.host.toStdString() << ":" << m_server.serverPort()
+              << ", " << m_tiles.size() << " tiles to render" << std::endl;
+    QObject::connect(&m_server, &QTcpServer::newConnection, [this]() { acceptWorkers(); });
+
+    spawnLocalWorkers();
+
+    QTimer timeoutTimer;
+    QObject::connect(&timeoutTimer, &QTimer::timeout, [this]() { checkTimeouts(); });
+    timeoutTimer.start(250);
+    m_noWorkersTimer.start();
+
+    m_eventLoop.exec();
+
+    // release the workers
+    for (auto &[workerId, worker] : m_workers) {
+        TileProtocol::sendMessage(*worker.socket, TileProtocol::encodeShutdown());
+        worker.socket->waitForBytesWritten(1000);
+    }
+    m_server.close();
+    return !m_failed;
+}
+
+/**
+ * @brief TileCoordinator::spawnLocalWorkers starts the configured number of worker processes on this machine.
+ *          Workers are copies of the current executable started in worker mode.
+ */
+void TileCoordinator::spawnLocalWorkers() {
+    QString address = QString("127.0.0.1:%1").arg(m_server.serverPort());
+    for (int i = 0; i < m_settings.localWorkers; i++) {
+        auto process = std::make_unique<QProcess>();
+        process->setProcessChannelMode(QProcess::ForwardedChannels);
+        process->start(QCoreApplication::applicationFilePath(), QStringList{"--worker", address});
+        m_localWorkers.push_back(std::move(process));
+    }
+}
+
+/**
+ * @brief TileCoordinator::acceptWorkers registers newly connected workers and sends them the job description
+ */
+void TileCoordinator::acceptWorkers() {
+    while (m_server.hasPendingConnections()) {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        int workerId = m_nextWorkerId++;
+        m_workers[workerId] = WorkerState{socket};
+
+        QObject::connect(socket, &QTcpSocket::readyRead, [this, workerId]() { readFromWorker(workerId); });
+        QObject::connect(socket, &QTcpSocket::disconnected, [this, workerId]() { dropWorker(workerId); });
+
+        TileProtocol::sendMessage(*socket, TileProtocol::encodeJob(m_configPath));
+    }
+}
+
+/**
+ * @brief TileCoordinator::readFromWorker handles every complete message received from a worker
+ */
+void TileCoordinator::readFromWorker(int workerId) {
+    auto workerIt = m_workers.find(workerId);
+    if (workerIt == m_workers.end()) {
+        return;
+    }
+    WorkerState &worker = workerIt->second;
+    worker.buffer.append(worker.socket->readAll());
+
+    QByteArray payload;
+    while (TileProtocol::takeMessage(worker.buffer, payload)) {
+        switch (TileProtocol::messageType(payload)) {
+            case TileProtocol::MessageType::Ready: {
+                int width, height;
+                if (!TileProtocol::decodeReady(payload, width, height) || width != m_settings.width || height != m_settings.height) {
+                    std::cerr << "Worker " << workerId << " loaded a different canvas; disconnecting it" << std::endl;
+                    worker.socket->abort();
+                    return;
+                }
+                worker.ready = true;
+                std::cout << "Worker " << workerId << " ready" << std::endl;
+                break;
+            }
+            case TileProtocol::MessageType::TileResult: {
+                Tile tile;
+                std::vector<SceneColor> pixels;
+                bool valid = TileProtocol::decodeTileResult(payload, tile, pixels) &&
+                             tile.index >= 0 && tile.index < int(m_tiles.size()) &&
+                             tile.x == m_tiles[tile.index].x && tile.y == m_tiles[tile.index].y &&
+                             tile.width == m_tiles[tile.index].width && tile.height == m_tiles[tile.index].height;
+                if (!valid) {
+                    std::cerr << "Worker " << workerId << " sent a malformed tile; disconnecting it" << std::endl;
+                    worker.socket->abort();
+                    return;
+                }
+                storeTile(tile, pixels);
+                worker.tileIdx = -1;
+                worker.overdue = false;
+                break;
+            }
+            default:
+                std::cerr << "Worker " << workerId << " sent an unexpected message; disconnecting it" << std::endl;
+                worker.socket->abort();
+                return;
+        }
+    }
+
+    if (m_tilesRemaining == 0) {
+        m_eventLoop.quit();
+    } else {
+        assignTiles();
+    }
+}
+
+/**
+ * @brief TileCoordinator::storeTile copies the pixels of a finished tile into the canvas. Copies of a tile that arrive after the first are ignored.
+ */
+void TileCoordinator::storeTile(const Tile &tile, const std::vector<SceneColor> &pixels) {
+    if (m_tileDone[tile.index]) {
+        return;
+    }
+    for (int row = 0; row < tile.height; row++) {
+        std::copy_n(pixels.begin() + std::size_t(row) * tile.width,
+                    tile.width,
+                    m_imageData + std::size_t(tile.y - m_settings.crop.y + row) * m_settings.crop.width + (tile.x - m_settings.crop.x));
+    }
+    m_tileDone[tile.index] = true;
+    m_tilesRemaining--;
+}
+
+/**
+ * @brief TileCoordinator::dropWorker forgets a disconnected worker and puts its unfinished tile back in the queue
+ */
+void TileCoordinator::dropWorker(int workerId) {
+    auto workerIt = m_workers.find(workerId);
+    if (workerIt == m_workers.end()) {
+        return;
+    }
+    WorkerState &worker = workerIt->second;
+    if (worker.tileIdx >= 0 && !m_tileDone[worker.tileIdx] && !worker.overdue) {
+        m_pendingTiles.push_front(worker.tileIdx);
+    }
+    worker.socket->deleteLater();
+    m_workers.erase(workerIt);
+    std::cout << "Worker " << workerId << " disconnected" << std::endl;
+
+    if (m_workers.empty()) {
+        m_noWorkersTimer.restart();
+    }
+    assignTiles();
+}
+
+/**
+ * @brief TileCoordinator::assignTiles hands the next pending tile to every idle worker
+ */
+void TileCoordinator::assignTiles() {
+    for (auto &[workerId, worker] : m_workers) {
+        if (!worker.ready || worker.tileIdx >= 0) {
+            continue;
+        }
+        // skip tiles that were finished by another worker after being requeued
+        while (!m_pendingTiles.empty() && m_tileDone[m_pendingTiles.front()]) {
+            m_pendingTiles.pop_front();
+        }
+        if (m_pendingTiles.empty()) {
+            return;
+        }
+        worker.tileIdx = m_pendingTiles.front();
+        worker.overdue = false;
+        worker.assignedAt.start();
+        m_pendingTiles.pop_front();
+        TileProtocol::sendMessage(*worker.socket, TileProtocol::encodeRenderTile(m_tiles[worker.tileIdx]));
+    }
+}
+
+/**
+ * @brief TileCoordinator::checkTimeouts requeues tiles held by slow workers and gives up if no worker has been connected for too long
+ */
+void TileCoordinator::checkTimeouts() {
+    qint64 timeoutMs = qint64(m_settings.tileTimeoutSecs) * 1000;
+
+    if (m_workers.empty() && m_noWorkersTimer.elapsed() > timeoutMs) {
+        std::cerr << "Error: no worker connected for " << m_settings.tileTimeoutSecs << " seconds, giving up" << std::endl;
+        m_failed = true;
+        m_eventLoop.quit();
+        return;
+    }
+
+    for (auto &[workerId, worker] : m_workers) {
+        if (worker.tileIdx >= 0 && !worker.overdue && !m_tileDone[worker.tileIdx] && worker.assignedAt.elapsed() > timeoutMs) {
+            // the slow worker keeps its tile; whichever copy finishes first wins
+            std::cout << "Worker " << workerId << " timed out on tile " << worker.tileIdx << ", reassigning it" << std::endl;
+            worker.overdue = true;
+            m_pendingTiles.push_front(worker.tileIdx);
+        }
+    }
+    assignTiles();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "raytracer/tile.h"
+#include "utils/rendersettings.h"
+#include "utils/scenedata.h"
+
+// Splits the canvas into tiles and hands them out to worker processes over TCP (see tileprotocol.h).
+// Workers either get spawned locally or connect on their own with `--worker host:port`.
+// Tiles held by a worker that disconnects, or that take longer than the tile timeout, are handed to another worker;
+// whichever copy of a tile arrives first is kept. Since a pixel's color depends only on its position, the assembled
+// image is identical to a single-process render.
+class TileCoordinator
+{
+public:
+    TileCoordinator(const QString &configPath, const RenderSettings &settings);
+    ~TileCoordinator();
+
+    // Distributes the tiles and blocks until every tile has been written into imageData.
+    // @param imageData The pointer to the imageData to be filled (the crop window of the canvas).
+    // @return false if the render could not be completed, e.g. because no worker was available for too long.
+    bool render(SceneColor *imageData);
+
+private:
+    struct WorkerState {
+        QTcpSocket *socket = nullptr;
+        QByteArray buffer{};    // bytes received but not yet parsed
+        bool ready = false;     // scene has been loaded
+        int tileIdx = -1;       // tile currently being rendered, -1 if idle
+        bool overdue = false;   // the current tile has already been handed to someone else
+        QElapsedTimer assignedAt{};
+    };
+
+    // helpers (see tilecoordinator.cpp for documentation)
+    void spawnLocalWorkers();
+    void acceptWorkers();
+    void readFromWorker(int workerId);
+    void dropWorker(int workerId);
+    void assignTiles();
+    void checkTimeouts();
+    void storeTile(const Tile &tile, const std::vector<SceneColor> &pixels);
+
+    QString m_configPath;
+    RenderSettings m_settings;
+
+    SceneColor *m_imageData = nullptr;
+    std::vector<Tile> m_tiles{};
+    std::vector<bool> m_tileDone{};
+    std::deque<int> m_pendingTiles{};
+    int m_tilesRemaining = 0;
+
+    QTcpServer m_server;
+    QEventLoop m_eventLoop;
+    std::map<int, WorkerState> m_workers{};
+    int m_nextWorkerId = 0;
+    std::vector<std::unique_ptr<QProcess>> m_localWorkers{};
+    QElapsedTimer m_noWorkersTimer; // running while no worker is connected
+    bool m_failed = false;
+};
@@ -0,0 +1,160 @@
+#include "tileprotocol.h"
+
+#include <QDataStream>
+#include <QIODevice>
+#include <cstring>
+
+namespace TileProtocol {
+
+namespace {
+
+// every payload starts with its type and the protocol version
+QDataStream &beginMessage(QDataStream &out, MessageType type) {
+    out.setVersion(QDataStream::Qt_6_0);
+    return out << quint8(type) << version;
+}
+
+// positions the stream after the header of a payload of the expected type
+bool beginReading(QDataStream &in, MessageType expectedType) {
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 type;
+    quint32 senderVersion;
+    in >> type >> senderVersion;
+    return in.status() == QDataStream::Ok && type == quint8(expectedType) && senderVersion == version;
+}
+
+QDataStream &operator<<(QDataStream &out, const Tile &tile) {
+    return out << qint32(tile.index) << qint32(tile.x) << qint32(tile.y) << qint32(tile.width) << qint32(tile.height);
+}
+
+QDataStream &operator>>(QDataStream &in, Tile &tile) {
+    qint32 index, x, y, width, height;
+    in >> index >> x >> y >> width >> height;
+    tile = Tile{index, x, y, width, height};
+    return in;
+}
+
+}
+
+QByteArray encodeJob(const QString &configPath) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    beginMessage(out, MessageType::Job) << configPath;
+    return payload;
+}
+
+QByteArray encodeReady(int width, int height) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    beginMessage(out, MessageType::Ready) << qint32(width) << qint32(height);
+    return payload;
+}
+
+QByteArray encodeRenderTile(const Tile &tile) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    beginMessage(out, MessageType::RenderTile) << tile;
+    return payload;
+}
+
+QByteArray encodeTileResult(const Tile &tile, const std::vector<SceneColor> &pixels) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    // pixels are sent as raw floats (in the host byte order), so the coordinator receives exactly what the worker rendered
+    // and tone maps the assembled image once
+    QByteArray pixelBytes(reinterpret_cast<const char *>(pixels.data()), pixels.size() * sizeof(SceneColor));
+    beginMessage(out, MessageType::TileResult) << tile << pixelBytes;
+    return payload;
+}
+
+QByteArray encodeShutdown() {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    beginMessage(out, MessageType::Shutdown);
+    return payload;
+}
+
+MessageType messageType(const QByteArray &payload) {
+    return payload.isEmpty() ? MessageType::Shutdown : MessageType(quint8(payload[0]));
+}
+
+bool decodeJob(const QByteArray &payload, QString &configPath) {
+    QDataStream in(payload);
+    if (!beginReading(in, MessageType::Job)) {
+        return false;
+    }
+    in >> configPath;
+    return in.status() == QDataStream::Ok;
+}
+
+bool decodeReady(const QByteArray &payload, int &width, int &height) {
+    QDataStream in(payload);
+    if (!beginReading(in, MessageType::Ready)) {
+        return false;
+    }
+    qint32 w, h;
+    in >> w >> h;
+    width = w;
+    height = h;
+    return in.status() == QDataStream::Ok;
+}
+
+bool decodeRenderTile(const QByteArray &payload, Tile &tile) {
+    QDataStream in(payload);
+    if (!beginReading(in, MessageType::RenderTile)) {
+        return false;
+    }
+    in >> tile;
+    return in.status() == QDataStream::Ok && tile.width > 0 && tile.height > 0;
+}
+
+bool decodeTileResult(const QByteArray &payload, Tile &tile, std::vector<SceneColor> &pixels) {
+    QDataStream in(payload);
+    if (!beginReading(in, MessageType::TileResult)) {
+        return false;
+    }
+    QByteArray pixelBytes;
+    in >> tile >> pixelBytes;
+    if (in.status() != QDataStream::Ok || tile.width <= 0 || tile.height <= 0 ||
+        pixelBytes.size() != qsizetype(tile.width) * tile.height * qsizetype(sizeof(SceneColor))) {
+        return false;
+    }
+    pixels.resize(std::size_t(tile.width) * tile.height);
+    std::memcpy(pixels.data(), pixelBytes.constData(), pixelBytes.size());
+    return true;
+}
+
+void sendMessage(QTcpSocket &socket, const QByteArray &payload) {
+    QByteArray frame;
+    QDataStream out(&frame, QIODevice::WriteOnly);
+    out << quint32(payload.size());
+    frame.append(payload);
+    socket.write(frame);
+}
+
+bool takeMessage(QByteArray &buffer, QByteArray &payload) {
+    if (buffer.size() < qsizetype(sizeof(quint32))) {
+        return false;
+    }
+    quint32 length;
+    QDataStream in(buffer);
+    in >> length;
+    if (buffer.size() < qsizetype(sizeof(quint32) + length)) {
+        return false;
+    }
+    payload = buffer.mid(sizeof(quint32), length);
+    buffer.remove(0, sizeof(quint32) + length);
+    return true;
+}
+
+bool readMessage(QTcpSocket &socket, QByteArray &buffer, QByteArray &payload) {
+    while (!takeMessage(buffer, payload)) {
+        if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(-1)) {
+            return false; // disconnected
+        }
+        buffer.append(socket.readAll());
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QTcpSocket>
+#include <vector>
+#include "raytracer/tile.h"
+#include "utils/scenedata.h"
+
+// Messages exchanged between the tile coordinator and its workers over TCP.
+// Every message is framed as a 32-bit big-endian payload length followed by the payload, whose first byte is the MessageType.
+//
+//   coordinator -> worker: Job (once, after connecting), RenderTile (repeatedly), Shutdown
+//   worker -> coordinator: Ready (once the scene is loaded), TileResult (one per RenderTile)
+namespace TileProtocol {
+
+enum class MessageType : quint8 {
+    Job = 1,    // absolute path of the config file describing the render
+    Ready,      // canvas size the worker loaded from the config
+    RenderTile, // tile to render
+    TileResult, // rendered tile and its pixels
+    Shutdown    // no more work; the worker exits
+};
+
+// Increase whenever the layout of a message changes so that mismatched binaries refuse to talk
+constexpr quint32 version = 2; // 2: tile pixels are HDR float colors
+
+QByteArray encodeJob(const QString &configPath);
+QByteArray encodeReady(int width, int height);
+QByteArray encodeRenderTile(const Tile &tile);
+QByteArray encodeTileResult(const Tile &tile, const std::vector<SceneColor> &pixels);
+QByteArray encodeShutdown();
+
+// Returns the type of a received payload
+MessageType messageType(const QByteArray &payload);
+
+// Decoders return false if the payload is malformed
+bool decodeJob(const QByteArray &payload, QString &configPath);
+bool decodeReady(const QByteArray &payload, int &width, int &height);
+bool decodeRenderTile(const QByteArray &payload, Tile &tile);
+bool decodeTileResult(const QByteArray &payload, Tile &tile, std::vector<SceneColor> &pixels);
+
+// Writes one framed message to the socket
+void sendMessage(QTcpSocket &socket, const QByteArray &payload);
+
+// Removes one complete message from the front of buffer (bytes received so far) if there is one
+bool takeMessage(QByteArray &buffer, QByteArray &payload);
+
+// Blocks until one complete message has been received. Returns false if the socket disconnects first.
+bool readMessage(QTcpSocket &socket, QByteArray &buffer, QByteArray &payload);
+
+}
@@ -0,0 +1,77 @@
+#include "tileworker.h"
+#include "tileprotocol.h"
+
+#include <iostream>
+#include <memory>
+#include <QCoreApplication>
+#include "utils/rendersettings.h"
+#include "utils/sceneparser.h"
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+
+int runTileWorker(const QString &address) {
+    QStringList hostAndPort = address.split(":");
+    bool validPort = false;
+    int port = hostAndPort.size() == 2 ? hostAndPort[1].toInt(&validPort) : 0;
+    if (!validPort) {
+        std::cerr << "Error: expected the coordinator address as host:port, got \"" << address.toStdString() << "\"" << std::endl;
+        return 1;
+    }
+
+    QTcpSocket socket;
+    socket.connectToHost(hostAndPort[0], port);
+    if (!socket.waitForConnected()) {
+        std::cerr << "Error: could not connect to coordinator at " << address.toStdString() << ": " << socket.errorString().toStdString() << std::endl;
+        return 1;
+    }
+
+    // the scene is loaded once, when the coordinator sends the job, and reused for every tile
+    std::unique_ptr<RayTraceScene> rtScene;
+    std::unique_ptr<RayTracer> raytracer;
+    std::vector<SceneColor> tilePixels;
+
+    QByteArray buffer;
+    QByteArray payload;
+    while (TileProtocol::readMessage(socket, buffer, payload)) {
+        switch (TileProtocol::messageType(payload)) {
+            case TileProtocol::MessageType::Job: {
+                QString configPath;
+                if (!TileProtocol::decodeJob(payload, configPath)) {
+                    std::cerr << "Error: malformed job from coordinator" << std::endl;
+                    return 1;
+                }
+                RenderSettings settings = loadRenderSettings(configPath);
+                RenderData metaData;
+                if (!SceneParser::parse(settings.scenePath.toStdString(), metaData)) {
+                    std::cerr << "Error loading scene: \"" << settings.scenePath.toStdString() << "\"" << std::endl;
+                    return 1;
+                }
+                rtScene = std::make_unique<RayTraceScene>(settings.width, settings.height, metaData, settings.lightCutoff);
+                raytracer = std::make_unique<RayTracer>(settings.rtConfig);
+                TileProtocol::sendMessage(socket, TileProtocol::encodeReady(settings.width, settings.height));
+                break;
+            }
+            case TileProtocol::MessageType::RenderTile: {
+                Tile tile;
+                if (!rtScene || !TileProtocol::decodeRenderTile(payload, tile)) {
+                    std::cerr << "Error: unexpected tile from coordinator" << std::endl;
+                    return 1;
+                }
+                tilePixels.assign(std::size_t(tile.width) * tile.height, SceneColor(0, 0, 0, 1));
+                raytracer->renderTile(tilePixels.data(), tile.width, tile, *rtScene);
+                TileProtocol::sendMessage(socket, TileProtocol::encodeTileResult(tile, tilePixels));
+                socket.flush();
+                break;
+            }
+            case TileProtocol::MessageType::Shutdown:
+                socket.disconnectFromHost();
+                return 0;
+            default:
+                std::cerr << "Error: unexpected message from coordinator" << std::endl;
+                return 1;
+        }
+    }
+
+    // coordinator went away without a shutdown message
+    return 0;
+}
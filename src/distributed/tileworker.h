@@ -0,0 +1,8 @@
+#pragma once
+
+#include <QString>
+
+// Connects to the tile coordinator at address ("host:port"), loads the scene named by the coordinator's config once,
+// then renders the tiles it is assigned until the coordinator shuts it down or disconnects.
+// @return the process exit code
+int runTileWorker(const QString &address);
@@ -1,14 +1,23 @@
 #include "light.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 Light::Light(SceneLightData lightData): m_lightData(lightData) {
     m_type = lightData.type;
     // get attentuation constants
     c1 = m_lightData.function[0];
     c2 = m_lightData.function[1];
     c3 = m_lightData.function[2];
+    // spot light cone
+    m_spotDirection = normalize(vec3(m_lightData.dir));
+    m_cosOuter = std::cos(m_lightData.angle);
+    m_cosInner = std::cos(std::max(0.f, m_lightData.angle - m_lightData.penumbra));
+    m_falloffScale = m_cosInner > m_cosOuter ? 1 / (m_cosInner - m_cosOuter) : 0;
 }
 
-SceneLightData Light::getLightData() { 
+const SceneLightData &Light::getLightData() const {
     return m_lightData; 
 }
 
@@ -17,7 +26,7 @@ SceneLightData Light::getLightData() {
  * @param currPosition query position in world space
  * @return the normalized direction to the light from the given position in world space
  */
-vec3 Light::getDirToLight(vec3 currPosition) {
+vec3 Light::getDirToLight(vec3 currPosition) const {
     // handle spotlight/direcitonal/point
     switch (m_type) {
         case LightType::LIGHT_POINT:
@@ -35,20 +44,18 @@ vec3 Light::getDirToLight(vec3 currPosition) {
 
 
 /**
- * @brief Light::smoothFallOff An easing function for smoothly interpolating between the inner and outer cone angle of a spotlight.
- *          Only works when the current Light is of type Spotlight
- * @param x angle, in radians, relative to the spotlight direction
- * @return 0 if x=inner, 1 if x=outer, smooth in between. 0 if the current light is not a spotlight.
+ * @brief Light::smoothFallOff An easing function for smoothly interpolating between the inner and outer cone of a spotlight.
+ *          Interpolates in cosine space, so no angle has to be computed. Only works when the current Light is of type Spotlight
+ * @param cosTheta cosine of the angle between the spotlight direction and the direction to the query position
+ * @return 0 on the inner cone, 1 on the outer cone, smooth in between. 0 if the current light is not a spotlight.
  */
-float Light::smoothFallOff(float x) {
+float Light::smoothFallOff(float cosTheta) const {
     if (m_type != LightType::LIGHT_SPOT) {
         return 0;
     }
 
-    float totalConeAngle = m_lightData.angle;
-    float innerConeAngle = totalConeAngle - m_lightData.penumbra;
-    float scaledX = (x - innerConeAngle) / (totalConeAngle - innerConeAngle);
-    return -2*pow(scaledX, 3) + 3*pow(scaledX, 2);
+    float scaledX = (m_cosInner - cosTheta) * m_falloffScale;
+    return scaledX*scaledX*(3 - 2*scaledX);
 }
 
 /**
@@ -57,23 +64,21 @@ float Light::smoothFallOff(float x) {
  * @param currPosition world space XYZ position from which the light is viewed
  * @return color of this Light in float form.
  */
-SceneColor Light::getColor(vec3 currPosition) {
+SceneColor Light::getColor(vec3 currPosition) const {
     // handle spotlight separately
     if (m_type == LightType::LIGHT_SPOT) {
-        // color depends on direction to the light from the query position
-        // get absolute angle between curr direction and spotlight dir (radians, [-pi/2,pi/2])
-        vec3 spotlightDir = normalize(vec3(m_lightData.dir));
-        vec3 lightToIntersection = currPosition - vec3(m_lightData.pos); // alr normalized
+        // color depends on direction to the light from the query position: compare the cosine of the angle between
+        // the spotlight direction and the direction to the query position with the cosines of the cones
+        vec3 lightToIntersection = currPosition - vec3(m_lightData.pos);
         float distToLight = length(lightToIntersection);
+        float cosTheta = dot(lightToIntersection, m_spotDirection) / distToLight;
 
-        float theta = std::acos( dot(lightToIntersection, spotlightDir) / distToLight ); // acos(component parallel to light dir / component along diagonal)
-        
-        if (theta > m_lightData.angle) {
+        if (cosTheta < m_cosOuter) {
             // ray direction toward light is entirely outside of the light cone
             return vec4(0,0,0,1); // no color
-        } else if (theta >= m_lightData.angle - m_lightData.penumbra) {
+        } else if (cosTheta <= m_cosInner) {
             // in outer cone: light intensity drops off with distance from the light direction
-            return vec4( (1 - smoothFallOff(theta)) * vec3(m_lightData.color), 1);
+            return vec4( (1 - smoothFallOff(cosTheta)) * vec3(m_lightData.color), 1);
         }
         // in inner cone: full intensity
     }
@@ -85,10 +90,48 @@ SceneColor Light::getColor(vec3 currPosition) {
  * @param distToLight
  * @return float in [0,1] that is roughly inversely proportioante to the distance to the light
  */
-float Light::attenuationFn(float distToLight) {
-    return std::min(1.f, (1/(c1 + distToLight*c2 + pow(distToLight, 2.f)*c3)) );
+float Light::attenuationFn(float distToLight) const {
+    return std::min(1.f, (1/(c1 + distToLight*c2 + distToLight*distToLight*c3)) );
 }
 
-LightType Light::getType() {
+LightType Light::getType() const {
     return m_type;
 }
+
+/**
+ * @brief Light::influenceRadius solves c1 + c2*d + c3*d^2 = intensity / cutoff for the distance d at which the attenuated
+ *          intensity (brightest channel) drops to the cutoff. Conservative: coefficients that could make the attenuation
+ *          grow again with distance give an infinite radius.
+ * @param cutoff smallest contribution worth shading, in linear color units. 0 disables the bound.
+ */
+float Light::influenceRadius(float cutoff) const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    if (m_type == LightType::LIGHT_DIRECTIONAL || !(cutoff > 0) || c2 < 0 || c3 < 0) {
+        return infinity;
+    }
+    float intensity = std::max(std::max(m_lightData.color.r, m_lightData.color.g), m_lightData.color.b);
+    float target = intensity / cutoff - c1; // c2*d + c3*d^2 must reach this
+    if (target <= 0) {
+        return 0; // never brighter than the cutoff
+    }
+    if (c3 > 0) {
+        return (-c2 + std::sqrt(c2*c2 + 4*c3*target)) / (2*c3);
+    }
+    return c2 > 0 ? target / c2 : infinity;
+}
+
+const vec3 &Light::getSpotDirection() const {
+    return m_spotDirection;
+}
+
+float Light::getCosOuterAngle() const {
+    return m_cosOuter;
+}
+
+float Light::getCosInnerAngle() const {
+    return m_cosInner;
+}
+
+float Light::getFalloffScale() const {
+    return m_falloffScale;
+}
@@ -10,17 +10,30 @@ class Light {
 public:
     Light(SceneLightData lightData);
 
-    SceneLightData getLightData();
-    vec3 getDirToLight(vec3 currPosition); // override in spotlight or make visibility scale factor (1 or 0 dep on dir)
-    SceneColor getColor(vec3 currPosition); // override in spotlight w falloff
-    float attenuationFn(float distToLight);
-    LightType getType();
+    const SceneLightData &getLightData() const;
+    vec3 getDirToLight(vec3 currPosition) const; // override in spotlight or make visibility scale factor (1 or 0 dep on dir)
+    SceneColor getColor(vec3 currPosition) const; // override in spotlight w falloff
+    float attenuationFn(float distToLight) const;
+    LightType getType() const;
+    // Distance beyond which the light's unshadowed contribution stays below cutoff on surfaces whose material terms
+    // are at most 1. Infinity for directional lights, lights that don't fade with distance, or a cutoff of 0.
+    float influenceRadius(float cutoff) const;
+
+    // Spot light cone, precomputed so that testing a direction against it is a dot product
+    const vec3 &getSpotDirection() const;  // normalized
+    float getCosOuterAngle() const;        // cosine of the cone angle
+    float getCosInnerAngle() const;        // cosine of the angle where the falloff starts
+    float getFalloffScale() const;         // 1 / (cosInner - cosOuter), or 0 without a penumbra
 
 private:
-    float smoothFallOff(float x);
+    float smoothFallOff(float cosTheta) const;
     SceneLightData m_lightData;
     LightType m_type;
     float c1;
     float c2;
     float c3;
+    vec3 m_spotDirection;
+    float m_cosOuter;
+    float m_cosInner;
+    float m_falloffScale;
 };
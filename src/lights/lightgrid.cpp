@@ -0,0 +1,106 @@
+#include "lightgrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+bool isFinite(const AABB &box) {
+    return !glm::any(glm::isinf(box.min)) && !glm::any(glm::isinf(box.max)) &&
+           !glm::any(glm::isnan(box.min)) && !glm::any(glm::isnan(box.max));
+}
+
+bool overlaps(const AABB &a, const AABB &b) {
+    return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+}
+
+}
+
+/**
+ * @brief LightGrid::LightGrid bins the blocks of a light table. The grid spans the blocks' bounds clipped to the scene, and
+ *          its cells are roughly cubes, sized for about cellsPerBlock cells per binned block. Blocks whose bounds miss the
+ *          scene are dropped: no shaded point is within their reach.
+ */
+LightGrid::LightGrid(const LightTable &lights, const AABB &sceneBounds) {
+    std::vector<std::uint32_t> binned{};
+    AABB lightBounds{};
+    for (std::size_t b = 0; b < lights.blockCount(); b++) {
+        const AABB &bounds = lights.blockBounds(b);
+        if (!isFinite(bounds)) {
+            m_globalBlocks.push_back(std::uint32_t(b));
+        } else if (overlaps(bounds, sceneBounds)) {
+            binned.push_back(std::uint32_t(b));
+            lightBounds.expand(bounds);
+        }
+    }
+    if (binned.empty()) {
+        return;
+    }
+
+    // clip to the scene, with a margin so that shading points rounded just outside the scene still find their cell
+    m_bounds.min = glm::max(lightBounds.min, sceneBounds.min);
+    m_bounds.max = glm::min(lightBounds.max, sceneBounds.max);
+    glm::vec3 margin = 1e-4f * (m_bounds.max - m_bounds.min) + 1e-4f;
+    m_bounds.min -= margin;
+    m_bounds.max += margin;
+    glm::vec3 extent = m_bounds.max - m_bounds.min;
+    // flat scenes get one layer of cells along their thin axis instead of a cell size of 0
+    float largestExtent = std::max(std::max(extent.x, extent.y), extent.z);
+    glm::vec3 cubeExtent = glm::max(extent, glm::vec3(largestExtent / maxResolution));
+
+    double cellVolume = double(cubeExtent.x) * cubeExtent.y * cubeExtent.z / (double(binned.size()) * cellsPerBlock);
+    float cellSize = float(std::cbrt(cellVolume));
+    m_resolution = glm::clamp(glm::ivec3(glm::ceil(cubeExtent / cellSize)), glm::ivec3(1), glm::ivec3(maxResolution));
+    m_cellsPerUnit = glm::vec3(m_resolution) / extent;
+
+    // count the blocks of each cell, then fill the cells in block order
+    auto cellRange = [&](const AABB &bounds, glm::ivec3 &lo, glm::ivec3 &hi) {
+        lo = glm::clamp(glm::ivec3(glm::floor((bounds.min - m_bounds.min) * m_cellsPerUnit)), glm::ivec3(0), m_resolution - 1);
+        hi = glm::clamp(glm::ivec3(glm::floor((bounds.max - m_bounds.min) * m_cellsPerUnit)), glm::ivec3(0), m_resolution - 1);
+    };
+    auto cellIndex = [&](int x, int y, int z) {
+        return (std::size_t(z) * m_resolution.y + y) * m_resolution.x + x;
+    };
+    std::size_t cellCount = std::size_t(m_resolution.x) * m_resolution.y * m_resolution.z;
+    m_cellStart.assign(cellCount + 1, 0);
+    for (std::uint32_t b : binned) {
+        glm::ivec3 lo, hi;
+        cellRange(lights.blockBounds(b), lo, hi);
+        for (int z = lo.z; z <= hi.z; z++) {
+            for (int y = lo.y; y <= hi.y; y++) {
+                for (int x = lo.x; x <= hi.x; x++) {
+                    m_cellStart[cellIndex(x, y, z) + 1]++;
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < cellCount; i++) {
+        m_cellStart[i + 1] += m_cellStart[i];
+    }
+    m_cellBlocks.resize(m_cellStart[cellCount]);
+    std::vector<std::uint32_t> filled(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (std::uint32_t b : binned) {
+        glm::ivec3 lo, hi;
+        cellRange(lights.blockBounds(b), lo, hi);
+        for (int z = lo.z; z <= hi.z; z++) {
+            for (int y = lo.y; y <= hi.y; y++) {
+                for (int x = lo.x; x <= hi.x; x++) {
+                    m_cellBlocks[filled[cellIndex(x, y, z)]++] = b;
+                }
+            }
+        }
+    }
+}
+
+std::span<const std::uint32_t> LightGrid::cellBlocks(const glm::vec3 &position) const {
+    if (m_cellStart.empty()) {
+        return {};
+    }
+    glm::vec3 cell = (position - m_bounds.min) * m_cellsPerUnit;
+    if (glm::any(glm::lessThan(cell, glm::vec3(0))) || glm::any(glm::greaterThan(cell, glm::vec3(m_resolution)))) {
+        return {}; // outside the reach of every binned block
+    }
+    glm::ivec3 index = glm::min(glm::ivec3(cell), m_resolution - 1);
+    std::size_t i = (std::size_t(index.z) * m_resolution.y + index.y) * m_resolution.x + index.x;
+    return std::span<const std::uint32_t>(m_cellBlocks.data() + m_cellStart[i], m_cellStart[i + 1] - m_cellStart[i]);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "accel/aabb.h"
+#include "lights/lighttable.h"
+#include "stats/memstats.h"
+
+// A uniform grid over the scene that lists, for each cell, the light blocks whose influence bounds overlap the cell.
+// Blocks that reach everywhere (directional lights, or any light without an influence radius) are kept in a global
+// list instead. Shading a point visits the global blocks and the blocks of the point's cell, so the cost per hit
+// depends on how many lights overlap there rather than on the number of lights in the scene.
+class LightGrid {
+public:
+    LightGrid() = default;
+    // sceneBounds bounds every point that will be shaded; the grid covers its overlap with the blocks' bounds
+    LightGrid(const LightTable &lights, const AABB &sceneBounds);
+
+    // Blocks to shade at every point
+    std::span<const std::uint32_t> globalBlocks() const { return m_globalBlocks; }
+    // Blocks that may reach position, besides the global ones
+    std::span<const std::uint32_t> cellBlocks(const glm::vec3 &position) const;
+
+    // cells along x, y and z (0 if no block was binned)
+    const glm::ivec3 &resolution() const { return m_resolution; }
+
+private:
+    static constexpr int maxResolution = 128;  // cells along one axis
+    static constexpr int cellsPerBlock = 8;    // target cell count per binned block
+
+    AABB m_bounds{};
+    glm::ivec3 m_resolution{0};
+    glm::vec3 m_cellsPerUnit{0};
+    std::vector<std::uint32_t> m_globalBlocks{};
+    // the blocks of cell i are m_cellBlocks[m_cellStart[i], m_cellStart[i + 1])
+    MemoryStats::TrackedVector<std::uint32_t, MemoryCategory::MEM_ACCELERATION> m_cellStart{};
+    MemoryStats::TrackedVector<std::uint32_t, MemoryCategory::MEM_ACCELERATION> m_cellBlocks{};
+};
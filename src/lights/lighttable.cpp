@@ -0,0 +1,172 @@
+#include "lighttable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+namespace {
+
+LightBlockKind blockKind(LightType type) {
+    switch (type) {
+        case LightType::LIGHT_POINT:
+            return LightBlockKind::BLOCK_POINT;
+        case LightType::LIGHT_DIRECTIONAL:
+            return LightBlockKind::BLOCK_DIRECTIONAL;
+        case LightType::LIGHT_SPOT:
+            return LightBlockKind::BLOCK_SPOT;
+        default:
+            return LightBlockKind::BLOCK_MIXED;
+    }
+}
+
+// A black light of the given type that is harmless to evaluate anywhere
+void clearLane(LightBlock &block, int lane, LightType type) {
+    block.posX[lane] = block.posY[lane] = block.posZ[lane] = 0;
+    block.dirX[lane] = block.dirY[lane] = 0;
+    block.dirZ[lane] = 1;
+    block.colorR[lane] = block.colorG[lane] = block.colorB[lane] = 0;
+    block.c1[lane] = 1;
+    block.c2[lane] = block.c3[lane] = 0;
+    block.cosOuter[lane] = -1;
+    block.cosInner[lane] = 1;
+    block.falloffScale[lane] = 0;
+    block.radius[lane] = 0;
+    block.type[lane] = std::int32_t(type);
+}
+
+/**
+ * @brief influenceBounds bounds the points a light reaches within the given radius: a ball around point and area lights,
+ *          the spherical sector inside the cone for spot lights. Infinite for an infinite radius.
+ */
+AABB influenceBounds(const Light &light, float radius) {
+    if (std::isinf(radius)) {
+        return AABB{glm::vec3(-std::numeric_limits<float>::infinity()), glm::vec3(std::numeric_limits<float>::infinity())};
+    }
+    glm::vec3 position(light.getLightData().pos);
+    if (light.getType() != LightType::LIGHT_SPOT) {
+        return AABB{position - radius, position + radius};
+    }
+    // Along each axis e the sector reaches from its apex out to radius * cos(angle between e and the nearest direction
+    // in the cone), which is 1 if e itself is in the cone
+    float coneAngle = std::acos(std::clamp(light.getCosOuterAngle(), -1.f, 1.f));
+    const glm::vec3 &axis = light.getSpotDirection();
+    AABB bounds{};
+    bounds.expand(position);
+    for (int i = 0; i < 3; i++) {
+        float angleToAxis = std::acos(std::clamp(axis[i], -1.f, 1.f));
+        float farthest = std::cos(std::max(0.f, angleToAxis - coneAngle));
+        float farthestBack = std::cos(std::max(0.f, float(M_PI) - angleToAxis - coneAngle));
+        glm::vec3 extent(0);
+        extent[i] = farthest;
+        bounds.expand(position + radius * extent);
+        extent[i] = -farthestBack;
+        bounds.expand(position + radius * extent);
+    }
+    return bounds;
+}
+
+// Spreads the low 10 bits of v so that there are two zero bits between each of them
+std::uint32_t spreadBits(std::uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Morton code of point quantized to 10 bits per axis within bounds
+std::uint32_t mortonCode(const glm::vec3 &point, const AABB &bounds) {
+    glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+    glm::vec3 cell = glm::clamp((point - bounds.min) / extent * 1024.f, glm::vec3(0), glm::vec3(1023));
+    return (spreadBits(std::uint32_t(cell.x)) << 2) | (spreadBits(std::uint32_t(cell.y)) << 1) | spreadBits(std::uint32_t(cell.z));
+}
+
+}
+
+/**
+ * @brief LightTable::LightTable compiles the lights once, when the scene is built. Lights are stably sorted by type before
+ *          packing, so a scene with k light types has at most k-1 blocks that mix types; every other block is evaluated
+ *          by a kernel specialized for its type. Within a type, lights that reach everywhere come first, then the others
+ *          in Morton order of their position.
+ * @param cutoff smallest contribution worth shading (see Light::influenceRadius); 0 gives every light an infinite radius
+ */
+LightTable::LightTable(const std::vector<Light> &lights, float cutoff) :
+    m_lightCount(lights.size())
+{
+    std::vector<float> radii(lights.size());
+    AABB positions{};
+    for (std::size_t i = 0; i < lights.size(); i++) {
+        radii[i] = lights[i].influenceRadius(cutoff);
+        if (!std::isinf(radii[i])) {
+            positions.expand(glm::vec3(lights[i].getLightData().pos));
+        }
+    }
+    std::vector<std::uint32_t> morton(lights.size(), 0);
+    for (std::size_t i = 0; i < lights.size(); i++) {
+        if (!std::isinf(radii[i])) {
+            morton[i] = mortonCode(glm::vec3(lights[i].getLightData().pos), positions);
+        }
+    }
+
+    m_sceneIndices.resize(lights.size());
+    std::iota(m_sceneIndices.begin(), m_sceneIndices.end(), 0);
+    std::stable_sort(m_sceneIndices.begin(), m_sceneIndices.end(), [&](std::uint32_t a, std::uint32_t b) {
+        auto key = [&](std::uint32_t i) { return std::make_tuple(lights[i].getType(), !std::isinf(radii[i]), morton[i]); };
+        return key(a) < key(b);
+    });
+
+    m_blocks.resize((lights.size() + lightBlockLanes - 1) / lightBlockLanes);
+    m_blockBounds.assign(m_blocks.size(), AABB{});
+    for (std::size_t b = 0; b < m_blocks.size(); b++) {
+        LightBlock &block = m_blocks[b];
+        block.count = int(std::min<std::size_t>(lightBlockLanes, lights.size() - b * lightBlockLanes));
+        LightType firstType = lights[m_sceneIndices[b * lightBlockLanes]].getType();
+        block.kind = blockKind(firstType);
+
+        for (int lane = 0; lane < lightBlockLanes; lane++) {
+            if (lane >= block.count) {
+                clearLane(block, lane, firstType);
+                continue;
+            }
+            std::uint32_t sceneIndex = m_sceneIndices[b * lightBlockLanes + lane];
+            const Light &light = lights[sceneIndex];
+            const SceneLightData &data = light.getLightData();
+            if (light.getType() != firstType) {
+                block.kind = LightBlockKind::BLOCK_MIXED;
+            }
+            clearLane(block, lane, light.getType());
+
+            block.posX[lane] = data.pos.x;
+            block.posY[lane] = data.pos.y;
+            block.posZ[lane] = data.pos.z;
+            if (light.getType() == LightType::LIGHT_SPOT) {
+                const vec3 &dir = light.getSpotDirection();
+                block.dirX[lane] = dir.x;
+                block.dirY[lane] = dir.y;
+                block.dirZ[lane] = dir.z;
+                block.cosOuter[lane] = light.getCosOuterAngle();
+                block.cosInner[lane] = light.getCosInnerAngle();
+                block.falloffScale[lane] = light.getFalloffScale();
+            } else if (light.getType() != LightType::LIGHT_POINT) {
+                // directional and area lights shine from a fixed direction
+                vec3 dir = light.getDirToLight(vec3(0));
+                block.dirX[lane] = dir.x;
+                block.dirY[lane] = dir.y;
+                block.dirZ[lane] = dir.z;
+            }
+            block.colorR[lane] = data.color.r;
+            block.colorG[lane] = data.color.g;
+            block.colorB[lane] = data.color.b;
+            block.c1[lane] = data.function[0];
+            block.c2[lane] = data.function[1];
+            block.c3[lane] = data.function[2];
+            block.radius[lane] = radii[sceneIndex];
+            m_blockBounds[b].expand(influenceBounds(light, radii[sceneIndex]));
+        }
+    }
+    // padding lanes don't map to a light; their index is never read
+    m_sceneIndices.resize(m_blocks.size() * lightBlockLanes, 0);
+}
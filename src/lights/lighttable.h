@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "accel/aabb.h"
+#include "lights/light.h"
+#include "stats/memstats.h"
+
+constexpr int lightBlockLanes = 8;
+
+// What the lights of a block have in common, so shading can skip the terms that don't apply
+enum class LightBlockKind {
+    BLOCK_POINT,
+    BLOCK_DIRECTIONAL,
+    BLOCK_SPOT,
+    BLOCK_MIXED // several types, or area lights
+};
+
+// Up to 8 lights in structure-of-arrays layout, with everything shading needs precomputed. Unused lanes hold black
+// lights of the block's type, which contribute nothing.
+struct alignas(32) LightBlock {
+    float posX[lightBlockLanes], posY[lightBlockLanes], posZ[lightBlockLanes];  // point, spot and area lights
+    float dirX[lightBlockLanes], dirY[lightBlockLanes], dirZ[lightBlockLanes];  // normalized: toward a directional or
+                                                                                // area light, along a spot light's cone
+    float colorR[lightBlockLanes], colorG[lightBlockLanes], colorB[lightBlockLanes];
+    float c1[lightBlockLanes], c2[lightBlockLanes], c3[lightBlockLanes];        // attenuation 1/(c1 + c2*d + c3*d^2)
+    float cosOuter[lightBlockLanes];         // spot lights: cosine of the cone angle, beyond which there is no light
+    float cosInner[lightBlockLanes];         // spot lights: cosine of the angle where the falloff starts
+    float falloffScale[lightBlockLanes];     // spot lights: 1 / (cosInner - cosOuter), or 0 without a penumbra
+    float radius[lightBlockLanes];           // influence radius: the light is skipped beyond it (see LightTable)
+    std::int32_t type[lightBlockLanes];      // LightType of each lane
+    LightBlockKind kind;
+    int count;                               // lanes holding real lights
+};
+
+// The lights of a scene compiled for shading: grouped by type, so that most blocks hold a single type, and packed
+// into blocks of 8. With a cutoff, each light also gets an influence radius (Light::influenceRadius) beyond which it
+// is not shaded, and lights of a type are ordered along a space-filling curve so that the lights of a block are close
+// together and the block has tight bounds for LightGrid.
+class LightTable {
+public:
+    LightTable() = default;
+    explicit LightTable(const std::vector<Light> &lights, float cutoff = 0);
+
+    const LightBlock *blocks() const { return m_blocks.data(); }
+    std::size_t blockCount() const { return m_blocks.size(); }
+    // region every light of the block can reach; infinite if one of them reaches everywhere
+    const AABB &blockBounds(std::size_t block) const { return m_blockBounds[block]; }
+    // number of lights
+    std::size_t size() const { return m_lightCount; }
+    // index in the scene's light list of the light in the given lane of the given block
+    std::uint32_t sceneIndex(std::size_t block, int lane) const { return m_sceneIndices[block * lightBlockLanes + lane]; }
+
+private:
+    MemoryStats::TrackedVector<LightBlock, MemoryCategory::MEM_PRIMITIVES> m_blocks{};
+    std::vector<AABB> m_blockBounds{};
+    std::vector<std::uint32_t> m_sceneIndices{};
+    std::size_t m_lightCount = 0;
+};
@@ -0,0 +1,219 @@
+#include "lighttree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Importance tests shrink angles by this margin, so rounding never rules out a light that reaches the point
+constexpr float angleMargin = 1e-3f;
+
+float angleBetween(const glm::vec3 &a, const glm::vec3 &b) {
+    return std::acos(std::clamp(glm::dot(a, b), -1.f, 1.f));
+}
+
+/**
+ * @brief mergeCones returns the smallest cone (axis, angle) around two cones, or an angle of pi if it would cover every
+ *          direction
+ */
+void mergeCones(glm::vec3 axisA, float angleA, glm::vec3 axisB, float angleB, glm::vec3 &axis, float &angle) {
+    const float pi = 3.14159265f;
+    if (angleA >= pi || angleB >= pi) {
+        axis = axisA;
+        angle = pi;
+        return;
+    }
+    if (angleA < angleB) {
+        std::swap(axisA, axisB);
+        std::swap(angleA, angleB);
+    }
+    float between = angleBetween(axisA, axisB);
+    if (std::min(between + angleB, pi) <= angleA) {
+        axis = axisA; // b is inside a
+        angle = angleA;
+        return;
+    }
+    angle = 0.5f * (angleA + between + angleB);
+    glm::vec3 perpendicular = axisB - glm::dot(axisA, axisB) * axisA;
+    if (angle >= pi || glm::dot(perpendicular, perpendicular) < 1e-12f) {
+        axis = axisA;
+        angle = pi;
+        return;
+    }
+    // rotate a's axis toward b's until the cone touches both
+    float rotation = angle - angleA;
+    axis = glm::normalize(std::cos(rotation) * axisA + std::sin(rotation) * glm::normalize(perpendicular));
+}
+
+}
+
+/**
+ * @brief LightTree::LightTree builds the tree top-down, splitting the lights of a node at the median of their positions
+ *          along the axis where the positions spread the most. Black lights and lights with an influence radius of 0
+ *          are left out, as they never light anything.
+ */
+LightTree::LightTree(const LightTable &lights) {
+    std::vector<Node> leaves{};
+    m_leafOfSlot.assign(lights.blockCount() * lightBlockLanes, std::numeric_limits<std::uint32_t>::max());
+    for (std::size_t b = 0; b < lights.blockCount(); b++) {
+        const LightBlock &block = lights.blocks()[b];
+        for (int lane = 0; lane < block.count; lane++) {
+            std::uint32_t slot = std::uint32_t(b * lightBlockLanes + lane);
+            LightType type = LightType(block.type[lane]);
+            if (type != LightType::LIGHT_POINT && type != LightType::LIGHT_SPOT) {
+                m_globalSlots.push_back(slot);
+                continue;
+            }
+            float power = std::max(std::max(block.colorR[lane], block.colorG[lane]), block.colorB[lane]);
+            if (!(power > 0) || !(block.radius[lane] > 0)) {
+                continue;
+            }
+            Node leaf{};
+            leaf.bounds.expand(glm::vec3(block.posX[lane], block.posY[lane], block.posZ[lane]));
+            leaf.axis = glm::vec3(block.dirX[lane], block.dirY[lane], block.dirZ[lane]);
+            leaf.coneAngle = type == LightType::LIGHT_SPOT ? std::acos(std::clamp(block.cosOuter[lane], -1.f, 1.f)) : pi;
+            leaf.power = power;
+            leaf.c1 = block.c1[lane];
+            leaf.c2 = block.c2[lane];
+            leaf.c3 = block.c3[lane];
+            leaf.radius = block.radius[lane];
+            leaf.first = slot;
+            leaf.leaf = true;
+            leaves.push_back(leaf);
+        }
+    }
+    if (leaves.empty()) {
+        return;
+    }
+    m_nodes.reserve(2 * leaves.size() - 1);
+    m_parents.reserve(2 * leaves.size() - 1);
+    m_nodes.emplace_back();
+    m_parents.push_back(0);
+    build(0, leaves, 0, leaves.size());
+}
+
+void LightTree::build(std::uint32_t nodeIdx, std::vector<Node> &leaves, std::size_t begin, std::size_t end) {
+    if (end - begin == 1) {
+        m_nodes[nodeIdx] = leaves[begin];
+        m_leafOfSlot[leaves[begin].first] = nodeIdx;
+        return;
+    }
+    AABB centroids{};
+    for (std::size_t i = begin; i < end; i++) {
+        centroids.expand(leaves[i].bounds.centroid());
+    }
+    glm::vec3 extent = centroids.max - centroids.min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    std::size_t mid = (begin + end) / 2;
+    std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end, [axis](const Node &a, const Node &b) {
+        return a.bounds.centroid()[axis] < b.bounds.centroid()[axis];
+    });
+
+    std::uint32_t first = std::uint32_t(m_nodes.size());
+    m_nodes.resize(m_nodes.size() + 2);
+    m_parents.push_back(nodeIdx);
+    m_parents.push_back(nodeIdx);
+    build(first, leaves, begin, mid);
+    build(first + 1, leaves, mid, end);
+
+    const Node &left = m_nodes[first];
+    const Node &right = m_nodes[first + 1];
+    Node node{};
+    node.bounds = left.bounds;
+    node.bounds.expand(right.bounds);
+    mergeCones(left.axis, left.coneAngle, right.axis, right.coneAngle, node.axis, node.coneAngle);
+    node.power = left.power + right.power;
+    node.c1 = std::min(left.c1, right.c1);
+    node.c2 = std::min(left.c2, right.c2);
+    node.c3 = std::min(left.c3, right.c3);
+    node.radius = std::max(left.radius, right.radius);
+    node.first = first;
+    node.leaf = false;
+    m_nodes[nodeIdx] = node;
+}
+
+/**
+ * @brief LightTree::importance estimates how much the lights of a node can add at a point: their power, attenuated
+ *          over the distance to the node's center. It is 0 only where no light of the node can reach, because the
+ *          point is beyond every influence radius, outside every spot cone, or faces away from the whole node. Those
+ *          tests are conservative, so every light that lights the point has a chance of being sampled.
+ */
+float LightTree::importance(const Node &node, const glm::vec3 &position, const glm::vec3 &normal) const {
+    glm::vec3 toNode = node.bounds.centroid() - position;
+    float distance = glm::length(toNode);
+    float halfDiagonal = 0.5f * glm::length(node.bounds.max - node.bounds.min);
+    if (distance - halfDiagonal > node.radius) {
+        return 0;
+    }
+
+    if (distance > halfDiagonal) {
+        // the node's bounding sphere spans directions within boundAngle of toNode
+        glm::vec3 dirToNode = toNode / distance;
+        float boundAngle = std::asin(halfDiagonal / distance);
+        // lights behind the surface don't light it
+        if (angleBetween(normal, dirToNode) - boundAngle - angleMargin >= 0.5f * pi) {
+            return 0;
+        }
+        // spot lights don't light points outside their cones
+        if (node.coneAngle < pi && angleBetween(node.axis, -dirToNode) - boundAngle - angleMargin > node.coneAngle) {
+            return 0;
+        }
+    }
+
+    float falloff = node.c1 + distance * node.c2 + distance * distance * node.c3;
+    float attenuation = falloff > 1 ? 1 / falloff : 1.f;
+    return node.power * attenuation;
+}
+
+bool LightTree::sample(const glm::vec3 &position, const glm::vec3 &normal, Rng &rng, Sample &sample) const {
+    if (m_nodes.empty() || !(importance(m_nodes[0], position, normal) > 0)) {
+        return false;
+    }
+    float probability = 1;
+    std::uint32_t nodeIdx = 0;
+    while (!m_nodes[nodeIdx].leaf) {
+        std::uint32_t first = m_nodes[nodeIdx].first;
+        float left = importance(m_nodes[first], position, normal);
+        float right = importance(m_nodes[first + 1], position, normal);
+        left = left > 0 ? left : 0; // NaN counts as 0
+        right = right > 0 ? right : 0;
+        if (left + right <= 0) {
+            return false;
+        }
+        float pLeft = left / (left + right);
+        if (rng.nextFloat() < pLeft) {
+            nodeIdx = first;
+            probability *= pLeft;
+        } else {
+            nodeIdx = first + 1;
+            probability *= 1 - pLeft;
+        }
+    }
+    sample.slot = m_nodes[nodeIdx].first;
+    sample.probability = probability;
+    return probability > 0;
+}
+
+float LightTree::probability(std::uint32_t slot, const glm::vec3 &position, const glm::vec3 &normal) const {
+    if (slot >= m_leafOfSlot.size() || m_leafOfSlot[slot] == std::numeric_limits<std::uint32_t>::max() ||
+        !(importance(m_nodes[0], position, normal) > 0)) {
+        return 0;
+    }
+    float probability = 1;
+    std::uint32_t nodeIdx = m_leafOfSlot[slot];
+    while (nodeIdx != 0) {
+        std::uint32_t first = m_nodes[m_parents[nodeIdx]].first;
+        float left = importance(m_nodes[first], position, normal);
+        float right = importance(m_nodes[first + 1], position, normal);
+        left = left > 0 ? left : 0;
+        right = right > 0 ? right : 0;
+        float mine = nodeIdx == first ? left : right;
+        if (!(mine > 0)) {
+            return 0;
+        }
+        probability *= mine / (left + right);
+        nodeIdx = m_parents[nodeIdx];
+    }
+    return probability;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "accel/aabb.h"
+#include "lights/lighttable.h"
+#include "stats/memstats.h"
+#include "utils/rng.h"
+
+// A bounding volume hierarchy over the point and spot lights of a light table, for picking lights at random in
+// proportion to how much they may light a point. Every node bounds its lights' positions, the directions they shine
+// in (a cone), their total power and how little they can be attenuated. Directional and area lights are not in the
+// tree: they shine from a fixed direction rather than from their position, so shading evaluates them all.
+class LightTree {
+public:
+    // A light picked by sample(): slot is the light's position in the table (block * lightBlockLanes + lane)
+    struct Sample {
+        std::uint32_t slot;
+        float probability;
+    };
+
+    LightTree() = default;
+    explicit LightTree(const LightTable &lights);
+
+    bool empty() const { return m_nodes.empty(); }
+    // table slots of the directional and area lights, which are left out of the tree
+    const std::vector<std::uint32_t> &globalSlots() const { return m_globalSlots; }
+
+    // Picks one light by walking down from the root, choosing each child with probability proportional to its
+    // importance at position (with surface normal). Returns false if no light in the tree can reach the point.
+    bool sample(const glm::vec3 &position, const glm::vec3 &normal, Rng &rng, Sample &sample) const;
+
+    // Probability that sample() picks the light in slot, for weighting samples obtained some other way
+    float probability(std::uint32_t slot, const glm::vec3 &position, const glm::vec3 &normal) const;
+
+private:
+    static constexpr float pi = 3.14159265f;
+
+    // Interior nodes have children at m_nodes[first] and m_nodes[first + 1]; leaves hold the light in slot first.
+    struct Node {
+        AABB bounds;
+        glm::vec3 axis;      // the lights shine within coneAngle of axis
+        float coneAngle;     // pi for nodes with a point or area light
+        float power;         // sum of the lights' brightest color channels
+        float c1, c2, c3;    // smallest attenuation coefficients of the lights
+        float radius;        // largest influence radius of the lights
+        std::uint32_t first;
+        bool leaf;
+    };
+
+    float importance(const Node &node, const glm::vec3 &position, const glm::vec3 &normal) const;
+    void build(std::uint32_t nodeIdx, std::vector<Node> &leaves, std::size_t begin, std::size_t end);
+
+    MemoryStats::TrackedVector<Node, MemoryCategory::MEM_ACCELERATION> m_nodes{};
+    std::vector<std::uint32_t> m_parents{};        // of every node; the root is its own parent
+    std::vector<std::uint32_t> m_leafOfSlot{};     // node of every table slot in the tree
+    std::vector<std::uint32_t> m_globalSlots{};
+};
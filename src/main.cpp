@@ -1,12 +1,64 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
-#include <QImage>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
 #include <QtCore>
 
 #include <iostream>
 #include "utils/sceneparser.h"
 #include "raytracer/raytracer.h"
 #include "raytracer/raytracescene.h"
+#include "utils/rendersettings.h"
+#include "distributed/tilecoordinator.h"
+#include "distributed/tileworker.h"
+#include "sequence/sequence.h"
+#include "pipeline/renderpipeline.h"
+#include "output/streamingrender.h"
+#include "output/imageoutput.h"
+#include "output/costheatmap.h"
+#include "stats/raystats.h"
+#include "stats/perfcounters.h"
+#include "stats/progress.h"
+
+/**
+ * @brief reportRenderStats prints the counters, phase times and memory use gathered during the render to stdout
+ * @param jsonPath if not empty, the same stats are also written to this file as JSON
+ * @param tracePath if not empty, the timeline recorded since startup is written to this file as a Chrome trace
+ * @param heatmapLegend legend of the cost heatmap written with the image, if any; added to the JSON as "heatmap"
+ * @return false if a file could not be written
+ */
+static bool reportRenderStats(const QString &jsonPath, const QString &tracePath, const QJsonObject &heatmapLegend = QJsonObject()) {
+    bool success = tracePath.isEmpty() || Trace::writeChromeTrace(tracePath);
+    RenderStats stats = RayStats::snapshotStats();
+    RayStats::printSummary(std::cout, stats);
+    PerfCounters::printSummary(std::cout);
+    MemoryStats::printSummary(std::cout);
+    if (jsonPath.isEmpty()) {
+        return success;
+    }
+    QJsonObject json = RayStats::toJson(stats);
+    json.insert("hardwareCounters", PerfCounters::toJson());
+    json.insert("memory", MemoryStats::toJson());
+    if (!heatmapLegend.isEmpty()) {
+        json.insert("heatmap", heatmapLegend);
+    }
+    QFile file(jsonPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        file.write(QJsonDocument(json).toJson()) < 0) {
+        std::cerr << "Error: failed to write render stats to \"" << jsonPath.toStdString() << "\"" << std::endl;
+        return false;
+    }
+    return success;
+}
+
+/**
+ * @brief parseScene reads the scene file, timing it as the parse phase
+ */
+static bool parseScene(const std::string &scenePath, RenderData &metaData) {
+    RayStats::PhaseTimer parseTimer(RenderPhase::PHASE_PARSE);
+    return SceneParser::parse(scenePath, metaData);
+}
 
 int main(int argc, char *argv[])
 {
@@ -14,70 +66,248 @@ int main(int argc, char *argv[])
 
     QCommandLineParser parser;
     parser.addHelpOption();
-    parser.addPositionalArgument("config", "Path of the config file.");
+    parser.addPositionalArgument("config", "Path of the config file. Several config files are rendered as a batch with overlapping load, render and save phases.", "config...");
+    QCommandLineOption workerOption("worker", "Render tiles for the coordinator listening at <address>.", "host:port");
+    parser.addOption(workerOption);
+    QCommandLineOption statsOption("stats", "Also write the render counters and phase times to <file> as JSON.", "file");
+    parser.addOption(statsOption);
+    QCommandLineOption traceOption("trace", "Record a timeline of render phases, texture decodes and tiles per thread and write it to <file> as a Chrome trace (open in ui.perfetto.dev).", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption perfOption("perf", "Count cycles, instructions, cache and branch misses per render stage with Linux perf events.");
+    parser.addOption(perfOption);
+    QCommandLineOption perfSampleOption("perf-sample", "Split every <n>-th pixel's hardware counts into intersection and shading work.", "n", "64");
+    parser.addOption(perfSampleOption);
+    QCommandLineOption memoryCapOption("memory-cap", "Stop with an error instead of letting scene data, textures, acceleration structures and framebuffers grow past <MB>.", "MB");
+    parser.addOption(memoryCapOption);
+    QCommandLineOption progressOption("progress", "Print progress, rays/s and an ETA to stderr while rendering.");
+    parser.addOption(progressOption);
+    QCommandLineOption progressFileOption("progress-file", "Keep <file> updated with the render progress as JSON.", "file");
+    parser.addOption(progressFileOption);
+    QCommandLineOption progressSocketOption("progress-socket", "Send the render progress as lines of JSON to <address>.", "host:port");
+    parser.addOption(progressSocketOption);
+    QCommandLineOption progressIntervalOption("progress-interval", "Report progress every <seconds>.", "seconds", "1");
+    parser.addOption(progressIntervalOption);
     parser.process(a);
 
+    if (parser.isSet(memoryCapOption)) {
+        bool valid = false;
+        double capMB = parser.value(memoryCapOption).toDouble(&valid);
+        if (!valid || capMB <= 0) {
+            std::cerr << "Error: --memory-cap expects a positive number of megabytes" << std::endl;
+            return 1;
+        }
+        MemoryStats::setCap(std::size_t(capMB * 1024 * 1024));
+    }
+
+    if (parser.isSet(perfOption)) {
+        std::string perfError;
+        if (!PerfCounters::start(parser.value(perfSampleOption).toInt(), perfError)) {
+            std::cerr << "Warning: hardware counters are unavailable, rendering without them: " << perfError << std::endl;
+        } else if (!perfError.empty()) {
+            std::cerr << "Warning: " << perfError << std::endl;
+        }
+    }
+
+    if (parser.isSet(traceOption)) {
+        Trace::start();
+        Trace::setThreadName("main");
+    }
+
+    if (parser.isSet(workerOption)) {
+        // workers receive their config from the coordinator
+        return runTileWorker(parser.value(workerOption));
+    }
+
+    ProgressOptions progressOptions;
+    progressOptions.console = parser.isSet(progressOption);
+    progressOptions.statusPath = parser.value(progressFileOption);
+    progressOptions.socketAddress = parser.value(progressSocketOption);
+    progressOptions.intervalMs = int(parser.value(progressIntervalOption).toDouble() * 1000);
+    // only renders in this process report progress; null turns the pre-pass and the counting off
+    RenderProgress progress;
+    RenderProgress *progressTarget = progressOptions.enabled() ? &progress : nullptr;
+    ProgressReporter progressReporter{ progress, progressOptions };
+
     auto positionalArgs = parser.positionalArguments();
-    if (positionalArgs.size() != 1) {
+    if (positionalArgs.size() < 1) {
         std::cerr << "Not enough arguments. Please provide a path to a config file (.ini) as a command-line argument." << std::endl;
         a.exit(1);
         return 1;
     }
+    if (positionalArgs.size() > 1) {
+        if (progressTarget) {
+            std::cerr << "Warning: progress is not reported for batches" << std::endl;
+        }
+        bool success = runRenderPipeline(positionalArgs);
+        a.exit(success ? 0 : 1);
+        return success ? 0 : 1;
+    }
 
-    QSettings settings( positionalArgs[0], QSettings::IniFormat );
-    QString iScenePath = settings.value("IO/scene").toString();
-    QString oImagePath = settings.value("IO/output").toString();
+    RenderSettings settings = loadRenderSettings(positionalArgs[0]);
+    QString iScenePath = settings.scenePath;
+    QString oImagePath = settings.outputPath;
 
-    RenderData metaData;
-    bool success = SceneParser::parse(iScenePath.toStdString(), metaData);
+    int width = settings.width;
+    int height = settings.height;
 
-    if (!success) {
-        std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
-        a.exit(1);
-        return 1;
+    CostMetric costMetric = settings.rtConfig.costMetric;
+    if (costMetric != CostMetric::COST_NONE && !costMetricAvailable(costMetric)) {
+        std::cerr << "Warning: the " << costMetricName(costMetric) << " heatmap needs instrumentation "
+                  << "(RAYTRACER_INSTRUMENTATION); no heatmap is written" << std::endl;
+        costMetric = settings.rtConfig.costMetric = CostMetric::COST_NONE;
+    }
+    if (costMetric != CostMetric::COST_NONE && (settings.sequence || settings.streaming || settings.distributed)) {
+        std::cerr << "Warning: cost heatmaps are only written for single images rendered in this process" << std::endl;
+        costMetric = settings.rtConfig.costMetric = CostMetric::COST_NONE;
     }
 
-    // Raytracing-relevant code starts here
+    if (settings.sequence) {
+        // the scene and its textures are loaded once and reused by every frame
+        RenderData metaData;
+        if (!parseScene(iScenePath.toStdString(), metaData)) {
+            std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        RayTraceScene rtScene{ width, height, metaData, settings.lightCutoff };
 
-    int width = settings.value("Canvas/width").toInt();
-    int height = settings.value("Canvas/height").toInt();
+        std::vector<SequenceFrame> frames = loadSequenceFrames(positionalArgs[0], settings, metaData.cameraData);
+        if (frames.empty()) {
+            std::cerr << "Error: no frames to render in the [Sequence] section" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        progress.expectPixels(std::uint64_t(frames.size()) * width * height);
+        progressReporter.start();
+        bool success;
+        {
+            RayStats::PhaseTimer renderTimer(RenderPhase::PHASE_RENDER);
+            success = renderSequence(frames, rtScene, settings.imageOptions, progressTarget);
+        }
+        progressReporter.finish();
+        success = reportRenderStats(parser.value(statsOption), parser.value(traceOption)) && success;
+        a.exit(success ? 0 : 1);
+        return success ? 0 : 1;
+    }
+
+    if (settings.streaming) {
+        // the image is written band by band and never exists in memory as a whole
+        std::unique_ptr<ImageStreamWriter> writer = createImageStreamWriter(oImagePath, settings.imageOptions);
+        if (!writer) {
+            std::cerr << "Error: streaming output supports .ppm, .pfm and .png files, got \"" << oImagePath.toStdString() << "\"" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        RenderData metaData;
+        if (!parseScene(iScenePath.toStdString(), metaData)) {
+            std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        RayTracer raytracer{ settings.rtConfig };
+        RayTraceScene rtScene{ width, height, metaData, settings.lightCutoff };
+        raytracer.setProgress(progressTarget);
+        progress.expectPixels(std::uint64_t(settings.crop.width) * settings.crop.height);
+        progressReporter.start();
+        bool success;
+        {
+            // encoding overlaps with rendering here, so it is part of the render phase
+            RayStats::PhaseTimer renderTimer(RenderPhase::PHASE_RENDER);
+            success = renderStreaming(raytracer, rtScene, settings.crop, *writer, oImagePath, settings.bandHeight, settings.maxBands);
+        }
+        progressReporter.finish();
+        if (success) {
+            std::cout << "Saved rendered image to \"" << oImagePath.toStdString() << "\"" << std::endl;
+        } else {
+            std::cerr << "Error: failed to save image to \"" << oImagePath.toStdString() << "\"" << std::endl;
+        }
+        success = reportRenderStats(parser.value(statsOption), parser.value(traceOption)) && success;
+        a.exit(success ? 0 : 1);
+        return success ? 0 : 1;
+    }
 
-    // Extracting data pointer from Qt's image API
-    QImage image = QImage(width, height, QImage::Format_RGBX8888);
-    image.fill(Qt::black);
-    RGBA *data = reinterpret_cast<RGBA *>(image.bits());
+    // HDR framebuffer holding only the crop window; it is tone mapped when saved
+    const Tile &crop = settings.crop;
+    Framebuffer framebuffer(std::size_t(crop.width) * crop.height, SceneColor(0, 0, 0, 1));
+    SceneColor *data = framebuffer.data();
+    // per-pixel costs for the heatmap, laid out like the framebuffer
+    MemoryStats::TrackedVector<float, MemoryCategory::MEM_FRAMEBUFFERS> costs(costMetric != CostMetric::COST_NONE ? framebuffer.size() : 0);
 
-    // Setting up the raytracer
-    RayTracer::Config rtConfig{};
-    rtConfig.enableShadow        = settings.value("Feature/shadows").toBool();
-    rtConfig.enableReflection    = settings.value("Feature/reflect").toBool();
-    rtConfig.enableRefraction    = settings.value("Feature/refract").toBool();
-    rtConfig.enableTextureMap    = settings.value("Feature/texture").toBool();
-    rtConfig.enableTextureFilter = settings.value("Feature/texture-filter").toBool();
-    rtConfig.enableParallelism   = settings.value("Feature/parallel").toBool();
-    rtConfig.enableSuperSample   = settings.value("Feature/super-sample").toBool();
-    rtConfig.enableAcceleration  = settings.value("Feature/acceleration").toBool();
-    rtConfig.enableDepthOfField  = settings.value("Feature/depthoffield").toBool();
+    QElapsedTimer timer;
+    timer.start();
 
-    RayTracer raytracer{ rtConfig };
+    bool success;
+    if (settings.distributed) {
+        // workers parse the scene themselves, so the coordinator only assembles their tiles
+        if (progressTarget) {
+            std::cerr << "Warning: progress is not reported for distributed renders" << std::endl;
+        }
+        TileCoordinator coordinator{ positionalArgs[0], settings };
+        {
+            RayStats::PhaseTimer renderTimer(RenderPhase::PHASE_RENDER);
+            success = coordinator.render(data);
+        }
+        if (!success) {
+            std::cerr << "Error: distributed render of \"" << iScenePath.toStdString() << "\" did not complete" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+    } else {
+        RenderData metaData;
+        success = parseScene(iScenePath.toStdString(), metaData);
 
-    RayTraceScene rtScene{ width, height, metaData };
+        if (!success) {
+            std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
+            a.exit(1);
+            return 1;
+        }
 
-    // Note that we're passing `data` as a pointer (to its first element)
-    // Recall from Lab 1 that you can access its elements like this: `data[i]`
-    raytracer.render(data, rtScene);
+        // Raytracing-relevant code starts here
+
+        // Setting up the raytracer
+        RayTracer raytracer{ settings.rtConfig };
+
+        RayTraceScene rtScene{ width, height, metaData, settings.lightCutoff };
+
+        // Note that we're passing `data` as a pointer (to its first element)
+        // Recall from Lab 1 that you can access its elements like this: `data[i]`
+        raytracer.setProgress(progressTarget);
+        progressReporter.start();
+        {
+            RayStats::PhaseTimer renderTimer(RenderPhase::PHASE_RENDER);
+            raytracer.renderTile(data, crop.width, crop, rtScene, costs.empty() ? nullptr : costs.data());
+        }
+        progressReporter.finish();
+    }
+
+    qint64 renderMs = timer.restart();
 
     // Saving the image
-    success = image.save(oImagePath);
-    if (!success) {
-        success = image.save(oImagePath, "PNG");
+    {
+        RayStats::PhaseTimer encodeTimer(RenderPhase::PHASE_ENCODE);
+        success = saveFramebuffer(data, crop.width, crop.height, oImagePath, settings.imageOptions);
     }
+    qint64 encodeMs = timer.elapsed();
     if (success) {
         std::cout << "Saved rendered image to \"" << oImagePath.toStdString() << "\"" << std::endl;
+        std::cout << "Render: " << renderMs << " ms, encode: " << encodeMs << " ms" << std::endl;
     } else {
         std::cerr << "Error: failed to save image to \"" << oImagePath.toStdString() << "\"" << std::endl;
     }
 
+    QJsonObject heatmapLegend;
+    if (!costs.empty()) {
+        QString heatmapPath = costHeatmapPath(oImagePath);
+        if (writeCostHeatmap(costs.data(), crop.width, crop.height, costMetric, heatmapPath, settings.imageOptions, heatmapLegend)) {
+            std::cout << "Saved " << costMetricName(costMetric) << " heatmap to \"" << heatmapPath.toStdString() << "\" ("
+                      << heatmapLegend["min"].toDouble() << " to " << heatmapLegend["max"].toDouble() << " "
+                      << costMetricUnit(costMetric) << " per pixel)" << std::endl;
+        } else {
+            std::cerr << "Error: failed to save heatmap to \"" << heatmapPath.toStdString() << "\"" << std::endl;
+        }
+    }
+    reportRenderStats(parser.value(statsOption), parser.value(traceOption), heatmapLegend);
+
     a.exit();
     return 0;
 }
@@ -0,0 +1,33 @@
+#include "materialtable.h"
+
+MaterialTable::MaterialTable(const SceneGlobalData &globalData) :
+    m_globalData(globalData)
+{}
+
+/**
+ * @brief MaterialTable::intern premultiplies the material's colors with the global coefficients and looks the result
+ *          up. Materials are compared after premultiplying, so materials that shade the same share an entry even if
+ *          they differ in fields shading never reads (texture file names, refraction, emission).
+ * @return index of the material in the table
+ */
+std::uint32_t MaterialTable::intern(const SceneMaterial &material) {
+    ShadingMaterial shading{};
+    shading.ambient = m_globalData.ka * glm::vec3(material.cAmbient);
+    shading.diffuse = (1 - material.blend) * (m_globalData.kd * glm::vec3(material.cDiffuse));
+    shading.specular = m_globalData.ks * glm::vec3(material.cSpecular);
+    shading.reflective = m_globalData.ks * glm::vec3(material.cReflective);
+    shading.shininess = material.shininess;
+    shading.blend = material.blend;
+    shading.textured = material.textureMap.isUsed;
+
+    Key key{shading.ambient.r, shading.ambient.g, shading.ambient.b,
+            shading.diffuse.r, shading.diffuse.g, shading.diffuse.b,
+            shading.specular.r, shading.specular.g, shading.specular.b,
+            shading.reflective.r, shading.reflective.g, shading.reflective.b,
+            shading.shininess, shading.blend, shading.textured ? 1.f : 0.f};
+    auto [entry, inserted] = m_indices.try_emplace(key, std::uint32_t(m_materials.size()));
+    if (inserted) {
+        m_materials.push_back(shading);
+    }
+    return entry->second;
+}
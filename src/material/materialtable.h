@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <glm/glm.hpp>
+#include "utils/scenedata.h"
+#include "stats/memstats.h"
+
+// A material with the scene's global coefficients folded in, ready for shading. One cache line each, so shading a hit
+// touches a single line of material data and never a string.
+struct alignas(64) ShadingMaterial {
+    glm::vec3 ambient;    // ka * cAmbient
+    glm::vec3 diffuse;    // kd * cDiffuse * (1 - blend): the part of the diffuse color not taken from the texture
+    glm::vec3 specular;   // ks * cSpecular
+    glm::vec3 reflective; // ks * cReflective
+    float shininess;
+    float blend;          // weight of the texture color in the diffuse term
+    bool textured;
+};
+
+static_assert(sizeof(ShadingMaterial) == 64, "materials are meant to fill one cache line");
+
+// The distinct materials of a scene, in a flat array that primitives refer to by index. Primitives with equal
+// materials share an entry.
+class MaterialTable {
+public:
+    MaterialTable() = default;
+    explicit MaterialTable(const SceneGlobalData &globalData);
+
+    // Returns the index of material, adding it to the table if no equal material is there yet
+    std::uint32_t intern(const SceneMaterial &material);
+
+    const ShadingMaterial &operator[](std::uint32_t index) const { return m_materials[index]; }
+    std::size_t size() const { return m_materials.size(); }
+
+private:
+    using Key = std::array<float, 15>; // every field of ShadingMaterial
+
+    SceneGlobalData m_globalData{};
+    MemoryStats::TrackedVector<ShadingMaterial, MemoryCategory::MEM_PRIMITIVES> m_materials{};
+    std::map<Key, std::uint32_t> m_indices{};
+};
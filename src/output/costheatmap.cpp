@@ -0,0 +1,95 @@
+#include "costheatmap.h"
+
+#include <QFileInfo>
+#include <QJsonArray>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "imageoutput.h"
+
+namespace {
+
+// Samples of the "inferno" color map: dark pixels are cheap, bright ones expensive, and the ramp stays readable in
+// grayscale
+const glm::vec3 rampStops[] = {
+    glm::vec3(0.001f, 0.000f, 0.014f),
+    glm::vec3(0.341f, 0.062f, 0.431f),
+    glm::vec3(0.735f, 0.216f, 0.330f),
+    glm::vec3(0.976f, 0.557f, 0.035f),
+    glm::vec3(0.988f, 1.000f, 0.643f),
+};
+constexpr int rampStopCount = sizeof(rampStops) / sizeof(rampStops[0]);
+
+glm::vec3 rampColor(float t) {
+    float x = std::clamp(t, 0.f, 1.f) * (rampStopCount - 1);
+    int stop = std::min(int(x), rampStopCount - 2);
+    return glm::mix(rampStops[stop], rampStops[stop + 1], x - stop);
+}
+
+QString hexColor(const glm::vec3 &color) {
+    char hex[8];
+    std::snprintf(hex, sizeof(hex), "#%02x%02x%02x", int(std::lround(color.r * 255)), int(std::lround(color.g * 255)),
+                  int(std::lround(color.b * 255)));
+    return QString(hex);
+}
+
+}
+
+QString costHeatmapPath(const QString &imagePath) {
+    QFileInfo info(imagePath);
+    return info.path() + "/" + info.completeBaseName() + ".cost.png";
+}
+
+/**
+ * @brief writeCostHeatmap maps log(1 + cost) linearly onto the ramp between the cheapest and the most expensive pixel.
+ *          The log scale keeps the bulk of cheap pixels distinguishable next to the few that cost orders of magnitude
+ *          more (deep reflections, pixels crossing many bounding boxes).
+ */
+bool writeCostHeatmap(const float *costs, int width, int height, CostMetric metric, const QString &path,
+                      const ImageWriterOptions &options, QJsonObject &legend) {
+    std::size_t pixelCount = std::size_t(width) * height;
+    if (pixelCount == 0) {
+        return false;
+    }
+    auto [minIt, maxIt] = std::minmax_element(costs, costs + pixelCount);
+    double minCost = *minIt;
+    double maxCost = *maxIt;
+    double totalCost = 0;
+    for (std::size_t i = 0; i < pixelCount; i++) {
+        totalCost += costs[i];
+    }
+
+    double logMin = std::log1p(minCost);
+    double logRange = std::log1p(maxCost) - logMin;
+    std::vector<SceneColor> heatmap(pixelCount);
+    for (std::size_t i = 0; i < pixelCount; i++) {
+        float t = logRange > 0 ? float((std::log1p(costs[i]) - logMin) / logRange) : 0.f;
+        heatmap[i] = SceneColor(rampColor(t), 1);
+    }
+
+    QJsonArray stops;
+    for (int stop = 0; stop < rampStopCount; stop++) {
+        double t = double(stop) / (rampStopCount - 1);
+        stops.append(QJsonObject{
+            {"value", std::expm1(logMin + t * logRange)},
+            {"color", hexColor(rampStops[stop])},
+        });
+    }
+    legend = QJsonObject{
+        {"image", path},
+        {"metric", costMetricName(metric)},
+        {"unit", costMetricUnit(metric)},
+        {"scale", "log"},
+        {"min", minCost},
+        {"max", maxCost},
+        {"mean", totalCost / pixelCount},
+        {"total", totalCost},
+        {"stops", stops},
+    };
+
+    // the ramp colors are final display values
+    ImageWriterOptions heatmapOptions = options;
+    heatmapOptions.toneMap = ToneMapSettings{};
+    return saveFramebuffer(heatmap.data(), width, height, path, heatmapOptions);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include "imagestreamwriter.h"
+#include "stats/pixelcost.h"
+
+// Path of the heatmap written next to an image: "out/frame.png" becomes "out/frame.cost.png"
+QString costHeatmapPath(const QString &imagePath);
+
+// Colors width * height per-pixel costs with a logarithmic black-purple-orange-yellow ramp and saves them to path.
+// @param legend receives the metric, its unit, the value range and the value at every color stop of the ramp
+// @return true if the image was written
+bool writeCostHeatmap(const float *costs, int width, int height, CostMetric metric, const QString &path,
+                      const ImageWriterOptions &options, QJsonObject &legend);
@@ -0,0 +1,20 @@
+#include "imageoutput.h"
+
+#include <QImage>
+#include "tonemap.h"
+
+bool saveFramebuffer(const SceneColor *pixels, int width, int height, const QString &path, const ImageWriterOptions &options) {
+    std::unique_ptr<ImageStreamWriter> writer = createImageStreamWriter(path, options);
+    if (writer) {
+        bool success = writer->open(path, width, height) && writer->writeRows(pixels, height);
+        return writer->close() && success;
+    }
+
+    QImage image = QImage(width, height, QImage::Format_RGBX8888);
+    toneMap(pixels, reinterpret_cast<RGBA *>(image.bits()), std::size_t(width) * height, options.toneMap);
+    bool success = image.save(path);
+    if (!success) {
+        success = image.save(path, "PNG");
+    }
+    return success;
+}
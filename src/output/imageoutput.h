@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QString>
+#include "imagestreamwriter.h"
+#include "utils/scenedata.h"
+#include "stats/memstats.h"
+
+// HDR framebuffer of linear colors, accounted as MemoryCategory::MEM_FRAMEBUFFERS
+using Framebuffer = MemoryStats::TrackedVector<SceneColor, MemoryCategory::MEM_FRAMEBUFFERS>;
+
+// Saves a whole framebuffer of linear colors to path. .ppm, .pfm and .png files go through the built-in stream writers;
+// any other format Qt supports is tone mapped into a QImage first, and unknown extensions fall back to PNG data.
+// @return true if the image was written
+bool saveFramebuffer(const SceneColor *pixels, int width, int height, const QString &path, const ImageWriterOptions &options);
@@ -0,0 +1,260 @@
+#include "imagestreamwriter.h"
+
+#include <bit>
+#include <cstring>
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <zlib.h>
+
+std::unique_ptr<ImageStreamWriter> createImageStreamWriter(const QString &path, const ImageWriterOptions &options) {
+    QString extension = QFileInfo(path).suffix().toLower();
+    if (extension == "ppm") {
+        return std::make_unique<PPMWriter>(options.toneMap);
+    } else if (extension == "pfm") {
+        return std::make_unique<PFMWriter>();
+    } else if (extension == "png") {
+        return std::make_unique<PNGWriter>(options);
+    }
+    return nullptr;
+}
+
+//// PPM
+
+PPMWriter::PPMWriter(const ToneMapSettings &toneMap) :
+    m_toneMap(toneMap)
+{}
+
+bool PPMWriter::open(const QString &path, int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_file = std::make_unique<QFile>(path);
+    m_ok = m_file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (m_ok) {
+        QByteArray header = QString("P6\n%1 %2\n255\n").arg(width).arg(height).toLatin1();
+        m_ok = m_file->write(header) == header.size();
+    }
+    m_toneMapped.resize(width);
+    m_rowBuffer.resize(qsizetype(width) * 3);
+    return m_ok;
+}
+
+bool PPMWriter::writeRows(const SceneColor *rows, int rowCount) {
+    for (int row = 0; m_ok && row < rowCount; row++) {
+        toneMap(rows + std::size_t(row) * m_width, m_toneMapped.data(), m_width, m_toneMap);
+        // drop the alpha channel
+        char *out = m_rowBuffer.data();
+        for (int col = 0; col < m_width; col++) {
+            out[3*col]     = m_toneMapped[col].r;
+            out[3*col + 1] = m_toneMapped[col].g;
+            out[3*col + 2] = m_toneMapped[col].b;
+        }
+        m_ok = m_file->write(m_rowBuffer) == m_rowBuffer.size();
+        m_rowsWritten++;
+    }
+    return m_ok;
+}
+
+bool PPMWriter::close() {
+    if (m_file) {
+        m_ok = m_ok && m_file->flush();
+        m_file->close();
+        m_file.reset();
+    }
+    return m_ok && m_rowsWritten == m_height;
+}
+
+//// PFM
+
+bool PFMWriter::open(const QString &path, int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_file = std::make_unique<QFile>(path);
+    m_ok = m_file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (m_ok) {
+        // a negative scale marks little-endian data
+        const char *scale = (std::endian::native == std::endian::little) ? "-1.0" : "1.0";
+        QByteArray header = QString("PF\n%1 %2\n%3\n").arg(width).arg(height).arg(scale).toLatin1();
+        m_headerSize = header.size();
+        m_ok = m_file->write(header) == header.size();
+    }
+    m_rowBuffer.resize(std::size_t(width) * 3);
+    return m_ok;
+}
+
+bool PFMWriter::writeRows(const SceneColor *rows, int rowCount) {
+    qint64 rowBytes = qint64(m_width) * 3 * sizeof(float);
+    for (int row = 0; m_ok && row < rowCount; row++) {
+        const SceneColor *pixels = rows + std::size_t(row) * m_width;
+        for (int col = 0; col < m_width; col++) {
+            m_rowBuffer[3*col]     = pixels[col].r;
+            m_rowBuffer[3*col + 1] = pixels[col].g;
+            m_rowBuffer[3*col + 2] = pixels[col].b;
+        }
+        // the first row in the file is the bottom row of the image
+        qint64 offset = m_headerSize + qint64(m_height - 1 - m_rowsWritten) * rowBytes;
+        m_ok = m_file->seek(offset) &&
+               m_file->write(reinterpret_cast<const char *>(m_rowBuffer.data()), rowBytes) == rowBytes;
+        m_rowsWritten++;
+    }
+    return m_ok;
+}
+
+bool PFMWriter::close() {
+    if (m_file) {
+        m_ok = m_ok && m_file->flush();
+        m_file->close();
+        m_file.reset();
+    }
+    return m_ok && m_rowsWritten == m_height;
+}
+
+//// PNG
+
+namespace {
+
+void appendBigEndian(QByteArray &bytes, quint32 value) {
+    char encoded[4] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+    bytes.append(encoded, 4);
+}
+
+// A run of rows compressed independently of the others
+struct PNGChunk {
+    const SceneColor *rows;
+    int rowCount;
+    bool last;              // ends the zlib stream
+    QByteArray compressed;  // raw deflate data
+    unsigned long adler;    // Adler-32 of the uncompressed (filtered) rows
+    std::size_t rawSize;
+    bool ok;
+};
+
+/**
+ * @brief compressPNGChunk tone maps and filters the chunk's rows, then deflates them. Every row uses the Sub filter,
+ *          which only depends on the row itself, so chunks can be filtered without their neighbors.
+ */
+void compressPNGChunk(PNGChunk &chunk, int width, const ImageWriterOptions &options) {
+    std::size_t rowBytes = 1 + std::size_t(width) * 3;
+    std::vector<unsigned char> raw(rowBytes * chunk.rowCount);
+    std::vector<RGBA> toneMapped(width);
+    for (int row = 0; row < chunk.rowCount; row++) {
+        toneMap(chunk.rows + std::size_t(row) * width, toneMapped.data(), width, options.toneMap);
+        unsigned char *out = raw.data() + row * rowBytes;
+        out[0] = 1; // Sub filter: each byte minus the same channel of the pixel to its left
+        RGBA left{0, 0, 0};
+        for (int col = 0; col < width; col++) {
+            out[1 + 3*col]     = toneMapped[col].r - left.r;
+            out[1 + 3*col + 1] = toneMapped[col].g - left.g;
+            out[1 + 3*col + 2] = toneMapped[col].b - left.b;
+            left = toneMapped[col];
+        }
+    }
+    chunk.rawSize = raw.size();
+    chunk.adler = adler32(adler32(0L, Z_NULL, 0), raw.data(), raw.size());
+
+    z_stream stream{};
+    // raw deflate (negative window bits): the zlib header and checksum are written once for the whole image
+    chunk.ok = deflateInit2(&stream, options.pngLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!chunk.ok) {
+        return;
+    }
+    chunk.compressed.resize(deflateBound(&stream, raw.size()) + 16); // a sync flush adds a few bytes beyond the bound
+    stream.next_in = raw.data();
+    stream.avail_in = raw.size();
+    stream.next_out = reinterpret_cast<Bytef *>(chunk.compressed.data());
+    stream.avail_out = chunk.compressed.size();
+    // a sync flush ends on a byte boundary without marking the last block, so the next chunk's data can follow directly
+    int status = deflate(&stream, chunk.last ? Z_FINISH : Z_SYNC_FLUSH);
+    chunk.ok = chunk.last ? (status == Z_STREAM_END) : (status == Z_OK && stream.avail_in == 0);
+    chunk.compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+}
+
+}
+
+PNGWriter::PNGWriter(const ImageWriterOptions &options) :
+    m_options(options)
+{
+    m_options.pngLevel = std::clamp(m_options.pngLevel, 0, 9);
+}
+
+void PNGWriter::writeChunk(const char *type, const QByteArray &data) {
+    QByteArray chunk;
+    appendBigEndian(chunk, data.size());
+    chunk.append(type, 4);
+    chunk.append(data);
+    // the CRC covers the chunk type and data
+    unsigned long crc = crc32(0L, reinterpret_cast<const Bytef *>(chunk.constData()) + 4, 4 + data.size());
+    appendBigEndian(chunk, crc);
+    m_ok = m_ok && m_file->write(chunk) == chunk.size();
+}
+
+bool PNGWriter::open(const QString &path, int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_zlibHeaderWritten = false;
+    m_adler = adler32(0L, Z_NULL, 0);
+    m_file = std::make_unique<QFile>(path);
+    m_ok = m_file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (m_ok) {
+        const char signature[8] = {char(0x89), 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        m_ok = m_file->write(signature, 8) == 8;
+    }
+
+    QByteArray header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    const char format[5] = {8, 2, 0, 0, 0}; // 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+    header.append(format, 5);
+    writeChunk("IHDR", header);
+    return m_ok;
+}
+
+bool PNGWriter::writeRows(const SceneColor *rows, int rowCount) {
+    if (!m_ok || rowCount <= 0) {
+        return m_ok;
+    }
+
+    // roughly 256 KB of uncompressed data per chunk keeps every core busy without hurting the compression ratio much
+    int rowsPerChunk = std::max(1, int((256 * 1024) / (std::size_t(m_width) * 3 + 1)));
+    std::vector<PNGChunk> chunks{};
+    for (int row = 0; row < rowCount; row += rowsPerChunk) {
+        int chunkRows = std::min(rowsPerChunk, rowCount - row);
+        bool last = (m_rowsWritten + row + chunkRows == m_height);
+        chunks.push_back(PNGChunk{rows + std::size_t(row) * m_width, chunkRows, last, {}, 0, 0, false});
+    }
+    QtConcurrent::blockingMap(chunks, [this](PNGChunk &chunk) {
+        compressPNGChunk(chunk, m_width, m_options);
+    });
+
+    for (const PNGChunk &chunk : chunks) {
+        m_ok = m_ok && chunk.ok;
+        QByteArray data;
+        if (!m_zlibHeaderWritten) {
+            data.append("\x78\x9c", 2); // deflate with a 32 KB window, default compression
+            m_zlibHeaderWritten = true;
+        }
+        data.append(chunk.compressed);
+        m_adler = adler32_combine(m_adler, chunk.adler, chunk.rawSize);
+        if (chunk.last) {
+            appendBigEndian(data, m_adler);
+        }
+        writeChunk("IDAT", data);
+    }
+    m_rowsWritten += rowCount;
+    return m_ok;
+}
+
+bool PNGWriter::close() {
+    if (m_file) {
+        if (m_rowsWritten == m_height) {
+            writeChunk("IEND", QByteArray());
+        }
+        m_ok = m_ok && m_file->flush();
+        m_file->close();
+        m_file.reset();
+    }
+    return m_ok && m_rowsWritten == m_height;
+}
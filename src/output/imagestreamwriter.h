@@ -0,0 +1,92 @@
+#pragma once
+
+#include <memory>
+#include <QFile>
+#include <QString>
+#include "tonemap.h"
+#include "utils/rgba.h"
+#include "utils/scenedata.h"
+
+// Options shared by the image writers
+struct ImageWriterOptions {
+    ToneMapSettings toneMap; // applied by 8-bit formats; HDR formats store the raw colors
+    int pngLevel = 6;        // zlib compression level for PNG, from 0 (store, fastest) to 9 (smallest)
+};
+
+// Writes an image to disk a few rows at a time, so that the whole image never has to be held in memory
+class ImageStreamWriter {
+public:
+    virtual ~ImageStreamWriter() = default;
+
+    // Creates the file and writes its header. Returns false if the file could not be created.
+    virtual bool open(const QString &path, int width, int height) = 0;
+
+    // Appends the next rowCount rows of the image (top to bottom). rows holds rowCount * width HDR colors.
+    virtual bool writeRows(const SceneColor *rows, int rowCount) = 0;
+
+    // Flushes and closes the file. Returns false if any write failed or fewer rows than the height were written.
+    virtual bool close() = 0;
+};
+
+// Binary PPM (P6): a short text header followed by uncompressed 8-bit RGB rows
+class PPMWriter : public ImageStreamWriter {
+public:
+    explicit PPMWriter(const ToneMapSettings &toneMap);
+    bool open(const QString &path, int width, int height) override;
+    bool writeRows(const SceneColor *rows, int rowCount) override;
+    bool close() override;
+
+private:
+    ToneMapSettings m_toneMap;
+    std::unique_ptr<QFile> m_file;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsWritten = 0;
+    bool m_ok = false;
+    std::vector<RGBA> m_toneMapped;
+    QByteArray m_rowBuffer;
+};
+
+// Portable float map (PF): uncompressed 32-bit float RGB, keeping the full dynamic range of the render.
+// PFM stores rows bottom to top, so each row is written at its final offset in the file.
+class PFMWriter : public ImageStreamWriter {
+public:
+    bool open(const QString &path, int width, int height) override;
+    bool writeRows(const SceneColor *rows, int rowCount) override;
+    bool close() override;
+
+private:
+    std::unique_ptr<QFile> m_file;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsWritten = 0;
+    qint64 m_headerSize = 0;
+    bool m_ok = false;
+    std::vector<float> m_rowBuffer;
+};
+
+// 8-bit RGB PNG whose image data is compressed in parallel. Rows are cut into chunks that are deflated independently
+// on the global thread pool and concatenated with sync flushes into a single zlib stream (the approach of pigz),
+// so compression scales with the number of cores at a small cost in file size.
+class PNGWriter : public ImageStreamWriter {
+public:
+    explicit PNGWriter(const ImageWriterOptions &options);
+    bool open(const QString &path, int width, int height) override;
+    bool writeRows(const SceneColor *rows, int rowCount) override;
+    bool close() override;
+
+private:
+    void writeChunk(const char *type, const QByteArray &data);
+
+    ImageWriterOptions m_options;
+    std::unique_ptr<QFile> m_file;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsWritten = 0;
+    bool m_ok = false;
+    bool m_zlibHeaderWritten = false;
+    unsigned long m_adler = 1; // Adler-32 checksum of all uncompressed bytes so far
+};
+
+// Picks a writer from the file extension of path (.ppm, .pfm or .png). Returns nullptr if no writer supports it.
+std::unique_ptr<ImageStreamWriter> createImageStreamWriter(const QString &path, const ImageWriterOptions &options);
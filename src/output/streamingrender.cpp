@@ -0,0 +1,44 @@
+#include "streamingrender.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "imageoutput.h"
+
+bool renderStreaming(RayTracer &raytracer, const RayTraceScene &scene, const Tile &region,
+                     ImageStreamWriter &writer, const QString &outputPath, int bandHeight, int maxBands) {
+    if (!writer.open(outputPath, region.width, region.height)) {
+        return false;
+    }
+
+    // a single I/O thread writes bands in the order they were queued
+    QThreadPool ioPool;
+    ioPool.setMaxThreadCount(1);
+    std::deque<QFuture<bool>> pendingWrites{};
+    bool success = true;
+
+    for (int y = region.y; y < region.y + region.height; y += bandHeight) {
+        // the band being rendered plus the bands waiting to be written never exceed maxBands
+        while (int(pendingWrites.size()) >= maxBands) {
+            success &= pendingWrites.front().result();
+            pendingWrites.pop_front();
+        }
+
+        Tile band{0, region.x, y, region.width, std::min(bandHeight, region.y + region.height - y)};
+        auto bandData = std::make_shared<Framebuffer>(std::size_t(band.width) * band.height, SceneColor(0, 0, 0, 1));
+        raytracer.renderTile(bandData->data(), band.width, band, scene);
+
+        pendingWrites.push_back(QtConcurrent::run(&ioPool, [&writer, bandData, rowCount = band.height]() {
+            return writer.writeRows(bandData->data(), rowCount);
+        }));
+    }
+
+    while (!pendingWrites.empty()) {
+        success &= pendingWrites.front().result();
+        pendingWrites.pop_front();
+    }
+    return writer.close() && success;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QString>
+#include "imagestreamwriter.h"
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "raytracer/tile.h"
+
+// Renders a region of the canvas in bands of bandHeight rows, top to bottom, and streams each finished band to the
+// writer on an I/O thread while the next band renders. At most maxBands bands are held in memory at once, so memory
+// use is independent of the image height.
+// @param region part of the canvas to render; it becomes the whole output image
+// @return true if every band was rendered and written
+bool renderStreaming(RayTracer &raytracer, const RayTraceScene &scene, const Tile &region,
+                     ImageStreamWriter &writer, const QString &outputPath, int bandHeight, int maxBands);
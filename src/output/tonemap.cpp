@@ -0,0 +1,37 @@
+#include "tonemap.h"
+
+#include <cmath>
+
+ToneMapOperator toneMapOperatorFromName(const std::string &name) {
+    if (name == "reinhard") {
+        return ToneMapOperator::TONEMAP_REINHARD;
+    } else if (name == "aces") {
+        return ToneMapOperator::TONEMAP_ACES;
+    }
+    return ToneMapOperator::TONEMAP_CLAMP;
+}
+
+RGBA toneMap(const SceneColor &color, const ToneMapSettings &settings) {
+    glm::vec3 x = glm::vec3(color) * std::exp2(settings.exposure);
+    switch (settings.op) {
+        case ToneMapOperator::TONEMAP_REINHARD:
+            x = glm::max(x, 0.f);
+            x = x / (1.f + x);
+            break;
+        case ToneMapOperator::TONEMAP_ACES:
+            // Narkowicz's fit of the ACES reference rendering transform
+            x = glm::max(x, 0.f);
+            x = (x * (2.51f*x + 0.03f)) / (x * (2.43f*x + 0.59f) + 0.14f);
+            break;
+        case ToneMapOperator::TONEMAP_CLAMP:
+            break;
+    }
+    // toRGBA clamps to [0,1]
+    return toRGBA(glm::vec4(x, 1));
+}
+
+void toneMap(const SceneColor *in, RGBA *out, std::size_t count, const ToneMapSettings &settings) {
+    for (std::size_t i = 0; i < count; i++) {
+        out[i] = toneMap(in[i], settings);
+    }
+}
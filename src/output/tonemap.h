@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "utils/rgba.h"
+#include "utils/scenedata.h"
+
+// Operators mapping unbounded linear radiance to displayable [0,1] values
+enum class ToneMapOperator {
+    TONEMAP_CLAMP,    // clip each channel to [0,1] (matches the renderer's original 8-bit output)
+    TONEMAP_REINHARD, // x / (1 + x)
+    TONEMAP_ACES      // fitted ACES filmic curve
+};
+
+struct ToneMapSettings {
+    ToneMapOperator op = ToneMapOperator::TONEMAP_CLAMP;
+    float exposure = 0.f; // in stops: colors are scaled by 2^exposure before the operator is applied
+};
+
+// Parses "clamp", "reinhard" or "aces"; unknown names fall back to clamp
+ToneMapOperator toneMapOperatorFromName(const std::string &name);
+
+// Converts one HDR color to 8 bits per channel
+RGBA toneMap(const SceneColor &color, const ToneMapSettings &settings);
+
+// Converts count consecutive HDR colors
+void toneMap(const SceneColor *in, RGBA *out, std::size_t count, const ToneMapSettings &settings);
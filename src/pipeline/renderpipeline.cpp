@@ -0,0 +1,138 @@
+#include "renderpipeline.h"
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "output/imageoutput.h"
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "utils/rendersettings.h"
+#include "utils/sceneparser.h"
+
+namespace {
+
+// A job whose scene has been parsed and built (textures may still be decoding)
+struct LoadedJob {
+    int index;
+    QString configPath;
+    RenderSettings settings;
+    std::shared_ptr<RayTraceScene> scene; // null if loading failed
+    qint64 loadMs;
+};
+
+/**
+ * @brief loadJob reads a job's config, parses its scene file and builds the scene. Runs on the loader thread.
+ */
+std::shared_ptr<LoadedJob> loadJob(int index, const QString &configPath) {
+    QElapsedTimer timer;
+    timer.start();
+
+    auto job = std::make_shared<LoadedJob>();
+    job->index = index;
+    job->configPath = configPath;
+    job->settings = loadRenderSettings(configPath);
+
+    RenderData metaData;
+    if (SceneParser::parse(job->settings.scenePath.toStdString(), metaData)) {
+        job->scene = std::make_shared<RayTraceScene>(job->settings.width, job->settings.height, metaData,
+                                                     job->settings.lightCutoff);
+    } else {
+        std::cerr << "Error loading scene: \"" << job->settings.scenePath.toStdString() << "\"" << std::endl;
+    }
+    job->loadMs = timer.elapsed();
+    return job;
+}
+
+/**
+ * @brief saveImage encodes and writes a rendered image. Runs on the I/O thread.
+ * @return the time spent encoding in milliseconds, or -1 if saving failed
+ */
+qint64 saveImage(const Framebuffer &framebuffer, const Tile &crop, const QString &outputPath,
+                 const ImageWriterOptions &options) {
+    QElapsedTimer timer;
+    timer.start();
+    bool saved = saveFramebuffer(framebuffer.data(), crop.width, crop.height, outputPath, options);
+    if (!saved) {
+        std::cerr << "Error: failed to save image to \"" << outputPath.toStdString() << "\"" << std::endl;
+        return -1;
+    }
+    std::cout << "Saved rendered image to \"" << outputPath.toStdString() << "\"" << std::endl;
+    return timer.elapsed();
+}
+
+}
+
+bool runRenderPipeline(const QStringList &configPaths) {
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    // one loader thread and one I/O thread; rendering itself uses the raytracer's tile scheduler
+    QThreadPool loadPool;
+    loadPool.setMaxThreadCount(1);
+    QThreadPool ioPool;
+    ioPool.setMaxThreadCount(1);
+
+    std::deque<QFuture<qint64>> pendingSaves{};
+    const std::size_t maxPendingSaves = 2; // bounds the number of finished images held in memory
+    qint64 phaseSumMs = 0;
+    bool success = true;
+
+    auto waitForOldestSave = [&]() {
+        qint64 encodeMs = pendingSaves.front().result();
+        pendingSaves.pop_front();
+        success &= (encodeMs >= 0);
+        phaseSumMs += std::max(encodeMs, qint64(0));
+    };
+
+    QFuture<std::shared_ptr<LoadedJob>> nextLoad = QtConcurrent::run(&loadPool, [path = configPaths[0]]() {
+        return loadJob(0, path);
+    });
+
+    for (int i = 0; i < configPaths.size(); i++) {
+        std::shared_ptr<LoadedJob> job = nextLoad.result();
+        // start loading the next job while this one renders
+        if (i + 1 < configPaths.size()) {
+            nextLoad = QtConcurrent::run(&loadPool, [i, path = configPaths[i + 1]]() {
+                return loadJob(i + 1, path);
+            });
+        }
+        phaseSumMs += job->loadMs;
+        if (!job->scene) {
+            success = false;
+            continue;
+        }
+        if (job->settings.sequence || job->settings.distributed || job->settings.streaming) {
+            std::cout << "Note: " << job->configPath.toStdString() << ": [Sequence], [Distributed] and streaming output are ignored when rendering a batch" << std::endl;
+        }
+
+        QElapsedTimer renderTimer;
+        renderTimer.start();
+        const Tile &crop = job->settings.crop;
+        auto framebuffer = std::make_shared<Framebuffer>(std::size_t(crop.width) * crop.height, SceneColor(0, 0, 0, 1));
+        RayTracer raytracer{ job->settings.rtConfig };
+        raytracer.renderTile(framebuffer->data(), crop.width, crop, *job->scene);
+        qint64 renderMs = renderTimer.elapsed();
+        phaseSumMs += renderMs;
+        std::cout << "Job " << i << " (" << job->configPath.toStdString() << "): load " << job->loadMs
+                  << " ms, render " << renderMs << " ms" << std::endl;
+
+        while (pendingSaves.size() >= maxPendingSaves) {
+            waitForOldestSave();
+        }
+        pendingSaves.push_back(QtConcurrent::run(&ioPool, [framebuffer, crop, outputPath = job->settings.outputPath,
+                                                    options = job->settings.imageOptions]() {
+            return saveImage(*framebuffer, crop, outputPath, options);
+        }));
+    }
+
+    while (!pendingSaves.empty()) {
+        waitForOldestSave();
+    }
+    std::cout << "Rendered " << configPaths.size() << " jobs in " << wallTimer.elapsed() << " ms (phases sum to "
+              << phaseSumMs << " ms)" << std::endl;
+    return success;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <QStringList>
+
+// Renders a batch of independent jobs (one per config file) with their phases overlapped. While one job renders on
+// the tile scheduler's worker threads, the next job is parsed and built on a loader thread (its textures decoding in the
+// background alongside the BVH build) and the previous job is encoded and saved on an I/O thread. With enough jobs,
+// the time per job approaches that of its longest phase rather than the sum of all phases.
+// [Sequence], [Distributed] and streaming output are ignored; each job renders a single image locally.
+// @return true if every job was rendered and saved
+bool runRenderPipeline(const QStringList &configPaths);
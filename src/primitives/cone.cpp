@@ -1,14 +1,14 @@
 #include "primitive.h"
 
 /**
- * @brief Cone::getIntersectionT computes the smallest non-negative 'time' parameter t at which the object space ray r(t) = p + td
+ * @brief Cone::getIntersectionT computes the smallest 'time' parameter t within the ray's (tMin, tMax) interval at which the object space ray r(t) = p + td
  *          interects this cone. The cone is aligned vertically with the y-axis
  * @param objSpaceRay Ray defined in object space (i.e. with origin p and direction d in object space)
  * @return float t where the intersection of r(t) and the surface occurs closest to the camera
  */
-float Cone::getIntersectionT(Ray objSpaceRay) const {
-    vec3 rayDir = objSpaceRay.getDir();
-    vec3 rayPos = objSpaceRay.getOrigin();
+float Cone::getIntersectionT(const Ray &objSpaceRay) const {
+    const vec3 &rayDir = objSpaceRay.getDir();
+    const vec3 &rayPos = objSpaceRay.getOrigin();
 
     // get the x/y/z components of the ray's position and dir
     auto [dx, dy, dz] = getXYZComponents(rayDir);
@@ -16,7 +16,7 @@ float Cone::getIntersectionT(Ray objSpaceRay) const {
 
     // temp vars
     float currT;
-    std::vector<float> intersectionTList{};
+    float closestT = infinity;
     float xIntersect;
     float yIntersect;
     float zIntersect;
@@ -34,31 +34,31 @@ float Cone::getIntersectionT(Ray objSpaceRay) const {
         float yIntersect1 = objSpaceRay.getPos(t1)[1]; // y coord of intersection point
         float yIntersect2 = objSpaceRay.getPos(t2)[1]; 
         if ( yIntersect1 >= -m_height/2 && yIntersect1 <= m_height/2) {
-            intersectionTList.push_back(t1);
+            keepClosest(objSpaceRay, t1, closestT);
         } 
         if ( yIntersect2 >= -m_height/2 && yIntersect2 <= m_height/2) {
-            intersectionTList.push_back(t2);
+            keepClosest(objSpaceRay, t2, closestT);
         } 
     }
     
 
     //// 2) flat base
     // get (single) intersection with y=-h/2 plane
-    currT = (-0.5 - py) / dy;
+    currT = (-0.5 - py) * objSpaceRay.getInvDir()[1];
 
     // bounds checking
     // solution valid iff inside disk bounded by baseRadius on xz-plane
-    if (currT < infinity) {
+    if (currT < closestT && currT < objSpaceRay.getTMax()) { // no need to bounds check hits that can't be the closest
         xIntersect = objSpaceRay.getPos(currT)[0];
         zIntersect = objSpaceRay.getPos(currT)[2];
         if (pow(xIntersect, 2) + pow(zIntersect, 2) <= pow(m_baseRadius, 2)) {
-            intersectionTList.push_back(currT);
+            keepClosest(objSpaceRay, currT, closestT);
         }
     }
     
 
     // return smallest t (if no intersection, this is infinity)
-    return getSmallest(intersectionTList);
+    return closestT;
 }
 
 
@@ -1,71 +1,33 @@
 #include "primitive.h"
 
 /**
- * @brief isInSquare a helper to check whether the given 2D point lies within a square with given side length sitting at the origin
- * @param sideLength square side length
- * @return
- */
-bool isInSquare(float x, float y, float sideLength) {
-    return std::fabs(x) <= sideLength/2 && std::fabs(y) <= sideLength/2;
-}
-
-/**
- * @brief Cube::getIntersectionT computes the smallest non-negative 'time' parameter t at which the object space ray r(t) = p + td
- *          interects this cube. The cube is aligned vertically with the y-axis
+ * @brief Cube::getIntersectionT computes the smallest 'time' parameter t within the ray's (tMin, tMax) interval at which the
+ *          object space ray r(t) = p + td interects this cube. The cube is aligned vertically with the y-axis
  * @param objSpaceRay Ray defined in object space (i.e. with origin p and direction d in object space)
  * @return float t where the intersection of r(t) and the surface occurs closest to the camera
  */
-float Cube::getIntersectionT(Ray objSpaceRay) const {
-    vec3 rayDir = objSpaceRay.getDir();
-    vec3 rayPos = objSpaceRay.getOrigin();
-
-    // temp vars
-    float currT;
-    std::vector<float> intersectionTList{};
-    vec3 intersectionPoint;
-
-
-    //// 1) intersections w/ faces parallel to XY plane
-    // find closest intersection with planes z = 0.5*sideLen, z=-0.5*sideLen
-    currT = std::min( 
-        intersectPlane(rayDir, rayPos, Plane::XY, 0.5), // non-negative number or infinity
-        intersectPlane(rayDir, rayPos, Plane::XY, -0.5)
-    );
-    intersectionPoint = objSpaceRay.getPos(currT);
-    // bounds checking (intersection must be in unit square centered at origin in the curr plane)
-    if ( currT < infinity && isInSquare(intersectionPoint[0], objSpaceRay.getPos(currT)[1], 1) ) {
-        intersectionTList.push_back(currT);
-    }
-    
-    //// 2) intersections w/ faces parallel to XZ plane
-    // find closest intersection with planes y = 0.5*sideLen, y=-0.5*sideLen
-    currT = std::min(
-        intersectPlane(rayDir, rayPos, Plane::XZ, 0.5),
-        intersectPlane(rayDir, rayPos, Plane::XZ, -0.5)
-    );
-    intersectionPoint = objSpaceRay.getPos(currT);
-    // bounds checking
-    if ( currT < infinity && isInSquare(intersectionPoint[0], objSpaceRay.getPos(currT)[2], 1) ) {
-        intersectionTList.push_back(currT);
-    }
-
-
-    //// 3) intersections w/ faces parallel to YZ plane
-    // find closest intersection with planes x = 0.5*sideLen, x=-0.5*sideLen
-    currT = std::min(
-        intersectPlane(rayDir, rayPos, Plane::YZ, 0.5),
-        intersectPlane(rayDir, rayPos, Plane::YZ, -0.5)
-    );
-    intersectionPoint = objSpaceRay.getPos(currT);
-    // bounds checking
-    if ( currT < infinity && isInSquare(intersectionPoint[1], objSpaceRay.getPos(currT)[2], 1) ) {
-        intersectionTList.push_back(currT);
+float Cube::getIntersectionT(const Ray &objSpaceRay) const {
+    // the ray is inside the slab between each pair of opposite faces for an interval of t; it is inside the cube where
+    // all three intervals overlap, so it enters at the latest entry and leaves at the earliest exit
+    const vec3 &rayPos = objSpaceRay.getOrigin();
+    const vec3 &invDir = objSpaceRay.getInvDir();
+    vec3 t0 = (vec3(-0.5f) - rayPos) * invDir;
+    vec3 t1 = (vec3(0.5f) - rayPos) * invDir;
+    vec3 tNear = glm::min(t0, t1);
+    vec3 tFar = glm::max(t0, t1);
+    float tEnter = std::max(std::max(tNear[0], tNear[1]), tNear[2]);
+    float tExit = std::min(std::min(tFar[0], tFar[1]), tFar[2]);
+    if (!(tEnter <= tExit)) {
+        return infinity; // misses the cube
     }
 
-    // return smallest t (if no intersection, this is infinity)
-    return getSmallest(intersectionTList);
+    // the entry point, or the exit point for rays starting inside the cube
+    float closestT = infinity;
+    keepClosest(objSpaceRay, tEnter > objSpaceRay.getTMin() ? tEnter : tExit, closestT);
+    return closestT;
 }
 
+
 /**
  * @brief Cube::getObjSpaceNormal Computes the object-space normal of the given object-space point
  * @param objSpacePoint a point on the cube's surfacesurface in object space
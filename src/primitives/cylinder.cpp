@@ -1,14 +1,14 @@
 #include "primitive.h"
 
 /**
- * @brief Cylinder::getIntersectionT computes the smallest non-negative 'time' parameter t at which the object space ray r(t) = p + td
+ * @brief Cylinder::getIntersectionT computes the smallest 'time' parameter t within the ray's (tMin, tMax) interval at which the object space ray r(t) = p + td
  *          interects this cylinder. The cube is aligned vertically with the y-axis
  * @param objSpaceRay Ray defined in object space (i.e. with origin p and direction d in object space)
  * @return float t where the intersection of r(t) and the surface occurs closest to the camera
  */
-float Cylinder::getIntersectionT(Ray objSpaceRay) const {
-    vec3 rayDir = objSpaceRay.getDir();
-    vec3 rayPos = objSpaceRay.getOrigin();
+float Cylinder::getIntersectionT(const Ray &objSpaceRay) const {
+    const vec3 &rayDir = objSpaceRay.getDir();
+    const vec3 &rayPos = objSpaceRay.getOrigin();
 
     // get the x/y/z components of the ray's position and dir
     auto [dx, dy, dz] = getXYZComponents(rayDir);
@@ -16,7 +16,7 @@ float Cylinder::getIntersectionT(Ray objSpaceRay) const {
 
     // temp vars
     float currT;
-    std::vector<float> intersectionTList{};
+    float closestT = infinity;
     float xIntersect;
     float yIntersect;
     float zIntersect;
@@ -24,15 +24,15 @@ float Cylinder::getIntersectionT(Ray objSpaceRay) const {
     //// 1) intersections w/ flat caps parallel to XZ plane
     // find closest intersection with planes y = 0.5*height, z=-0.5*height
     currT = std::min( 
-        intersectPlane(rayDir, rayPos, Plane::XZ, 0.5), // non-negative number or infinity
-        intersectPlane(rayDir, rayPos, Plane::XZ, -0.5)
+        intersectPlane(objSpaceRay, Plane::XZ, 0.5), // non-negative number or infinity
+        intersectPlane(objSpaceRay, Plane::XZ, -0.5)
     );
     
     // bounds checking (intersection must be within disk of the same radius as the cylinder)
     xIntersect = objSpaceRay.getPos(currT)[0];
     zIntersect = objSpaceRay.getPos(currT)[2];
     if (pow(xIntersect, 2) + pow(zIntersect, 2) <= pow(m_radius, 2)) {
-        intersectionTList.push_back(currT);
+        keepClosest(objSpaceRay, currT, closestT);
     }
 
 
@@ -43,16 +43,16 @@ float Cylinder::getIntersectionT(Ray objSpaceRay) const {
     float B = 2*(dx*px + dz*pz); // t coeff
     float C = pow(px, 2) + pow(pz, 2) - pow(m_radius, 2); // constant term
     currT = solveQuadratic(A, B, C); // non-negative
-    if (currT < infinity) {
+    if (currT < closestT && currT < objSpaceRay.getTMax()) { // no need to bounds check hits that can't be the closest
         // bounds checking: y-coord of intersection must be within [-height/2, height/2]
         yIntersect = objSpaceRay.getPos(currT)[1];
         if (yIntersect >= -m_height/2 && yIntersect <= m_height/2) {
-            intersectionTList.push_back(currT);
+            keepClosest(objSpaceRay, currT, closestT);
         }
     }
     
     // return smallest t (if no intersection, this is infinity)
-    return getSmallest(intersectionTList);
+    return closestT;
 }
 
 
@@ -6,8 +6,9 @@ using namespace std;
  * @brief Primitive::Primitive Base primitive class constructor. Unpacks relevant transformation and texture information to be used in member methods.
  * @param shapeData shape-specific RenderShapeData object obtained from the scene parser
  * @param textureDictionary a reference to the already populated mapping from filenames to Textures.
+ * @param materials the scene's material table, which this primitive's material is added to
  */
-Primitive::Primitive(RenderShapeData shapeData, std::map<std::string, Texture>& textureDictionary) {
+Primitive::Primitive(RenderShapeData shapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials) {
     // construct relevant transformation matrices once
     m_CTM = shapeData.ctm;
     m_inverseCTM = inverse(m_CTM);
@@ -22,6 +23,14 @@ Primitive::Primitive(RenderShapeData shapeData, std::map<std::string, Texture>&
     // assign reference to loaded texture to this primitive
     m_texture = textureDictionary[m_primitiveInfo.material.textureMap.filename];
     m_textureInfo = m_primitiveInfo.material.textureMap;
+    m_materialIndex = materials.intern(m_primitiveInfo.material);
+
+    // subclasses only add a few floats; the texture itself is shared and accounted once
+    m_memory = MemoryStats::Allocation(MemoryCategory::MEM_PRIMITIVES,
+                                       sizeof(*this) + MemoryStats::heapBytes(m_primitiveInfo.meshfile) +
+                                       MemoryStats::heapBytes(m_primitiveInfo.material.textureMap.filename) +
+                                       MemoryStats::heapBytes(m_primitiveInfo.material.bumpMap.filename) +
+                                       MemoryStats::heapBytes(m_textureInfo.filename));
 }
 
 /**
@@ -53,6 +62,18 @@ vec3 Primitive::getWorldSpaceNormal(vec3 objSpacePoint) {
     return normalize(m_objToWorldNormalTransformation * objSpaceNormal);
 }
 
+/**
+ * @brief Primitive::getWorldSpaceBounds computes a world space box containing this primitive. All primitives fit in the
+ *          unit cube centered at the origin in object space, so the box is built from the cube's transformed corners.
+ */
+AABB Primitive::getWorldSpaceBounds() const {
+    AABB bounds;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 objSpaceCorner((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f);
+        bounds.expand(applyCTM(objSpaceCorner, false));
+    }
+    return bounds;
+}
 
 
 /**
@@ -104,45 +125,50 @@ std::tuple<float, float> Primitive::solveQuadraticBothSolutions(float A, float B
 
 
 /**
- * @brief Primitive::intersectPlane gives the smallest non-negative t value of the intersection between the specified axis-aligned plane and a world space ray.
- * @param rayDir
- * @param rayPos
+ * @brief Primitive::intersectPlane gives the smallest non-negative t value of the intersection between the specified axis-aligned plane and a ray.
+ * @param ray
  * @param plane one of XY, XZ, or YZ from the Plane enum
  * @param planeOffset e.g. for the YZ plane given by x=0.5, the offset is 0.5.
  * @return smallest NON-NEGATIVE t, if any, else infinity
  */
-float Primitive::intersectPlane(vec3 rayDir, vec3 rayPos, Plane plane, float planeOffset) const {
-    auto [dx, dy, dz] = getXYZComponents(rayDir);
-    auto [px, py, pz] = getXYZComponents(rayPos);
+float Primitive::intersectPlane(const Ray &ray, Plane plane, float planeOffset) const {
+    auto [px, py, pz] = getXYZComponents(ray.getOrigin());
+    auto [invDx, invDy, invDz] = getXYZComponents(ray.getInvDir());
     float intersectionT;
     switch(plane) {
         case Plane::XY:
             // z = p_z + td_z = planeOffset
-            intersectionT = (planeOffset - pz) / dz;
+            intersectionT = (planeOffset - pz) * invDz;
             break;
         case Plane::XZ:
             // y = p_y + td_y = planeOffset
-            intersectionT = (planeOffset - py) / dy;
+            intersectionT = (planeOffset - py) * invDy;
             break;
         case Plane::YZ:
             // x = p_x + td_x = planeOffset
-            intersectionT = (planeOffset - px) / dx;
+            intersectionT = (planeOffset - px) * invDx;
             break;
     }
     return intersectionT > 0 ? intersectionT : infinity;
 }
 
 /**
- * @brief Primitive::getSmallest helper to return the smallest element in the given list, or infinity if the list is empty
+ * @brief Primitive::keepClosest replaces closestT by t if t is a closer hit within the ray's (tMin, tMax) interval
  */
-float Primitive::getSmallest(std::vector<float>& list) const {
-    return list.empty() ? infinity  :  *std::min_element(list.begin(), list.end());
+void Primitive::keepClosest(const Ray &ray, float t, float &closestT) const {
+    if (t > ray.getTMin() && t < ray.getTMax() && t < closestT) {
+        closestT = t;
+    }
 }
 
-SceneMaterial Primitive::getMaterial() const {
+const SceneMaterial &Primitive::getMaterial() const {
     return m_primitiveInfo.material;
 }
 
+std::uint32_t Primitive::getMaterialIndex() const {
+    return m_materialIndex;
+}
+
 // texture mapping
 /**
  * @brief Primitive::getTexture retrieves the texture image color corresponding to the given point on the surface of the primitive.
@@ -157,7 +183,7 @@ SceneColor Primitive::getTexture(vec3 surfacePointObjSpace) {
     // clip UV to [0,1] to avoid float precision issues (e.g. when at cube edges)
     vec2 UV = glm::clamp( XYZtoUV(surfacePointObjSpace), 0.f, 1.f);
 
-    return RGBAtoSceneColor(m_texture.getTextureColorAtUV(UV, m_textureInfo.repeatU, m_textureInfo.repeatV));
+    return RGBAtoSceneColor(m_texture->getTextureColorAtUV(UV, m_textureInfo.repeatU, m_textureInfo.repeatV));
 }
 
 /**
@@ -5,6 +5,9 @@
 #include "src/utils/sceneparser.h"
 #include "src/texture/texture.h"
 #include <numbers>
+#include "src/accel/aabb.h"
+#include "src/stats/memstats.h"
+#include "src/material/materialtable.h"
 
 using namespace glm;
 enum class Plane {
@@ -16,15 +19,17 @@ enum class Plane {
 
 class Primitive {
 public:
-    Primitive(RenderShapeData shapeData, std::map<std::string, Texture>& textureDictionary);
+    Primitive(RenderShapeData shapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials);
     Primitive() = default;
 
-    virtual float getIntersectionT(Ray objSpaceRay) const = 0; // get t in r(t)= p + td
+    virtual float getIntersectionT(const Ray &objSpaceRay) const = 0; // get t in r(t)= p + td, within the ray's (tMin, tMax)
     virtual vec3 getObjSpaceNormal(vec3 objSpacePoint) = 0; // non-normalized normal
     vec3 applyCTM(vec3 objSpacePoint, bool isVector) const;
     vec3 applyInverseCTM(vec3 worldSpacePoint, bool isVector) const;
     vec3 getWorldSpaceNormal(vec3 objSpacePoint); // normalized normal
-    SceneMaterial getMaterial() const;
+    AABB getWorldSpaceBounds() const;
+    const SceneMaterial &getMaterial() const;
+    std::uint32_t getMaterialIndex() const; // index of the shading-ready material in the scene's MaterialTable
     
     SceneColor getTexture(vec3 surfacePointWorldSpace);
 
@@ -33,9 +38,9 @@ protected:
     std::tuple<float, float, float> getXYZComponents(vec3 vector) const;
     float solveQuadratic(float A, float B, float C) const;
     std::tuple<float, float> solveQuadraticBothSolutions(float A, float B, float C) const;
-    float intersectPlane(vec3 rayDir, vec3 rayPos, Plane plane, float planeOffset) const;
+    float intersectPlane(const Ray &ray, Plane plane, float planeOffset) const;
     float infinity = std::numeric_limits<float>::infinity();
-    float getSmallest(std::vector<float>& list) const;
+    void keepClosest(const Ray &ray, float t, float &closestT) const;
 
     // texture mapping
     virtual vec2 XYZtoUV(vec3 XYZ) = 0; // takes in OBJECT space XYZ coords
@@ -47,20 +52,22 @@ private:
     mat3 m_objToWorldNormalTransformation;
     ScenePrimitive m_primitiveInfo;
     // SceneFileMap m_textureMap; // already stores loaded texture img
-    Texture m_texture;
+    std::shared_ptr<Texture> m_texture; // shared with every other primitive using the same image
     SceneFileMap m_textureInfo; // needed for primitive-dependent repeatU, repeatV values
+    std::uint32_t m_materialIndex = 0;
+    MemoryStats::Allocation m_memory; // this object plus the strings it copied from the scene
 };
 
 
 class Sphere : public Primitive {
 public:
     Sphere() = default;
-    Sphere(RenderShapeData commonShapeData, std::map<std::string, Texture>& textureDictionary, float radius):
+    Sphere(RenderShapeData commonShapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials, float radius):
         m_radius(radius),
-        Primitive(commonShapeData, textureDictionary) // call base constructor with data
+        Primitive(commonShapeData, textureDictionary, materials) // call base constructor with data
     {};
 
-    float getIntersectionT(Ray objSpaceRay) const;
+    float getIntersectionT(const Ray &objSpaceRay) const;
     vec3 getObjSpaceNormal(vec3 objSpacePoint);
     vec2 XYZtoUV(vec3 XYZ);
 private:
@@ -71,13 +78,13 @@ private:
 class Cone : public Primitive {
 public:
     Cone() = default;
-    Cone(RenderShapeData commonShapeData, std::map<std::string, Texture>& textureDictionary, float baseRadius, float height):
+    Cone(RenderShapeData commonShapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials, float baseRadius, float height):
         m_baseRadius(baseRadius),
         m_height(height),
-        Primitive(commonShapeData, textureDictionary) // call base constructor with data
+        Primitive(commonShapeData, textureDictionary, materials) // call base constructor with data
     {};
 
-    float getIntersectionT(Ray objSpaceRay) const;
+    float getIntersectionT(const Ray &objSpaceRay) const;
     vec3 getObjSpaceNormal(vec3 objSpacePoint);
     vec2 XYZtoUV(vec3 XYZ);
 private:
@@ -89,12 +96,12 @@ private:
 class Cube : public Primitive {
 public:
     Cube() = default;
-    Cube(RenderShapeData commonShapeData, std::map<std::string, Texture>& textureDictionary, float sideLength):
+    Cube(RenderShapeData commonShapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials, float sideLength):
         m_sideLength(sideLength),
-        Primitive(commonShapeData, textureDictionary) // call base constructor with data
+        Primitive(commonShapeData, textureDictionary, materials) // call base constructor with data
     {};
 
-    float getIntersectionT(Ray objSpaceRay) const;
+    float getIntersectionT(const Ray &objSpaceRay) const;
     vec3 getObjSpaceNormal(vec3 objSpacePoint);
     vec2 XYZtoUV(vec3 XYZ);
 private:
@@ -105,13 +112,13 @@ private:
 class Cylinder : public Primitive {
 public:
     Cylinder() = default;
-    Cylinder(RenderShapeData commonShapeData, std::map<std::string, Texture>& textureDictionary, float height, float radius):
+    Cylinder(RenderShapeData commonShapeData, std::map<std::string, std::shared_ptr<Texture>>& textureDictionary, MaterialTable& materials, float height, float radius):
         m_height(height),
         m_radius(radius),
-        Primitive(commonShapeData, textureDictionary) // call base constructor with data
+        Primitive(commonShapeData, textureDictionary, materials) // call base constructor with data
     {};
 
-    float getIntersectionT(Ray objSpaceRay) const;
+    float getIntersectionT(const Ray &objSpaceRay) const;
     vec3 getObjSpaceNormal(vec3 objSpacePoint);
     vec2 XYZtoUV(vec3 XYZ);
     
@@ -2,13 +2,14 @@
 
 
 /**
- * @brief Sphere::getIntersectionT returns the smallest non-negative t value at the intersection point. If no intersection exists, returns infinity.
+ * @brief Sphere::getIntersectionT returns the smallest non-negative t value at the intersection point, if it lies within the ray's (tMin, tMax)
+ *          interval. Otherwise returns infinity.
  * @param objSpaceRay
  * @return
  */
-float Sphere::getIntersectionT(Ray objSpaceRay) const {
-    vec3 rayDir = objSpaceRay.getDir();
-    vec3 rayPos = objSpaceRay.getOrigin();
+float Sphere::getIntersectionT(const Ray &objSpaceRay) const {
+    const vec3 &rayDir = objSpaceRay.getDir();
+    const vec3 &rayPos = objSpaceRay.getOrigin();
 
     // get the x/y/z components of the ray's position and dir
     auto [dx, dy, dz] = getXYZComponents(rayDir);
@@ -20,7 +21,9 @@ float Sphere::getIntersectionT(Ray objSpaceRay) const {
     float C = pow(px, 2) + pow(py, 2) + pow(pz, 2) - pow(m_radius, 2); // constant term
 
     // solve for t using quadratic formula
-    return solveQuadratic(A, B, C);
+    float closestT = infinity;
+    keepClosest(objSpaceRay, solveQuadratic(A, B, C), closestT);
+    return closestT;
 }
 
 vec3 Sphere::getObjSpaceNormal(vec3 objSpacePoint) {
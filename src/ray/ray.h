@@ -1,26 +1,41 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <glm/glm.hpp>
 
+// A ray r(t) = origin + t * dir, restricted to t in (tMin, tMax). Closest-hit queries shrink tMax to the nearest hit found
+// so far, so later tests reject anything farther, and a ray that hits nothing keeps the tMax it was built with. The
+// reciprocal of the direction and its sign bits are computed once, for slab tests.
 class Ray {
 public:
-    Ray(glm::vec3 dir, glm::vec3 pos);
-    
-    void setIntersectionT(float t);
+    Ray(const glm::vec3 &dir, const glm::vec3 &origin, float tMin = 0, float tMax = std::numeric_limits<float>::infinity());
+
+    const glm::vec3 &getDir() const { return m_dir; }
+    const glm::vec3 &getOrigin() const { return m_origin; }
+    const glm::vec3 &getInvDir() const { return m_invDir; } // componentwise 1 / dir
+    int getSign(int axis) const { return (m_signs >> axis) & 1; } // 1 if dir points toward -axis
+    float getTMin() const { return m_tMin; }
+    float getTMax() const { return m_tMax; }
+    void setTMax(float t) { m_tMax = t; }
+    glm::vec3 getPos(float t) const { return m_origin + t*m_dir; } // get position along the ray at time t
 
-    float getIntersectionT();
-    glm::vec3 getPos(float t); // get position along the ray at time t
-    glm::vec3 getIntersectionPoint();
-    glm::vec3 getDir();
-    glm::vec3 getOrigin();
 private:
+    glm::vec3 m_origin;
     glm::vec3 m_dir;
-    glm::vec3 m_pos;
-    float m_tIntersect = std::numeric_limits<float>::infinity(); // infinity if no intersection (default)
-    float d1;
-    float d2;
-    float d3;
-    float p1;
-    float p2;
-    float p3;
+    glm::vec3 m_invDir;
+    float m_tMin;
+    float m_tMax;
+    std::uint32_t m_signs;
+};
+
+// The closest hit of a ray, as recorded by the intersection pass: the primitive, the distance along the ray and the hit
+// point in the primitive's object space, which its normal and texture coordinates are derived from. Shading computes
+// those only when it needs them.
+struct HitRecord {
+    int primitive = -1; // index into the scene's primitives; -1 if the ray hit nothing
+    float t = std::numeric_limits<float>::infinity();
+    glm::vec3 objSpacePoint{0};
+
+    bool found() const { return primitive >= 0; }
 };
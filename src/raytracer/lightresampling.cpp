@@ -0,0 +1,95 @@
+#include "lightresampling.h"
+
+#include <cmath>
+
+namespace LightResampling {
+
+bool Reservoir::add(std::uint32_t candidate, float candidateWeight, float candidateTargetPdf, Rng &rng) {
+    count += 1;
+    if (!(candidateWeight > 0)) {
+        return false;
+    }
+    weightSum += candidateWeight;
+    if (rng.nextFloat() * weightSum < candidateWeight) {
+        slot = candidate;
+        targetPdf = candidateTargetPdf;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Reservoir::merge streams in other as a single candidate standing for all of its candidates: its light is
+ *          weighted by its target pdf at point times other's weight and candidate count. Reservoirs from other points
+ *          are combined with the plain 1/count normalization of the original algorithm, which is slightly biased
+ *          where their lights can't reach point; similar() keeps that to reservoirs from comparable surfaces.
+ */
+void Reservoir::merge(const Reservoir &other, const SurfacePoint &point, const LightTable &lights, Rng &rng) {
+    float otherTargetPdf = other.slot != noLight ? LightResampling::targetPdf(lights, other.slot, point) : 0.f;
+    add(other.slot, otherTargetPdf * other.weight * other.count, otherTargetPdf, rng);
+    count += other.count - 1;
+}
+
+void Reservoir::finalize() {
+    weight = targetPdf > 0 && count > 0 ? weightSum / (count * targetPdf) : 0.f;
+}
+
+float targetPdf(const LightTable &lights, std::uint32_t slot, const SurfacePoint &point) {
+    PhongKernel::LightSamples samples;
+    int lane = int(slot % lightBlockLanes);
+    PhongKernel::shadeLight(lights.blocks()[slot / lightBlockLanes], lane, point.position, point.normal,
+                            point.directionToCamera, point.surface, samples);
+    return 0.2126f * samples.r[lane] + 0.7152f * samples.g[lane] + 0.0722f * samples.b[lane];
+}
+
+bool similar(const SurfacePoint &point, const glm::vec3 &position, const glm::vec3 &normal) {
+    return glm::dot(point.normal, normal) > 0.9f &&
+           std::abs(glm::dot(position - point.position, point.normal)) < 0.05f * point.depth;
+}
+
+}
+
+void ReservoirHistory::beginFrame(int width, int height, const Camera &camera) {
+    if (m_frame > 0 && width == m_width && height == m_height) {
+        std::swap(m_previous, m_current);
+    } else {
+        m_previous.clear();
+    }
+    m_current.assign(std::size_t(width) * height, Entry{});
+    m_width = width;
+    m_height = height;
+    m_previousCamera = m_camera;
+    m_previousView = glm::inverse(m_previousCamera.getCameraMatrix());
+    m_camera = camera;
+    m_frame++;
+}
+
+/**
+ * @brief ReservoirHistory::previous projects position through the previous frame's camera, inverting
+ *          RayTracer::getViewPlaneCoords, and returns the entry stored for the pixel it lands in.
+ */
+const ReservoirHistory::Entry *ReservoirHistory::previous(const glm::vec3 &position) const {
+    if (m_previous.empty()) {
+        return nullptr;
+    }
+    glm::vec4 cameraSpace = m_previousView * glm::vec4(position, 1);
+    if (!(cameraSpace.z < 0)) {
+        return nullptr; // behind the previous camera
+    }
+    float xNormalized = cameraSpace.x / -cameraSpace.z / (2 * std::tan(m_previousCamera.getWidthAngle() / 2));
+    float yNormalized = cameraSpace.y / -cameraSpace.z / (2 * std::tan(m_previousCamera.getHeightAngle() / 2));
+    float col = std::floor((xNormalized + 0.5f) * m_width);
+    float row = std::floor((0.5f - yNormalized) * m_height);
+    if (!(col >= 0 && col < m_width && row >= 0 && row < m_height)) {
+        return nullptr;
+    }
+    const Entry &entry = m_previous[std::size_t(row) * m_width + std::size_t(col)];
+    return entry.reservoir.count > 0 ? &entry : nullptr;
+}
+
+void ReservoirHistory::store(int row, int col, const Entry &entry) {
+    if (m_current.empty()) {
+        return; // no frame begun
+    }
+    m_current[std::size_t(row) * m_width + col] = entry;
+}
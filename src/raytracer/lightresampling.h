@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "camera/camera.h"
+#include "lights/lighttable.h"
+#include "phongkernel.h"
+#include "utils/rng.h"
+
+// Resampled direct lighting (ReSTIR): every pixel streams a few candidate lights from the light tree through a
+// weighted reservoir, which keeps one of them with probability proportional to its unshadowed contribution. The
+// reservoirs of nearby pixels, and of the same surface in the previous frame, are then merged into the pixel's own,
+// so that each pixel chooses among many more lights than it sampled, and only the chosen light gets a shadow ray.
+namespace LightResampling {
+
+constexpr std::uint32_t noLight = std::numeric_limits<std::uint32_t>::max();
+
+// The surface seen through a pixel, with everything needed to evaluate a light there
+struct SurfacePoint {
+    glm::vec3 position;
+    glm::vec3 normal;             // normalized
+    glm::vec3 directionToCamera;  // normalized
+    float depth;                  // distance from the camera
+    PhongKernel::SurfaceTerms surface;
+};
+
+// A reservoir holding one light (a slot of the light table) out of the weighted candidates streamed into it
+struct Reservoir {
+    std::uint32_t slot = noLight;
+    float targetPdf = 0;  // of slot at the reservoir's point
+    float weightSum = 0;
+    float count = 0;      // number of candidates behind the reservoir
+    float weight = 0;     // shading weight of slot, set by finalize()
+
+    // Streams one candidate in; it replaces the held light with probability weight / weightSum. Returns true if it did.
+    bool add(std::uint32_t candidate, float candidateWeight, float candidateTargetPdf, Rng &rng);
+    // Streams in a reservoir built at another point (or this one), re-evaluating its light at point
+    void merge(const Reservoir &other, const SurfacePoint &point, const LightTable &lights, Rng &rng);
+    // Computes weight, so that weight * contribution of slot estimates the sum over all candidate lights
+    void finalize();
+};
+
+// The luminance of the light's unshadowed contribution at point: the distribution the reservoirs resample toward
+float targetPdf(const LightTable &lights, std::uint32_t slot, const SurfacePoint &point);
+
+// Whether a reservoir resampled at a surface (position, normal) may be reused at point: the normals agree and the
+// surface lies close to point's tangent plane
+bool similar(const SurfacePoint &point, const glm::vec3 &position, const glm::vec3 &normal);
+
+}
+
+// The reservoirs of the last frame of a sequence, for reuse by the next one. A pixel of the new frame looks up the
+// reservoir of the pixel where its surface point was seen in the previous frame, so reuse follows camera motion.
+class ReservoirHistory {
+public:
+    struct Entry {
+        LightResampling::Reservoir reservoir;
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    // Starts a frame seen through camera: the reservoirs stored so far become the previous frame's
+    void beginFrame(int width, int height, const Camera &camera);
+    // Number of frames begun before the current one
+    std::uint32_t frame() const { return m_frame; }
+
+    // The previous frame's entry for the pixel that saw position, or nullptr if no pixel did
+    const Entry *previous(const glm::vec3 &position) const;
+    // Records the final reservoir of a pixel of the current frame. Pixels are disjoint, so tiles may store concurrently.
+    void store(int row, int col, const Entry &entry);
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+    std::uint32_t m_frame = 0;
+    Camera m_camera{};
+    Camera m_previousCamera{};
+    glm::mat4 m_previousView{1};  // world to the previous camera's space
+    std::vector<Entry> m_current{};
+    std::vector<Entry> m_previous{};  // empty if there is no previous frame of the same size
+};
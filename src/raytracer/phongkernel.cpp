@@ -0,0 +1,351 @@
+#include "phongkernel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#if defined(__GNUC__) || defined(__clang__)
+// compiled for AVX2 function by function, so the rest of the program still runs on any x86 CPU
+#define PHONG_KERNEL_AVX2 1
+#define PHONG_KERNEL_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+// MSVC has no per-function targets; the kernel is available when the whole build targets AVX2 (/arch:AVX2)
+#define PHONG_KERNEL_AVX2 1
+#define PHONG_KERNEL_AVX2_TARGET
+#endif
+#endif
+
+#if PHONG_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// coefficients shared by the scalar and vector approximations
+constexpr float sqrt2 = 1.41421356f;
+// log2(m) = 2/ln(2) * atanh(t) with t = (m-1)/(m+1), as an odd series in t; |t| < 0.172 for m in [sqrt(1/2), sqrt(2)]
+constexpr float log2C1 = 2.88539008f, log2C3 = 0.961796694f, log2C5 = 0.577078016f, log2C7 = 0.412198583f;
+// 2^f = e^(f ln 2) as a Taylor series, for f in [-0.5, 0.5]
+constexpr float exp2C1 = 0.693147181f, exp2C2 = 0.240226507f, exp2C3 = 0.0555041087f, exp2C4 = 0.00961812911f,
+                exp2C5 = 0.00133335581f, exp2C6 = 0.000154035304f;
+
+float fastLog2(float x) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(x);
+    float exponent = float(int((bits >> 23) & 0xff) - 127);
+    float mantissa = std::bit_cast<float>((bits & 0x007fffff) | 0x3f800000); // in [1, 2)
+    if (mantissa > sqrt2) {
+        mantissa *= 0.5f;
+        exponent += 1;
+    }
+    float t = (mantissa - 1) / (mantissa + 1);
+    float t2 = t * t;
+    return exponent + t * (log2C1 + t2 * (log2C3 + t2 * (log2C5 + t2 * log2C7)));
+}
+
+float fastExp2(float y) {
+    y = std::clamp(y, -126.f, 126.f);
+    float whole = std::nearbyint(y);
+    float f = y - whole;
+    float p = 1 + f * (exp2C1 + f * (exp2C2 + f * (exp2C3 + f * (exp2C4 + f * (exp2C5 + f * exp2C6)))));
+    return p * std::bit_cast<float>(std::uint32_t(int(whole) + 127) << 23);
+}
+
+#if PHONG_KERNEL_AVX2
+
+PHONG_KERNEL_AVX2_TARGET inline __m256 fastLog2(__m256 x) {
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)),
+                                                          _mm256_set1_epi32(127)));
+    __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                          _mm256_set1_epi32(0x3f800000)));
+    __m256 large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(sqrt2), _CMP_GT_OQ);
+    mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), large);
+    exponent = _mm256_add_ps(exponent, _mm256_and_ps(large, _mm256_set1_ps(1.f)));
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(log2C5), _mm256_mul_ps(t2, _mm256_set1_ps(log2C7)));
+    p = _mm256_add_ps(_mm256_set1_ps(log2C3), _mm256_mul_ps(t2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(log2C1), _mm256_mul_ps(t2, p));
+    return _mm256_add_ps(exponent, _mm256_mul_ps(t, p));
+}
+
+PHONG_KERNEL_AVX2_TARGET inline __m256 fastExp2(__m256 y) {
+    y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-126.f)), _mm256_set1_ps(126.f));
+    __m256 whole = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 f = _mm256_sub_ps(y, whole);
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(exp2C5), _mm256_mul_ps(f, _mm256_set1_ps(exp2C6)));
+    p = _mm256_add_ps(_mm256_set1_ps(exp2C4), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(exp2C3), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(exp2C2), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(exp2C1), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(f, p));
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+// x^y for x in [0, 1]; 0^y is 0, except 0^0 = 1 as in std::pow
+PHONG_KERNEL_AVX2_TARGET inline __m256 fastPowLanes(__m256 x, __m256 y) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 result = fastExp2(_mm256_mul_ps(y, fastLog2(_mm256_max_ps(x, _mm256_set1_ps(std::numeric_limits<float>::min())))));
+    __m256 atZero = _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_EQ_OQ), _mm256_set1_ps(1.f));
+    return _mm256_blendv_ps(result, atZero, _mm256_cmp_ps(x, zero, _CMP_LE_OQ));
+}
+
+PHONG_KERNEL_AVX2_TARGET inline __m256 dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+// attenuation * (light * diffuse) * NdotL + attenuation * (light * specular) * highlight for one color channel, zero
+// where the light doesn't face the surface or doesn't reach it
+PHONG_KERNEL_AVX2_TARGET inline __m256 lightChannel(__m256 light, float diffuse, float specular, __m256 attenuation,
+                                                    __m256 NdotL, __m256 highlight, __m256 facing) {
+    __m256 color = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_mul_ps(attenuation, _mm256_mul_ps(light, _mm256_set1_ps(diffuse))), NdotL),
+        _mm256_mul_ps(_mm256_mul_ps(attenuation, _mm256_mul_ps(light, _mm256_set1_ps(specular))), highlight));
+    return _mm256_and_ps(color, facing);
+}
+
+#endif
+
+}
+
+
+namespace {
+
+// The scalar kernel for one lane of one kind of block. For single-type blocks the type tests are resolved at compile
+// time.
+template <LightBlockKind kind>
+void shadeLaneScalar(const LightBlock &block, int i, const glm::vec3 &position, const glm::vec3 &normal,
+                     const glm::vec3 &directionToCamera, const PhongKernel::SurfaceTerms &surface,
+                     PhongKernel::LightSamples &samples) {
+    LightType type = kind == LightBlockKind::BLOCK_POINT ? LightType::LIGHT_POINT
+                   : kind == LightBlockKind::BLOCK_DIRECTIONAL ? LightType::LIGHT_DIRECTIONAL
+                   : kind == LightBlockKind::BLOCK_SPOT ? LightType::LIGHT_SPOT
+                   : LightType(block.type[i]);
+    bool directional = type == LightType::LIGHT_DIRECTIONAL;
+    bool fixedDirection = directional || type == LightType::LIGHT_AREA;
+
+    glm::vec3 toLight(block.posX[i] - position.x, block.posY[i] - position.y, block.posZ[i] - position.z);
+    float distance = directional ? std::numeric_limits<float>::infinity() : std::sqrt(glm::dot(toLight, toLight));
+    glm::vec3 dirToLight = fixedDirection ? glm::vec3(block.dirX[i], block.dirY[i], block.dirZ[i]) : toLight / distance;
+    float attenuation = directional ? 1.f : std::min(1.f, 1 / (block.c1[i] + distance * block.c2[i] + distance * distance * block.c3[i]));
+
+    // spot lights: compare the cosine of the angle off the cone's axis with the cosines of the cones
+    float falloff = 1;
+    if (type == LightType::LIGHT_SPOT) {
+        float cosTheta = -glm::dot(dirToLight, glm::vec3(block.dirX[i], block.dirY[i], block.dirZ[i]));
+        float s = (block.cosInner[i] - cosTheta) * block.falloffScale[i];
+        falloff = cosTheta < block.cosOuter[i] ? 0.f : cosTheta <= block.cosInner[i] ? 1 - s * s * (3 - 2 * s) : 1.f;
+    }
+    glm::vec3 lightColor = falloff * glm::vec3(block.colorR[i], block.colorG[i], block.colorB[i]);
+
+    float NdotL = glm::dot(normal, dirToLight);
+    glm::vec3 reflectedLightDirection = 2 * NdotL * normal - dirToLight;
+    float RdotV = std::max(0.f, glm::dot(reflectedLightDirection, directionToCamera));
+    glm::vec3 color = attenuation * (lightColor * surface.diffuse) * NdotL +
+                      attenuation * (lightColor * surface.specular) * PhongKernel::fastPow(RdotV, surface.shininess);
+    if (!(NdotL > 0) || distance > block.radius[i]) {
+        color = glm::vec3(0);
+    }
+
+    samples.r[i] = color.r;
+    samples.g[i] = color.g;
+    samples.b[i] = color.b;
+    samples.dirX[i] = dirToLight.x;
+    samples.dirY[i] = dirToLight.y;
+    samples.dirZ[i] = dirToLight.z;
+    samples.distance[i] = distance;
+}
+
+template <LightBlockKind kind>
+void shadeBlockScalar(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                      const glm::vec3 &directionToCamera, const PhongKernel::SurfaceTerms &surface,
+                      PhongKernel::LightSamples &samples) {
+    for (int i = 0; i < lightBlockLanes; i++) {
+        shadeLaneScalar<kind>(block, i, position, normal, directionToCamera, surface, samples);
+    }
+}
+
+#if PHONG_KERNEL_AVX2
+
+// The AVX2 kernel for one kind of block: one light per lane. Mixed blocks select between the terms of each type with
+// per-lane masks; single-type blocks compute only the terms of their type.
+template <LightBlockKind kind>
+PHONG_KERNEL_AVX2_TARGET
+void shadeBlockAvx2(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                    const glm::vec3 &directionToCamera, const PhongKernel::SurfaceTerms &surface,
+                    PhongKernel::LightSamples &samples) {
+    constexpr bool mayBePositional = kind != LightBlockKind::BLOCK_DIRECTIONAL;
+    constexpr bool mayBeSpot = kind == LightBlockKind::BLOCK_SPOT || kind == LightBlockKind::BLOCK_MIXED;
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 nx = _mm256_set1_ps(normal.x), ny = _mm256_set1_ps(normal.y), nz = _mm256_set1_ps(normal.z);
+    __m256 vx = _mm256_set1_ps(directionToCamera.x), vy = _mm256_set1_ps(directionToCamera.y),
+           vz = _mm256_set1_ps(directionToCamera.z);
+    __m256 dx = _mm256_load_ps(block.dirX), dy = _mm256_load_ps(block.dirY), dz = _mm256_load_ps(block.dirZ);
+
+    // directional blocks keep the fixed direction, infinite distance and no attenuation
+    __m256 lx = dx, ly = dy, lz = dz;
+    __m256 distance = infinity;
+    __m256 attenuation = one;
+    if constexpr (mayBePositional) {
+        __m256 tx = _mm256_sub_ps(_mm256_load_ps(block.posX), _mm256_set1_ps(position.x));
+        __m256 ty = _mm256_sub_ps(_mm256_load_ps(block.posY), _mm256_set1_ps(position.y));
+        __m256 tz = _mm256_sub_ps(_mm256_load_ps(block.posZ), _mm256_set1_ps(position.z));
+        distance = _mm256_sqrt_ps(dot(tx, ty, tz, tx, ty, tz));
+        lx = _mm256_div_ps(tx, distance);
+        ly = _mm256_div_ps(ty, distance);
+        lz = _mm256_div_ps(tz, distance);
+        attenuation = _mm256_add_ps(_mm256_load_ps(block.c1),
+                                    _mm256_add_ps(_mm256_mul_ps(distance, _mm256_load_ps(block.c2)),
+                                                  _mm256_mul_ps(_mm256_mul_ps(distance, distance), _mm256_load_ps(block.c3))));
+        attenuation = _mm256_min_ps(one, _mm256_div_ps(one, attenuation));
+    }
+    if constexpr (kind == LightBlockKind::BLOCK_MIXED) {
+        __m256i type = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.type));
+        __m256 directional = _mm256_castsi256_ps(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(int(LightType::LIGHT_DIRECTIONAL))));
+        __m256 fixedDirection = _mm256_or_ps(directional, _mm256_castsi256_ps(
+                                                 _mm256_cmpeq_epi32(type, _mm256_set1_epi32(int(LightType::LIGHT_AREA)))));
+        lx = _mm256_blendv_ps(lx, dx, fixedDirection);
+        ly = _mm256_blendv_ps(ly, dy, fixedDirection);
+        lz = _mm256_blendv_ps(lz, dz, fixedDirection);
+        distance = _mm256_blendv_ps(distance, infinity, directional);
+        attenuation = _mm256_blendv_ps(attenuation, one, directional);
+    }
+
+    // spot lights: compare the cosine of the angle off the cone's axis with the cosines of the cones
+    __m256 falloff = one;
+    if constexpr (mayBeSpot) {
+        __m256 cosTheta = _mm256_sub_ps(zero, dot(lx, ly, lz, dx, dy, dz));
+        __m256 cosInner = _mm256_load_ps(block.cosInner);
+        __m256 s = _mm256_mul_ps(_mm256_sub_ps(cosInner, cosTheta), _mm256_load_ps(block.falloffScale));
+        __m256 smooth = _mm256_mul_ps(_mm256_mul_ps(s, s), _mm256_sub_ps(_mm256_set1_ps(3.f), _mm256_mul_ps(_mm256_set1_ps(2.f), s)));
+        __m256 spotFalloff = _mm256_blendv_ps(one, _mm256_sub_ps(one, smooth), _mm256_cmp_ps(cosTheta, cosInner, _CMP_LE_OQ));
+        spotFalloff = _mm256_blendv_ps(spotFalloff, zero, _mm256_cmp_ps(cosTheta, _mm256_load_ps(block.cosOuter), _CMP_LT_OQ));
+        if constexpr (kind == LightBlockKind::BLOCK_SPOT) {
+            falloff = spotFalloff;
+        } else {
+            __m256 spot = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_load_si256(reinterpret_cast<const __m256i *>(block.type)),
+                                                                 _mm256_set1_epi32(int(LightType::LIGHT_SPOT))));
+            falloff = _mm256_blendv_ps(one, spotFalloff, spot);
+        }
+    }
+    __m256 lightR = _mm256_mul_ps(falloff, _mm256_load_ps(block.colorR));
+    __m256 lightG = _mm256_mul_ps(falloff, _mm256_load_ps(block.colorG));
+    __m256 lightB = _mm256_mul_ps(falloff, _mm256_load_ps(block.colorB));
+
+    __m256 NdotL = dot(nx, ny, nz, lx, ly, lz);
+    __m256 twoNdotL = _mm256_mul_ps(_mm256_set1_ps(2.f), NdotL);
+    __m256 rx = _mm256_sub_ps(_mm256_mul_ps(twoNdotL, nx), lx);
+    __m256 ry = _mm256_sub_ps(_mm256_mul_ps(twoNdotL, ny), ly);
+    __m256 rz = _mm256_sub_ps(_mm256_mul_ps(twoNdotL, nz), lz);
+    __m256 RdotV = _mm256_max_ps(zero, dot(rx, ry, rz, vx, vy, vz));
+    __m256 highlight = fastPowLanes(RdotV, _mm256_set1_ps(surface.shininess));
+
+    // lights that face the surface and reach it
+    __m256 facing = _mm256_and_ps(_mm256_cmp_ps(NdotL, zero, _CMP_GT_OQ),
+                                  _mm256_cmp_ps(distance, _mm256_load_ps(block.radius), _CMP_LE_OQ));
+    _mm256_store_ps(samples.r, lightChannel(lightR, surface.diffuse.r, surface.specular.r, attenuation, NdotL, highlight, facing));
+    _mm256_store_ps(samples.g, lightChannel(lightG, surface.diffuse.g, surface.specular.g, attenuation, NdotL, highlight, facing));
+    _mm256_store_ps(samples.b, lightChannel(lightB, surface.diffuse.b, surface.specular.b, attenuation, NdotL, highlight, facing));
+    _mm256_store_ps(samples.dirX, lx);
+    _mm256_store_ps(samples.dirY, ly);
+    _mm256_store_ps(samples.dirZ, lz);
+    _mm256_store_ps(samples.distance, distance);
+}
+
+#endif
+
+}
+
+namespace PhongKernel {
+
+bool simdAvailable() {
+#if PHONG_KERNEL_AVX2 && (defined(__GNUC__) || defined(__clang__))
+    static const bool available = __builtin_cpu_supports("avx2");
+    return available;
+#elif PHONG_KERNEL_AVX2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void shadeLights(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                 const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples) {
+    if (simdAvailable()) {
+        shadeLightsAvx2(block, position, normal, directionToCamera, surface, samples);
+    } else {
+        shadeLightsScalar(block, position, normal, directionToCamera, surface, samples);
+    }
+}
+
+/**
+ * @brief shadeLightsScalar evaluates each lane with the same formulas (and approximations) as shadeLightsAvx2
+ */
+void shadeLightsScalar(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                       const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples) {
+    switch (block.kind) {
+        case LightBlockKind::BLOCK_POINT:
+            shadeBlockScalar<LightBlockKind::BLOCK_POINT>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_DIRECTIONAL:
+            shadeBlockScalar<LightBlockKind::BLOCK_DIRECTIONAL>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_SPOT:
+            shadeBlockScalar<LightBlockKind::BLOCK_SPOT>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_MIXED:
+            shadeBlockScalar<LightBlockKind::BLOCK_MIXED>(block, position, normal, directionToCamera, surface, samples);
+            break;
+    }
+}
+
+#if PHONG_KERNEL_AVX2
+
+PHONG_KERNEL_AVX2_TARGET
+void shadeLightsAvx2(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                     const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples) {
+    switch (block.kind) {
+        case LightBlockKind::BLOCK_POINT:
+            shadeBlockAvx2<LightBlockKind::BLOCK_POINT>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_DIRECTIONAL:
+            shadeBlockAvx2<LightBlockKind::BLOCK_DIRECTIONAL>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_SPOT:
+            shadeBlockAvx2<LightBlockKind::BLOCK_SPOT>(block, position, normal, directionToCamera, surface, samples);
+            break;
+        case LightBlockKind::BLOCK_MIXED:
+            shadeBlockAvx2<LightBlockKind::BLOCK_MIXED>(block, position, normal, directionToCamera, surface, samples);
+            break;
+    }
+}
+
+#else
+
+void shadeLightsAvx2(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                     const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples) {
+    shadeLightsScalar(block, position, normal, directionToCamera, surface, samples);
+}
+
+#endif
+
+void shadeLight(const LightBlock &block, int lane, const glm::vec3 &position, const glm::vec3 &normal,
+                const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples) {
+    shadeLaneScalar<LightBlockKind::BLOCK_MIXED>(block, lane, position, normal, directionToCamera, surface, samples);
+}
+
+float fastPow(float x, float y) {
+    if (x <= 0) {
+        return y == 0 ? 1.f : 0.f;
+    }
+    return fastExp2(y * fastLog2(std::max(x, std::numeric_limits<float>::min())));
+}
+
+}
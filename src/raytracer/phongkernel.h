@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "lights/lighttable.h"
+
+// Evaluates the diffuse and specular terms of Phong shading for a block of 8 lights (see LightTable) at once. On x86
+// CPUs with AVX2 the 8 lights are the 8 lanes of a vector register; elsewhere a scalar loop does the same arithmetic
+// lane by lane. Blocks of a single light type take a path specialized for it. Both use the same fast exp2/log2
+// approximations for the specular power (relative error around 1e-5), so images don't depend on the CPU they were
+// rendered on beyond float rounding.
+namespace PhongKernel {
+
+constexpr int lanes = lightBlockLanes;
+
+// Per-lane results of shadeLights
+struct alignas(32) LightSamples {
+    float r[lanes], g[lanes], b[lanes];            // unshadowed diffuse + specular; zero if the light can't reach the point or
+                                                   // the point is beyond the light's radius
+    float dirX[lanes], dirY[lanes], dirZ[lanes];   // normalized direction to the light
+    float distance[lanes];                         // to the light; infinity for directional lights
+};
+
+// What one shading point needs from its material
+struct SurfaceTerms {
+    glm::vec3 diffuse;   // the material's diffuse color, blended with the texture color
+    glm::vec3 specular;  // ks * cSpecular
+    float shininess;
+};
+
+// Whether shadeLights uses AVX2 on this CPU
+bool simdAvailable();
+
+// Diffuse and specular terms of every lane, as RayTracer::phong computes them for one light (without shadows)
+void shadeLights(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                 const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples);
+
+// The two implementations behind shadeLights, for benchmarks and comparisons. shadeLightsAvx2 must only be called
+// if simdAvailable().
+void shadeLightsScalar(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                       const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples);
+void shadeLightsAvx2(const LightBlock &block, const glm::vec3 &position, const glm::vec3 &normal,
+                     const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples);
+
+// The terms of a single lane, written to that lane of samples. For shading a few lights picked out of many.
+void shadeLight(const LightBlock &block, int lane, const glm::vec3 &position, const glm::vec3 &normal,
+                const glm::vec3 &directionToCamera, const SurfaceTerms &surface, LightSamples &samples);
+
+// x^y for x in [0, 1] through exp2(y * log2(x)), scalar version of the kernel's approximation
+float fastPow(float x, float y);
+
+}
@@ -1,6 +1,14 @@
 #include "raytracer.h"
 #include "raytracescene.h"
 #include "utils/rgba.h"
+#include "stats/raystats.h"
+#include "stats/perfcounters.h"
+#include "utils/rng.h"
+
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <tuple>
 
 
 RayTracer::RayTracer(Config config) :
@@ -9,34 +17,380 @@ RayTracer::RayTracer(Config config) :
 
 /**
  * @brief RayTracer::render populates the imageData pixel array by shooting a ray through each pixel on the view plane and (recursively) determining each ray's color.
- * @param imageData pointer to an RGBA array containing the colors of the canvas
+ * @param imageData pointer to an array receiving the linear (unclamped) colors of the canvas
  * @param scene reference to a RayTraceScene object which contains information about the scene's camera, primitives, and lights.
  */
-void RayTracer::render(RGBA *imageData, const RayTraceScene &scene) {
+void RayTracer::render(SceneColor *imageData, const RayTraceScene &scene) {
+    if (m_reservoirHistory) {
+        m_reservoirHistory->beginFrame(scene.width(), scene.height(), scene.getCamera());
+    }
+    renderTile(imageData, scene.width(), Tile{0, 0, 0, scene.width(), scene.height()}, scene);
+}
+
+/**
+ * @brief RayTracer::renderTile populates only the pixels of the canvas covered by the given tile. Every pixel is computed exactly as in render(),
+ *          so rendering all tiles of a canvas produces the same image as a single call to render().
+ * @param tileData pointer to the color of the tile's top-left pixel
+ * @param rowStride number of pixels between the starts of consecutive rows in tileData (the tile width for a standalone tile buffer)
+ * @param tile region of the canvas to render
+ * @param scene
+ * @param costData optional buffer with the same layout as tileData that receives the cost of each pixel
+ */
+void RayTracer::renderTile(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene, float *costData) {
+    bindScene(scene);
+    // deferred shading always works on small tiles, so that a tile's hit buffer stays in cache
+    if (!m_config.enableParallelism && !m_progress && !deferredShading()) {
+        traceTile(tileData, rowStride, tile, scene, costData);
+        return;
+    }
+
+    // progress is reported per sub-tile, weighted by each sub-tile's estimated cost
+    std::vector<Tile> subTiles = splitIntoTiles(tile, m_tileSize);
+    std::vector<double> estimatedCosts;
+    if (m_progress) {
+        estimatedCosts = estimateTileCosts(subTiles, scene);
+        double totalCost = 0;
+        for (double cost : estimatedCosts) {
+            totalCost += cost;
+        }
+        m_progress->planTiles(subTiles.size(), std::uint64_t(tile.width) * tile.height, totalCost);
+    }
+
+    auto renderSubTile = [this, tileData, rowStride, &tile, &scene, costData, &estimatedCosts](const Tile &subTile) {
+        std::uint64_t raysBefore = RayStats::threadRayCount();
+        std::size_t offset = std::size_t(subTile.y - tile.y)*rowStride + (subTile.x - tile.x);
+        traceTile(tileData + offset, rowStride, subTile, scene, costData ? costData + offset : nullptr);
+        if (m_progress) {
+            m_progress->completeTile(std::uint64_t(subTile.width) * subTile.height, estimatedCosts[subTile.index],
+                                     RayStats::threadRayCount() - raysBefore);
+        }
+    };
+    if (!m_config.enableParallelism) {
+        for (const Tile &subTile : subTiles) {
+            renderSubTile(subTile);
+        }
+        return;
+    }
+
+    // render sub-tiles concurrently with work stealing. Each sub-tile writes to a disjoint part of tileData,
+    // and tracing only reads the scene, so no synchronization is needed.
+    scheduler().run(subTiles, renderSubTile);
+}
+
+const RayTracer::Config &RayTracer::getConfig() const {
+    return m_config;
+}
+
+const TileScheduleStats *RayTracer::lastScheduleStats() const {
+    return m_scheduler ? &m_scheduler->stats() : nullptr;
+}
+
+void RayTracer::setProgress(RenderProgress *progress) {
+    m_progress = progress;
+}
+
+void RayTracer::setReservoirHistory(ReservoirHistory *history) {
+    m_reservoirHistory = history;
+}
+
+TileScheduler &RayTracer::scheduler() {
+    if (!m_scheduler) {
+        m_scheduler = std::make_unique<TileScheduler>(m_config.threadCount > 0 ? m_config.threadCount : QThread::idealThreadCount());
+    }
+    return *m_scheduler;
+}
+
+/**
+ * @brief RayTracer::bindScene caches the scene data used while tracing rays
+ */
+void RayTracer::bindScene(const RayTraceScene &scene) {
+    m_primitives = &scene.getPrimitives();
+    m_materials = &scene.getMaterials();
+    m_bvh = &scene.getBVH();
+    m_lightTable = &scene.getLightTable();
+    m_lightGrid = &scene.getLightGrid();
+    m_lightTree = &scene.getLightTree();
+}
+
+/**
+ * @brief RayTracer::traceTile shoots one ray through the center of each pixel in the tile. Assumes bindScene() was called with the same scene.
+ *          If costData is given, the cost of each pixel is measured around its traceRay call.
+ */
+void RayTracer::traceTile(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene, float *costData) {
+    if (deferredShading()) {
+        traceTileDeferred(tileData, rowStride, tile, scene, costData);
+        return;
+    }
     Camera camera = scene.getCamera();
-    m_primitives = scene.getPrimitives();
-    m_globalData = scene.getGlobalData();
 
     // iterate over pixel samples (at pixel centers)
-    for (int row = 0; row < scene.height(); row++) {
-        for (int col = 0; col < scene.width(); col++) {
-            // get coords of curr pixel on view plane in camera space (uvk), pick k=depth=1
-            float k = 1.f;
-            vec3 uvk = getViewPlaneCoords(row, col, k, scene);
-            // get ray direction in camera space
-            vec3 rayDirCamSpace = uvk; // eye = <0,0,0> in cam space
+    for (int row = tile.y; row < tile.y + tile.height; row++) {
+        for (int col = tile.x; col < tile.x + tile.width; col++) {
+            Ray ray = cameraRay(row, col, camera, scene);
+
+            // trace ray to get final pixel color, update image data (64-bit index so that huge canvases don't overflow)
+            std::size_t pixelIdx = std::size_t(row - tile.y)*rowStride + (col - tile.x);
+            std::uint64_t costBefore = costData ? sampleCost(m_config.costMetric) : 0;
+            PerfCounters::beginPixel(); // every n-th pixel is split into intersection and shading work
+            tileData[pixelIdx] = traceRay(ray, *m_primitives);
+            PerfCounters::endPixel();
+            if (costData) {
+                costData[pixelIdx] = float(sampleCost(m_config.costMetric) - costBefore);
+            }
+        }
+    }
+}
+
+/**
+ * @brief RayTracer::traceTileDeferred renders a tile in two passes. The geometry pass finds the closest hit of every
+ *          camera ray and records it; the shading pass sorts the hits by material and primitive and shades them in
+ *          that order, so consecutive hits read the same material entry and texture instead of jumping between
+ *          them with every pixel. The image is the same as traceTile's: each hit is shaded by the same code, with
+ *          the camera ray rebuilt from its pixel.
+ *          If costData is given, each pixel's cost is the sum of its cost in both passes.
+ */
+void RayTracer::traceTileDeferred(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene, float *costData) {
+    Camera camera = scene.getCamera();
+    // reused across tiles so that its storage is only allocated while a thread renders its first tiles
+    thread_local std::vector<DeferredHit> hits{};
+    hits.clear();
+
+    // geometry pass
+    for (int row = tile.y; row < tile.y + tile.height; row++) {
+        for (int col = tile.x; col < tile.x + tile.width; col++) {
+            Ray ray = cameraRay(row, col, camera, scene);
+            std::size_t pixelIdx = std::size_t(row - tile.y)*rowStride + (col - tile.x);
+            std::uint64_t costBefore = costData ? sampleCost(m_config.costMetric) : 0;
+            PerfCounters::beginPixel();
+            RayStats::countRay(RayType::RAY_PRIMARY);
+            HitRecord hit = findClosestHit(ray, *m_primitives);
+            PerfCounters::endPixel();
+            if (hit.found()) {
+                hits.push_back(DeferredHit{(*m_primitives)[hit.primitive]->getMaterialIndex(),
+                                           std::uint32_t((row - tile.y)*tile.width + (col - tile.x)), hit});
+            }
+            tileData[pixelIdx] = SceneColor(0, 0, 0, 1); // misses stay black
+            if (costData) {
+                costData[pixelIdx] = float(sampleCost(m_config.costMetric) - costBefore);
+            }
+        }
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const DeferredHit &a, const DeferredHit &b) {
+        return std::tie(a.material, a.hit.primitive, a.pixel) < std::tie(b.material, b.hit.primitive, b.pixel);
+    });
+
+    // light resampling needs the hits of neighboring pixels, so it runs between the passes
+    thread_local std::vector<LightResampling::Reservoir> reservoirs{};
+    bool resampling = m_config.lightCandidates > 0 && !m_lightTree->empty();
+    if (resampling) {
+        resampleLights(tile, hits, scene, reservoirs);
+    }
+
+    // shading pass
+    for (const DeferredHit &hit : hits) {
+        int row = tile.y + hit.pixel / tile.width;
+        int col = tile.x + hit.pixel % tile.width;
+        Ray ray = cameraRay(row, col, camera, scene);
+        std::size_t pixelIdx = std::size_t(row - tile.y)*rowStride + (col - tile.x);
+        std::uint64_t costBefore = costData ? sampleCost(m_config.costMetric) : 0;
+        PerfCounters::beginPixel();
+        tileData[pixelIdx] = shadeHit(ray, hit.hit, resampling ? &reservoirs[hit.pixel] : nullptr);
+        PerfCounters::endPixel();
+        if (costData) {
+            costData[pixelIdx] += float(sampleCost(m_config.costMetric) - costBefore);
+        }
+    }
+}
+
+/**
+ * @brief RayTracer::deferredShading is true if tiles are rendered by traceTileDeferred: when asked for, or when lights
+ *          are resampled, which needs the hits of the whole tile
+ */
+bool RayTracer::deferredShading() const {
+    return m_config.enableDeferredShading || m_config.lightCandidates > 0;
+}
+
+/**
+ * @brief RayTracer::resampleLights picks the light that gets the shadow ray of each camera hit of a tile, in three steps:
+ *          1. every hit streams m_config.lightCandidates lights sampled from the light tree into its reservoir, each
+ *             weighted by its target pdf over the probability of sampling it;
+ *          2. if a reservoir history is set, the reservoir stored for the same surface in the previous frame is merged
+ *             in, capped at m_temporalReuseLimit times the fresh candidates so that old choices fade out;
+ *          3. the reservoirs of m_spatialReuseSamples random hits within m_spatialReuseRadius pixels (and within the
+ *             pixel's reuse block) are merged in, if their surfaces are similar enough.
+ *          Reuse blocks are m_spatialReuseBlock pixels wide and aligned to the canvas, and random numbers are seeded
+ *          from the canvas pixel and the frame, so a pixel's light doesn't depend on how the canvas is split into
+ *          tiles, bands or distributed work, nor on thread scheduling. Pixels of the blocks that lie outside the tile
+ *          only get a camera ray and steps 1-2 here; that is free when tiles are aligned to the blocks.
+ * @param hits the camera hits of the tile, as recorded by traceTileDeferred
+ * @param reservoirs receives the final reservoir of each hit, indexed by DeferredHit::pixel
+ */
+void RayTracer::resampleLights(const Tile &tile, const std::vector<DeferredHit> &hits, const RayTraceScene &scene,
+                               std::vector<LightResampling::Reservoir> &reservoirs) {
+    using LightResampling::Reservoir;
+    using LightResampling::SurfacePoint;
+    Camera camera = scene.getCamera();
+    // the reuse blocks overlapping the tile, clipped to the canvas
+    int block = m_spatialReuseBlock;
+    Tile window{tile.index, tile.x / block * block, tile.y / block * block, 0, 0};
+    window.width = std::min((tile.x + tile.width + block - 1) / block * block, scene.width()) - window.x;
+    window.height = std::min((tile.y + tile.height + block - 1) / block * block, scene.height()) - window.y;
+    std::size_t windowCount = std::size_t(window.width) * window.height;
+    thread_local std::vector<SurfacePoint> points{};
+    thread_local std::vector<Reservoir> initial{};
+    thread_local std::vector<char> hasHit{};
+    points.resize(windowCount);
+    initial.assign(windowCount, Reservoir{});
+    hasHit.assign(windowCount, 0);
+    reservoirs.assign(std::size_t(tile.width) * tile.height, Reservoir{});
+    std::uint64_t frame = m_reservoirHistory ? m_reservoirHistory->frame() : 0;
+    auto pixelSeed = [frame](int row, int col) {
+        return hashSeed(hashSeed(frame, std::uint64_t(row)), std::uint64_t(col));
+    };
+    auto windowIndex = [&window](int row, int col) {
+        return std::size_t(row - window.y) * window.width + (col - window.x);
+    };
+
+    // candidates and temporal reuse for the camera hit at a canvas pixel
+    auto resampleCandidates = [&](int row, int col, const HitRecord &hit) {
+        Ray ray = cameraRay(row, col, camera, scene);
+        const std::shared_ptr<Primitive> &primitive = (*m_primitives)[hit.primitive];
+        const ShadingMaterial &material = (*m_materials)[primitive->getMaterialIndex()];
+        std::size_t idx = windowIndex(row, col);
+        SurfacePoint &point = points[idx];
+        point.position = ray.getPos(hit.t);
+        point.normal = primitive->getWorldSpaceNormal(hit.objSpacePoint);
+        point.directionToCamera = -glm::normalize(ray.getDir());
+        point.depth = glm::length(point.position - camera.getPos());
+        glm::vec3 textureColor = material.textured ? glm::vec3(primitive->getTexture(hit.objSpacePoint)) : glm::vec3(0);
+        point.surface = PhongKernel::SurfaceTerms{material.blend * textureColor + material.diffuse, material.specular,
+                                                  material.shininess};
+        hasHit[idx] = 1;
+
+        Rng rng(pixelSeed(row, col));
+        Reservoir &reservoir = initial[idx];
+        for (int i = 0; i < m_config.lightCandidates; i++) {
+            LightTree::Sample sample{LightResampling::noLight, 0};
+            float candidateTargetPdf = 0;
+            if (m_lightTree->sample(point.position, point.normal, rng, sample)) {
+                RayStats::count(RenderEvent::EVENT_LIGHT_EVALUATION);
+                candidateTargetPdf = LightResampling::targetPdf(*m_lightTable, sample.slot, point);
+            }
+            reservoir.add(sample.slot, candidateTargetPdf / sample.probability, candidateTargetPdf, rng);
+        }
+        reservoir.finalize();
 
-            // convert to world space direction using the camera matrix (cam space -> world space)
-            vec3 rayDirWorldSpace = camera.getCameraMatrix() * glm::vec4(rayDirCamSpace, 0);
-            // construct ray in WORLD space
-            Ray ray(rayDirWorldSpace, camera.getPos()); // cam pos is already in world space
+        const ReservoirHistory::Entry *previous = m_reservoirHistory ? m_reservoirHistory->previous(point.position) : nullptr;
+        if (previous && LightResampling::similar(point, previous->position, previous->normal)) {
+            Reservoir history = previous->reservoir;
+            history.count = std::min(history.count, float(m_temporalReuseLimit * m_config.lightCandidates));
+            Reservoir combined{};
+            combined.merge(reservoir, point, *m_lightTable, rng);
+            combined.merge(history, point, *m_lightTable, rng);
+            combined.finalize();
+            reservoir = combined;
+        }
+    };
 
-            // trace ray to get final pixel color, update image data
-            imageData[col + row*scene.width()] = traceRay(ray, m_primitives, scene.getLights(), 0); // start w/ 0 recursion depth
+    for (const DeferredHit &hit : hits) {
+        resampleCandidates(tile.y + int(hit.pixel) / tile.width, tile.x + int(hit.pixel) % tile.width, hit.hit);
+    }
+    for (int row = window.y; row < window.y + window.height; row++) {
+        for (int col = window.x; col < window.x + window.width; col++) {
+            if (row >= tile.y && row < tile.y + tile.height && col >= tile.x && col < tile.x + tile.width) {
+                continue;
+            }
+            Ray ray = cameraRay(row, col, camera, scene);
+            HitRecord hit = findClosestHit(ray, *m_primitives);
+            if (hit.found()) {
+                resampleCandidates(row, col, hit);
+            }
+        }
+    }
+
+    // spatial reuse, reading only the reservoirs of the first step so that the result doesn't depend on pixel order
+    for (const DeferredHit &hit : hits) {
+        int row = tile.y + int(hit.pixel) / tile.width;
+        int col = tile.x + int(hit.pixel) % tile.width;
+        std::size_t idx = windowIndex(row, col);
+        const SurfacePoint &point = points[idx];
+        Rng rng(hashSeed(pixelSeed(row, col), std::uint64_t(1)));
+        Reservoir &reservoir = reservoirs[hit.pixel];
+        reservoir.merge(initial[idx], point, *m_lightTable, rng);
+        int blockRow = row / block * block;
+        int blockCol = col / block * block;
+        for (int i = 0; i < m_spatialReuseSamples; i++) {
+            // uniform in the disk around the pixel
+            float radius = m_spatialReuseRadius * std::sqrt(rng.nextFloat());
+            float angle = 6.2831853f * rng.nextFloat();
+            int neighborRow = std::clamp(row + int(std::lround(radius * std::sin(angle))), blockRow,
+                                         std::min(blockRow + block, scene.height()) - 1);
+            int neighborCol = std::clamp(col + int(std::lround(radius * std::cos(angle))), blockCol,
+                                         std::min(blockCol + block, scene.width()) - 1);
+            std::size_t neighbor = windowIndex(neighborRow, neighborCol);
+            if (neighbor == idx || !hasHit[neighbor] ||
+                !LightResampling::similar(point, points[neighbor].position, points[neighbor].normal)) {
+                continue;
+            }
+            reservoir.merge(initial[neighbor], point, *m_lightTable, rng);
+        }
+        reservoir.finalize();
+        if (m_reservoirHistory) {
+            m_reservoirHistory->store(row, col, ReservoirHistory::Entry{reservoir, point.position, point.normal});
         }
     }
 }
 
+/**
+ * @brief RayTracer::estimateTileCosts is the progress pre-pass: it traces one pixel of every m_costSampleStep^2 block
+ *          of each tile and times them. The results are only compared with each other, so timing noise on single
+ *          tiles mostly averages out over the image.
+ * @return the estimated cost of each tile in nanoseconds, indexed by Tile::index
+ */
+std::vector<double> RayTracer::estimateTileCosts(const std::vector<Tile> &tiles, const RayTraceScene &scene) {
+    std::vector<double> costs(tiles.size(), 0.0);
+    auto estimate = [this, &costs, &scene](const Tile &tile) {
+        Camera camera = scene.getCamera();
+        // the probes are not part of the render, so they stay out of its stats
+        RayStats::UncountedScope uncounted;
+        int samples = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int row = tile.y + std::min(m_costSampleStep, tile.height) / 2; row < tile.y + tile.height; row += m_costSampleStep) {
+            for (int col = tile.x + std::min(m_costSampleStep, tile.width) / 2; col < tile.x + tile.width; col += m_costSampleStep) {
+                Ray ray = cameraRay(row, col, camera, scene);
+                traceRay(ray, *m_primitives);
+                samples++;
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        costs[tile.index] = samples > 0 ? ns / samples * tile.width * tile.height : 0.0;
+    };
+    if (m_config.enableParallelism) {
+        scheduler().run(tiles, estimate);
+    } else {
+        for (const Tile &tile : tiles) {
+            estimate(tile);
+        }
+    }
+    return costs;
+}
+
+/**
+ * @brief RayTracer::cameraRay builds the world space ray from the camera through the center of a pixel
+ */
+Ray RayTracer::cameraRay(int row, int col, const Camera &camera, const RayTraceScene &scene) {
+    // get coords of curr pixel on view plane in camera space (uvk), pick k=depth=1
+    float k = 1.f;
+    vec3 uvk = getViewPlaneCoords(row, col, k, scene);
+    // get ray direction in camera space
+    vec3 rayDirCamSpace = uvk; // eye = <0,0,0> in cam space
+
+    // convert to world space direction using the camera matrix (cam space -> world space)
+    vec3 rayDirWorldSpace = camera.getCameraMatrix() * glm::vec4(rayDirCamSpace, 0);
+    // construct ray in WORLD space
+    return Ray(rayDirWorldSpace, camera.getPos()); // cam pos is already in world space
+}
 
 /**
  * @brief RayTracer::getViewPlaneCoords returns the coordinate in camera space of an input pixel on the view plane
@@ -58,143 +412,278 @@ vec3 RayTracer::getViewPlaneCoords(int row, int col, float k, const RayTraceScen
 }
 
 /**
- * @brief RayTracer::traceRay traces the given world space ray through the scene and computes the final lighting for the ray (black if ray does not intersect any geometry)
+ * @brief RayTracer::traceRay traces the given world space camera ray through the scene and computes the final lighting for the ray (black if ray does not intersect any geometry)
  * @param worldSpaceRay a Ray defined in world space via its origin position and direction
- * @param scene
- * @param currRecursionDepth the current depth in the recursion tree. Recursive rays are not generated if the maximum depth is reached.
- * @return RGBA color corresponding to this ray
+ * @param primitives
+ * @return linear color corresponding to this ray (not clamped, so bright highlights keep their energy until tone mapping)
  */
-RGBA RayTracer::traceRay(Ray &worldSpaceRay, 
-                        std::vector<std::shared_ptr<Primitive>> &primitives, 
-                        const std::vector<Light> &lights,
-                        int currRecursionDepth) {
-                            
+SceneColor RayTracer::traceRay(Ray &worldSpaceRay, const std::vector<std::shared_ptr<Primitive>> &primitives) {
+    RayStats::countRay(RayType::RAY_PRIMARY);
+
     // keep track of the intersected primitive (if any) and the object space intersection for normal calculation
-    int intersectedPrimitiveIdx;
-    vec3 objSpaceIntersection;
-    // iterate over all primitives and check for intersections
-    for (int i = 0; i < primitives.size(); i++) {
-        std::shared_ptr<Primitive> currPrimitive = primitives[i];
-        // construct obj space ray from world space ray
-        Ray objSpaceRay = Ray(
+    HitRecord hit = findClosestHit(worldSpaceRay, primitives);
+    if (hit.found()) {
+        return shadeHit(worldSpaceRay, hit);
+    }
+    // if no intersection, return black
+    return SceneColor(0, 0, 0, 1);
+}
+
+/**
+ * @brief RayTracer::findClosestHit finds the closest intersection of the ray with the primitives within the ray's (tMin, tMax) interval,
+ *          shrinking the ray's tMax to it
+ * @param worldSpaceRay a Ray defined in world space
+ * @return the closest hit; HitRecord::found() is false if the ray hits nothing in its interval
+ */
+HitRecord RayTracer::findClosestHit(Ray &worldSpaceRay, const std::vector<std::shared_ptr<Primitive>> &primitives) {
+    HitRecord hit{};
+    // counted locally and reported once per ray to keep the per-test overhead to an increment
+    std::uint64_t intersectionTests = 0;
+    std::uint64_t intersectionHits = 0;
+    PerfCounters::beginIntersection();
+    auto testPrimitive = [&](int i) {
+        const std::shared_ptr<Primitive> &currPrimitive = primitives[i];
+        // construct obj space ray from world space ray. t is the same in both spaces, so it keeps the world space interval.
+        Ray objSpaceRay(
             currPrimitive->applyInverseCTM(worldSpaceRay.getDir(), true), // direction is a vector
-            currPrimitive->applyInverseCTM(worldSpaceRay.getOrigin(), false) // ray origin is a point
+            currPrimitive->applyInverseCTM(worldSpaceRay.getOrigin(), false), // ray origin is a point
+            worldSpaceRay.getTMin(),
+            worldSpaceRay.getTMax()
         );
-        // use primitive's implicit formula to find the nearest intersection (t) in obj space (if any). This t is the same for world space.
+        // use primitive's implicit formula to find the nearest intersection (t) in obj space (if any). Hits beyond the
+        // closest one found so far are rejected by the primitive, so any hit is the new closest.
         float currT = currPrimitive->getIntersectionT(objSpaceRay);
-        
-        // store obj space intersection only if valid
-        if (currT > 0 && currT < worldSpaceRay.getIntersectionT()) {
-            objSpaceIntersection = objSpaceRay.getPos(currT);
-            intersectedPrimitiveIdx = i;
-            // store current value of t in world space ray bc currPrimitive is the closest yet
-            worldSpaceRay.setIntersectionT(currT);
-        }
-    }
-           
-    // compute lighting if the given ray is not a shadow ray AND ray-obj intersection exists (i.e. if 0 < t < infinity)
-    if (currRecursionDepth != -1 && worldSpaceRay.getIntersectionT() > 0 && worldSpaceRay.getIntersectionT() < std::numeric_limits<float>::infinity()) {
+        intersectionTests++;
+        if (currT < std::numeric_limits<float>::infinity()) {
+            intersectionHits++;
+            hit = HitRecord{i, currT, objSpaceRay.getPos(currT)};
+            worldSpaceRay.setTMax(currT);
+        }
+    };
+
+    if (m_config.enableAcceleration && m_bvh && !m_bvh->empty()) {
+        // only test primitives whose bounds the ray reaches before the closest intersection found so far
+        int nodesVisited = m_bvh->traverse(worldSpaceRay, testPrimitive);
+        RayStats::count(RenderEvent::EVENT_BVH_NODE, nodesVisited);
+    } else {
+        // iterate over all primitives and check for intersections
+        for (int i = 0; i < primitives.size(); i++) {
+            testPrimitive(i);
+        }
+    }
+    PerfCounters::endIntersection();
+    RayStats::count(RenderEvent::EVENT_INTERSECTION_TEST, intersectionTests);
+    RayStats::count(RenderEvent::EVENT_INTERSECTION_HIT, intersectionHits);
+    return hit;
+}
+
+/**
+ * @brief RayTracer::occluded traces a shadow ray toward the light in the given slot of the light table. Neighboring
+ *          shadow rays toward the same light tend to be blocked by the same primitive, so each thread remembers the
+ *          primitive that last blocked each light and tests it before the full query. A primitive blocks the ray
+ *          either way, so the cache only decides how fast the answer is found, never what it is.
+ * @param shadowRay world space ray from the shaded point toward the light, ending at the light (tMax)
+ * @return whether a primitive blocks the ray before it reaches the light
+ */
+bool RayTracer::occluded(Ray &shadowRay, std::uint32_t lightSlot) {
+    RayStats::countRay(RayType::RAY_SHADOW);
+    // entries may be left over from another scene, which only costs a wasted test
+    thread_local std::vector<int> lastOccluders{};
+    std::size_t slotCount = m_lightTable->blockCount() * lightBlockLanes;
+    if (lastOccluders.size() < slotCount) {
+        lastOccluders.resize(slotCount, -1);
+    }
+    int &lastOccluder = lastOccluders[lightSlot];
+
+    if (lastOccluder >= 0 && lastOccluder < int(m_primitives->size())) {
+        RayStats::count(RenderEvent::EVENT_OCCLUDER_CACHE_LOOKUP);
+        RayStats::count(RenderEvent::EVENT_INTERSECTION_TEST);
+        const std::shared_ptr<Primitive> &primitive = (*m_primitives)[lastOccluder];
+        Ray objSpaceRay(primitive->applyInverseCTM(shadowRay.getDir(), true), primitive->applyInverseCTM(shadowRay.getOrigin(), false),
+                        shadowRay.getTMin(), shadowRay.getTMax());
+        if (primitive->getIntersectionT(objSpaceRay) < std::numeric_limits<float>::infinity()) {
+            RayStats::count(RenderEvent::EVENT_INTERSECTION_HIT);
+            RayStats::count(RenderEvent::EVENT_OCCLUDER_CACHE_HIT);
+            return true;
+        }
+    }
+
+    HitRecord hit = findClosestHit(shadowRay, *m_primitives);
+    if (hit.found()) {
+        lastOccluder = hit.primitive;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief RayTracer::shadeHit computes the lighting where a camera ray hits a primitive, including the chain of mirror
+ *          reflections seen there. The chain is followed in a loop, carrying the path throughput: the product of the
+ *          reflective coefficients of the surfaces along it. A reflection ray is only spawned if reflections are
+ *          enabled, the depth limit isn't reached and the throughput is at least m_config.minThroughput, so
+ *          surfaces that don't reflect never spawn one. From m_config.rouletteDepth bounces on, the path survives with
+ *          probability equal to its throughput (Russian roulette), and survivors are weighted up to stay unbiased.
+ * @param worldSpaceRay the camera ray
+ * @param hit its closest hit
+ * @param reservoir if not null, the light picked by resampling for this hit (see phong); reflections shade as usual
+ */
+SceneColor RayTracer::shadeHit(const Ray &worldSpaceRay, const HitRecord &cameraHit,
+                               const LightResampling::Reservoir *reservoir) {
+    glm::vec3 totalIllumination(0);
+    glm::vec3 throughput(1);
+    Ray ray = worldSpaceRay;
+    HitRecord hit = cameraHit;
+    for (int depth = 0; ; depth++) {
+        const std::shared_ptr<Primitive> &primitive = (*m_primitives)[hit.primitive];
         // compute WORLD space normal and intersection point
-        vec3 worldNormal = primitives[intersectedPrimitiveIdx]->getWorldSpaceNormal(objSpaceIntersection); // already normalized
-        vec3 worldIntersection = worldSpaceRay.getIntersectionPoint();
-        vec3 dirToCamera = -worldSpaceRay.getDir(); // original ray dir is from camera to intersection point
-
-        // compute lighting
-        return phong(
-            worldIntersection, 
-            worldNormal, 
-            dirToCamera, 
-            primitives[intersectedPrimitiveIdx]->getMaterial(), 
-            primitives[intersectedPrimitiveIdx]->getTexture(objSpaceIntersection),
-            lights,
-            m_globalData,
-            currRecursionDepth // used to recursively call traceRay when lighting
-        );
+        vec3 worldNormal = primitive->getWorldSpaceNormal(hit.objSpacePoint); // already normalized
+        vec3 worldIntersection = ray.getPos(hit.t);
+        vec3 dirToCamera = glm::normalize(-ray.getDir()); // ray dir is from the camera (or the previous bounce) to the intersection point
+        const ShadingMaterial &material = (*m_materials)[primitive->getMaterialIndex()];
+        // the texture coordinates and color are only computed for textured materials
+        SceneColor textureColor(0, 0, 0, 1);
+        if (material.textured) {
+            RayStats::count(RenderEvent::EVENT_TEXTURE_FETCH);
+            textureColor = primitive->getTexture(hit.objSpacePoint);
+        }
+        SceneColor localColor = phong(worldIntersection, worldNormal, dirToCamera, material, textureColor,
+                                      depth, depth == 0 ? reservoir : nullptr);
+        totalIllumination += throughput * glm::vec3(localColor);
+
+        // decide whether a reflection ray could still add anything visible
+        if (!m_config.enableReflection || depth >= m_config.maxDepth) {
+            break;
+        }
+        glm::vec3 reflectedThroughput = throughput * material.reflective;
+        float potential = std::max(std::max(reflectedThroughput.r, reflectedThroughput.g), reflectedThroughput.b);
+        if (!(potential > 0) || potential < m_config.minThroughput) {
+            break;
+        }
+        if (m_config.rouletteDepth > 0 && depth + 1 >= m_config.rouletteDepth && potential < 1) {
+            // seeded from the hit, so the decision is the same however pixels are distributed over threads
+            Rng rng(hashSeed(hashSeed(hashSeed(std::uint64_t(depth), worldIntersection.x), worldIntersection.y), worldIntersection.z));
+            if (rng.nextFloat() >= potential) {
+                break;
+            }
+            reflectedThroughput /= potential;
+        }
+
+        // shoot reflection across normal
+        glm::vec3 reflectedViewDirection = glm::reflect(-dirToCamera, worldNormal);
+        ray = Ray(reflectedViewDirection, worldIntersection + 0.0001f*reflectedViewDirection); // add epsilon to avoid self-reflections
+        RayStats::countRay(RayType::RAY_REFLECTION);
+        hit = findClosestHit(ray, *m_primitives);
+        if (!hit.found()) {
+            break;
+        }
+        throughput = reflectedThroughput;
     }
-    // if no intersection, return black
-    return RGBA{0,0,0};
+
+    // keep the full range: clamping happens once, when the framebuffer is tone mapped for output
+    return SceneColor(totalIllumination, 1);
 }
 
 /**
- * @brief RayTracer::phong (recursively) computes the RGBA color at the given point from the given view direction using the phong lighting equation.
- *          Handles shadows by ignoring the contribution of occlued light sources
+ * @brief RayTracer::phong computes the linear color at the given point from the given view direction using the phong lighting equation,
+ *          without reflections (see shadeHit). If shadows are enabled, the contribution of occluded light sources is ignored.
  * @param intersectionPosition position at which the ray first intersects scene geometry. In world space.
  * @param normal world-space normal of the intersected object at the intersection point
  * @param directionToCamera vector determining the direction from the intersection position to the viewer
- * @param material SceneMaterial containing object-specific color and lighting coefficients
+ * @param material the object's material, with the scene's global coefficients already applied
  * @param textureColor color retrieved from the texture image at the intersection point
- * @param lights vector of Lights in the scene
- * @param globalData SceneGlobalData containing scene coefficients needed in the Phong lighting equation
- * @param currRecursionDepth
- * @return RGBA color corresponding to the given ray
+ * @param depth number of reflections between the camera and this point, mixed into the seed of light sampling
+ * @param reservoir if not null, the point and spot lights are replaced by the light it holds, weighted by its weight
+ * @return unclamped color corresponding to the given ray
  */
-RGBA RayTracer::phong(
-           glm::vec3  intersectionPosition,
-           glm::vec3  normal,
-           glm::vec3  directionToCamera,
-           SceneMaterial material,
-           SceneColor textureColor, // color of texture img at the intersection position
-           const std::vector<Light>& lights,
-           SceneGlobalData globalData,
-           int currRecursionDepth) {
+SceneColor RayTracer::phong(
+                 const glm::vec3 &intersectionPosition,
+                 glm::vec3  normal,
+                 glm::vec3  directionToCamera,
+                 const ShadingMaterial &material,
+                 const SceneColor &textureColor, // color of texture img at the intersection position
+                 int depth,
+                 const LightResampling::Reservoir *reservoir) {
     // normalizing directions
     normal            = glm::normalize(normal);
     directionToCamera = glm::normalize(directionToCamera);
 
 
-    // output illumination (ignore opacity)
-    glm::vec4 totalIllumination(0, 0, 0, 1);
-
-    // add the ambient term
-    totalIllumination += globalData.ka * material.cAmbient;
+    // output illumination (opacity is set at the end)
+    glm::vec3 totalIllumination = material.ambient;
 
-    for (Light light : lights) {
-        SceneLightData lightData = light.getLightData();
-        glm::vec3 directionToLight = light.getDirToLight(intersectionPosition);
-        float distToLight = (light.getType() == LightType::LIGHT_DIRECTIONAL) ?  std::numeric_limits<float>::infinity() : glm::length(vec3(lightData.pos) - intersectionPosition);
-        // compute attenuation factor
-        float f_att = (light.getType() == LightType::LIGHT_DIRECTIONAL) ? 1 : light.attenuationFn(distToLight); // no attenuation for directional lights (only for spot/point lights)
-
-        // shoot shadow ray to determine visibility of primary intersection point
-        vec3 shadowRayOrigin = intersectionPosition + 0.001f*directionToLight; // add epsilon to avoid self-shadowing
-        Ray shadowRayWorldSpace(directionToLight, shadowRayOrigin);
-        // shoot shadow ray at special recursion depth=-1 so that no further recursive rays are traced. Ignore color output of traceRay.
-        traceRay(shadowRayWorldSpace, m_primitives, lights, -1); // stores intersection (if any) in the passed shadow ray
-        if (shadowRayWorldSpace.getIntersectionT() < distToLight) {
-            // shadow ray to light is occluded bc intersection exists BEFORE ray reaches light: ignore this light's contribution
-            continue;
+    // the diffuse color linearly interpolates the material color and the texture color
+    PhongKernel::SurfaceTerms surface{material.blend * glm::vec3(textureColor) + material.diffuse, material.specular,
+                                      material.shininess};
+    PhongKernel::LightSamples samples;
+    // adds the contribution of the light in slot (in its lane of samples), scaled by weight, unless the light is occluded
+    auto addIfVisible = [&](std::uint32_t slot, float weight) {
+        int i = int(slot % lightBlockLanes);
+        RayStats::count(RenderEvent::EVENT_LIGHT_EVALUATION);
+        glm::vec3 contribution(samples.r[i], samples.g[i], samples.b[i]);
+        if (contribution == glm::vec3(0)) {
+            // the light is behind the surface, out of reach or the point is outside its cone: no shadow ray needed
+            return;
         }
 
-        // only add diffuse/specular light if normal faces toward the camera (i.e. angle < 90 deg)
-        float NdotL = glm::dot(normal, directionToLight);
-        if (NdotL > 0 ) {
-            SceneColor lightColor = light.getColor(intersectionPosition);
-            
-            // add the diffuse term (linearly interpolated material color and texture color)
-            SceneColor diffuseColor = material.blend * textureColor  +  (1-material.blend)*(globalData.kd * material.cDiffuse);
-            totalIllumination += f_att * (lightColor * diffuseColor) * NdotL;
-
-            // add the specular term I*k*O*(R*V)^n
-            glm::vec3 reflectedLightDirection = glm::reflect(-directionToLight, normal);
-            float RdotV = std::max(0.f, glm::dot(reflectedLightDirection, directionToCamera));
-            totalIllumination += f_att * (lightColor * globalData.ks * material.cSpecular) * std::pow(RdotV, material.shininess);
+        if (m_config.enableShadow) {
+            // shoot shadow ray to determine visibility of the intersection point
+            glm::vec3 directionToLight(samples.dirX[i], samples.dirY[i], samples.dirZ[i]);
+            vec3 shadowRayOrigin = intersectionPosition + 0.001f*directionToLight; // add epsilon to avoid self-shadowing
+            Ray shadowRayWorldSpace(directionToLight, shadowRayOrigin, 0, samples.distance[i]);
+            if (occluded(shadowRayWorldSpace, slot)) {
+                // shadow ray to light is occluded bc intersection exists BEFORE ray reaches light: ignore this light's contribution
+                return;
+            }
         }
-    }
+        totalIllumination += weight * contribution;
+    };
+    auto addLight = [&](std::uint32_t slot, float weight) {
+        PhongKernel::shadeLight(m_lightTable->blocks()[slot / lightBlockLanes], int(slot % lightBlockLanes),
+                                intersectionPosition, normal, directionToCamera, surface, samples);
+        addIfVisible(slot, weight);
+    };
 
-    // add reflection
-    if (currRecursionDepth < m_maxRecursionDepth) {
-        glm::vec3 reflectedViewDirection = glm::reflect(-directionToCamera, normal);
-        // glm::vec3 reflectedViewDirection = 2.f*glm::dot(directionToCamera, normal)*normal - directionToCamera;
-        
-        // shoot reflection across normal
-        Ray reflectionRay(reflectedViewDirection, intersectionPosition + 0.0001f*reflectedViewDirection); // add epsilon to avoid self-reflections
-        SceneColor reflectionColor = RGBAtoSceneColor(traceRay(reflectionRay, m_primitives, lights, currRecursionDepth + 1));
-        
-        // add contribution of reflection to the final intensity of this ray's pixel
-        totalIllumination += globalData.ks * material.cReflective * reflectionColor;
+    if (reservoir) {
+        // resampled lights: directional and area lights are all shaded, the others through the one light kept by the
+        // reservoir, so the hit traces a single shadow ray for all of them
+        for (std::uint32_t slot : m_lightTree->globalSlots()) {
+            addLight(slot, 1);
+        }
+        if (reservoir->slot != LightResampling::noLight) {
+            addLight(reservoir->slot, reservoir->weight);
+        }
+    } else if (m_config.lightSamples > 0 && !m_lightTree->empty()) {
+        // many lights: directional and area lights are all shaded, the others through a few lights picked in proportion
+        // to their estimated contribution. Dividing each by the probability of picking it keeps the sum unbiased.
+        for (std::uint32_t slot : m_lightTree->globalSlots()) {
+            addLight(slot, 1);
+        }
+        Rng rng(hashSeed(hashSeed(hashSeed(std::uint64_t(depth), intersectionPosition.x),
+                                  intersectionPosition.y), intersectionPosition.z));
+        for (int i = 0; i < m_config.lightSamples; i++) {
+            LightTree::Sample sample;
+            if (m_lightTree->sample(intersectionPosition, normal, rng, sample)) {
+                addLight(sample.slot, 1 / (m_config.lightSamples * sample.probability));
+            }
+        }
+    } else {
+        // only the lights that can reach this point: those that reach everywhere, then those binned in its grid cell
+        auto shadeBlock = [&](std::uint32_t blockIdx) {
+            const LightBlock &block = m_lightTable->blocks()[blockIdx];
+            // diffuse and specular terms of up to 8 lights at once, as if none of them were occluded
+            PhongKernel::shadeLights(block, intersectionPosition, normal, directionToCamera, surface, samples);
+            for (int i = 0; i < block.count; i++) {
+                addIfVisible(blockIdx * lightBlockLanes + i, 1);
+            }
+        };
+        for (std::uint32_t blockIdx : m_lightGrid->globalBlocks()) {
+            shadeBlock(blockIdx);
+        }
+        for (std::uint32_t blockIdx : m_lightGrid->cellBlocks(intersectionPosition)) {
+            shadeBlock(blockIdx);
+        }
     }
 
-    RGBA returnValue = toRGBA(totalIllumination);
-    return returnValue;
+    return SceneColor(totalIllumination, 1);
 }
 
@@ -6,6 +6,12 @@
 #include "utils/scenedata.h"
 #include "lights/light.h"
 #include "raytracescene.h"
+#include "tile.h"
+#include "tilescheduler.h"
+#include "stats/pixelcost.h"
+#include "stats/progress.h"
+#include "phongkernel.h"
+#include "lightresampling.h"
 
 using namespace glm;
 
@@ -26,34 +32,99 @@ public:
         bool enableSuperSample   = false;
         bool enableAcceleration  = false;
         bool enableDepthOfField  = false;
+        bool enableDeferredShading = false; // intersect a whole tile first, then shade its hits grouped by material
+        int threadCount          = 0; // worker threads used when enableParallelism is set; 0 uses every core
+        int lightSamples         = 0; // point and spot lights sampled per hit through the light tree; 0 shades them all
+        int maxDepth             = 4; // reflection bounces per camera ray
+        float minThroughput      = 0.001f; // no reflection ray is spawned where the path throughput falls below this
+        int rouletteDepth        = 0; // from this bounce on, paths survive with probability equal to their throughput; 0 turns it off
+        int lightCandidates      = 0; // light tree candidates per pixel resampled into one shadow ray (with deferred
+                                      // shading); 0 turns resampling off
+        CostMetric costMetric    = CostMetric::COST_NONE; // what renderTile records into costData
+
+        bool operator==(const Config &) const = default;
     };
 
 public:
     RayTracer(Config config);
 
     // Renders the scene synchronously.
-    // The ray-tracer will render the scene and fill imageData in-place.
+    // The ray-tracer will render the scene and fill imageData in-place with unclamped linear (HDR) colors.
     // @param imageData The pointer to the imageData to be filled.
     // @param scene The scene to be rendered.
-    void render(RGBA *imageData, const RayTraceScene &scene);
+    void render(SceneColor *imageData, const RayTraceScene &scene);
+
+    // Renders only the pixels of the canvas covered by tile.
+    // @param tileData Pointer to the tile's top-left pixel.
+    // @param rowStride The number of pixels between consecutive rows of tileData.
+    // @param tile The region of the canvas to render.
+    // @param scene The scene to be rendered.
+    // @param costData If not null, receives the cost of every pixel (see Config::costMetric), laid out like tileData.
+    void renderTile(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene,
+                    float *costData = nullptr);
+
+    const Config &getConfig() const;
+
+    // Scheduling statistics of the last parallel render, or nullptr if no parallel render has run yet
+    const TileScheduleStats *lastScheduleStats() const;
+
+    // Reports finished tiles to progress during render() and renderTile(); nullptr turns reporting off. Each call
+    // first runs a cheap cost pre-pass over its tiles, so the ETA follows where the expensive pixels are.
+    void setProgress(RenderProgress *progress);
+
+    // Keeps the light reservoirs of each render() in history and reuses those of the previous render, for the frames of
+    // a sequence (see Config::lightCandidates); nullptr turns temporal reuse off.
+    void setReservoirHistory(ReservoirHistory *history);
 
 private:
+    friend class RayTracerBenchAccess; // lets the microbenchmarks time the private shading kernels
+
     const Config m_config;
-    std::vector<std::shared_ptr<Primitive>> m_primitives{};
-    SceneGlobalData m_globalData;
-    int m_maxRecursionDepth = 4;
+    const std::vector<std::shared_ptr<Primitive>> *m_primitives = nullptr;
+    const MaterialTable *m_materials = nullptr;
+    const BVH *m_bvh = nullptr;
+    const LightTable *m_lightTable = nullptr;
+    const LightGrid *m_lightGrid = nullptr;
+    const LightTree *m_lightTree = nullptr;
+    int m_tileSize = 32; // side length of the tiles rendered in parallel
+    int m_costSampleStep = 8; // the progress pre-pass traces one pixel out of every step x step block
+    std::unique_ptr<TileScheduler> m_scheduler; // created by the first parallel render
+    RenderProgress *m_progress = nullptr;
+    ReservoirHistory *m_reservoirHistory = nullptr;
+    int m_spatialReuseSamples = 4;    // neighbors merged into each pixel's reservoir
+    int m_spatialReuseRadius = 10;    // in pixels
+    int m_spatialReuseBlock = 32;     // side of the canvas-aligned blocks spatial reuse stays in; matches m_tileSize
+    int m_temporalReuseLimit = 20;    // the previous frame counts for at most this many times the pixel's candidates
+
+    // A camera ray hit recorded by the geometry pass of deferred shading
+    struct DeferredHit {
+        std::uint32_t material;   // hits are shaded grouped by material, then by primitive, which also groups hits on the same texture
+        std::uint32_t pixel;      // row-major index within the tile
+        HitRecord hit;
+    };
 
     // helpers (see raytracer.cpp for documentation)
+    void bindScene(const RayTraceScene &scene);
+    TileScheduler &scheduler();
+    void traceTile(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene, float *costData);
+    void traceTileDeferred(SceneColor *tileData, int rowStride, const Tile &tile, const RayTraceScene &scene, float *costData);
+    bool deferredShading() const;
+    void resampleLights(const Tile &tile, const std::vector<DeferredHit> &hits, const RayTraceScene &scene,
+                        std::vector<LightResampling::Reservoir> &reservoirs);
+    std::vector<double> estimateTileCosts(const std::vector<Tile> &tiles, const RayTraceScene &scene);
+    Ray cameraRay(int row, int col, const Camera &camera, const RayTraceScene &scene);
     vec3 getViewPlaneCoords(int row, int col, float k, const RayTraceScene &scene);
-    RGBA traceRay(Ray &worldSpaceRay, std::vector<std::shared_ptr<Primitive>> &primitives, const std::vector<Light> &lights, int currRecursionDepth);
-    RGBA phong(glm::vec3  position,
-               glm::vec3  normal,
-               glm::vec3  directionToCamera,
-               SceneMaterial  material,
-               SceneColor textureColor, // color of texture img at the intersection position
-               const std::vector<Light>& lights,
-               SceneGlobalData globalData,
-               int currRecursionDepth);
+    SceneColor traceRay(Ray &worldSpaceRay, const std::vector<std::shared_ptr<Primitive>> &primitives);
+    HitRecord findClosestHit(Ray &worldSpaceRay, const std::vector<std::shared_ptr<Primitive>> &primitives);
+    bool occluded(Ray &shadowRay, std::uint32_t lightSlot);
+    SceneColor shadeHit(const Ray &worldSpaceRay, const HitRecord &hit, const LightResampling::Reservoir *reservoir = nullptr);
+    SceneColor phong(const glm::vec3 &position,
+                     glm::vec3  normal,
+                     glm::vec3  directionToCamera,
+                     const ShadingMaterial &material,
+                     const SceneColor &textureColor, // color of texture img at the intersection position
+                     int depth,
+                     const LightResampling::Reservoir *reservoir = nullptr);
     
 };
 
@@ -3,17 +3,20 @@
 #include "src/utils/scenedata.h"
 #include "lights/light.h"
 #include "texture/texture.h"
+#include "stats/raystats.h"
 
 
-RayTraceScene::RayTraceScene(int width, int height, const RenderData &metaData) {
+RayTraceScene::RayTraceScene(int width, int height, const RenderData &metaData, float lightCutoff) {
     m_camera = Camera(metaData.cameraData, width, height);
     m_imgHeight = height;
     m_imgWidth = width;
     m_renderData = metaData;
+    m_materials = MaterialTable(metaData.globalData);
     // populate lights
     for (SceneLightData lightData : metaData.lights) {
         m_lights.push_back(Light(lightData));
     }
+    m_lightCutoff = lightCutoff;
     
     // build unique textures
     for (auto& shapeData : metaData.shapes) {
@@ -21,8 +24,9 @@ RayTraceScene::RayTraceScene(int width, int height, const RenderData &metaData)
         std::string currTextureFilename = textureMap.filename;
         // check if texture with the current filename has already been loaded
         if (textureMap.isUsed && m_textureDictionary.find(currTextureFilename) == m_textureDictionary.end()) {
-            // load texture if the file hasn't been loaded before
-            m_textureDictionary[currTextureFilename] = Texture(currTextureFilename);
+            // load texture if the file hasn't been loaded before. Decoding happens in the background while the
+            // rest of the scene is built; sampling a texture waits for it to be resident.
+            m_textureDictionary[currTextureFilename] = Texture::loadAsync(currTextureFilename);
         }
         
     }
@@ -31,19 +35,38 @@ RayTraceScene::RayTraceScene(int width, int height, const RenderData &metaData)
     for (auto& shapeData : metaData.shapes) {
         switch (shapeData.primitive.type) {
             case PrimitiveType::PRIMITIVE_SPHERE:
-                m_primitiveList.push_back(std::make_shared<Sphere>(shapeData, m_textureDictionary, 0.5));
+                m_primitiveList.push_back(std::make_shared<Sphere>(shapeData, m_textureDictionary, m_materials, 0.5));
                 break;
             case PrimitiveType::PRIMITIVE_CONE:
-                m_primitiveList.push_back(std::make_shared<Cone>(shapeData, m_textureDictionary, 0.5, 1));
+                m_primitiveList.push_back(std::make_shared<Cone>(shapeData, m_textureDictionary, m_materials, 0.5, 1));
                 break;
             case PrimitiveType::PRIMITIVE_CUBE:
-                m_primitiveList.push_back(std::make_shared<Cube>(shapeData, m_textureDictionary, 1));
+                m_primitiveList.push_back(std::make_shared<Cube>(shapeData, m_textureDictionary, m_materials, 1));
                 break;
             case PrimitiveType::PRIMITIVE_CYLINDER:
-                m_primitiveList.push_back(std::make_shared<Cylinder>(shapeData, m_textureDictionary, 1, 0.5));
+                m_primitiveList.push_back(std::make_shared<Cylinder>(shapeData, m_textureDictionary, m_materials, 1, 0.5));
                 break;
         }
     }
+
+    // build the acceleration structure while textures are still decoding
+    RayStats::PhaseTimer buildTimer(RenderPhase::PHASE_ACCELERATION_BUILD);
+    m_bvh = BVH(m_primitiveList);
+
+    for (const std::shared_ptr<Primitive> &primitive : m_primitiveList) {
+        m_sceneBounds.expand(primitive->getWorldSpaceBounds());
+    }
+    buildLights();
+}
+
+/**
+ * @brief RayTraceScene::buildLights compiles m_lights for shading with m_lightCutoff, binning them over the part of
+ *          space that gets shaded
+ */
+void RayTraceScene::buildLights() {
+    m_lightTable = LightTable(m_lights, m_lightCutoff);
+    m_lightTree = LightTree(m_lightTable);
+    m_lightGrid = LightGrid(m_lightTable, m_sceneBounds);
 }
 
 
@@ -68,9 +91,50 @@ const RenderData& RayTraceScene::getRenderData() const {
     return m_renderData;
 }
 
-std::vector<std::shared_ptr<Primitive>> RayTraceScene::getPrimitives() const {
+void RayTraceScene::setCamera(const SceneCameraData &cameraData) {
+    m_camera = Camera(cameraData, m_imgWidth, m_imgHeight);
+    m_renderData.cameraData = cameraData;
+}
+
+void RayTraceScene::setLightCutoff(float lightCutoff) {
+    if (lightCutoff != m_lightCutoff) {
+        m_lightCutoff = lightCutoff;
+        buildLights();
+    }
+}
+
+const std::vector<std::shared_ptr<Primitive>>& RayTraceScene::getPrimitives() const {
     return m_primitiveList;
 }
-std::vector<Light> RayTraceScene::getLights() const {
+const std::vector<Light>& RayTraceScene::getLights() const {
     return m_lights;
 }
+
+const BVH& RayTraceScene::getBVH() const {
+    return m_bvh;
+}
+
+const MaterialTable& RayTraceScene::getMaterials() const {
+    return m_materials;
+}
+
+const LightTable& RayTraceScene::getLightTable() const {
+    return m_lightTable;
+}
+
+const LightGrid& RayTraceScene::getLightGrid() const {
+    return m_lightGrid;
+}
+
+const LightTree& RayTraceScene::getLightTree() const {
+    return m_lightTree;
+}
+
+void RayTraceScene::waitForTextures() const {
+    // the decoders time themselves into the texture load phase
+    for (const auto &[filename, texture] : m_textureDictionary) {
+        if (texture) {
+            texture->waitUntilResident();
+        }
+    }
+}
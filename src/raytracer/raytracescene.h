@@ -6,6 +6,10 @@
 #include <glm/glm.hpp>
 #include "primitives/primitive.h"
 #include "camera/camera.h"
+#include "accel/bvh.h"
+#include "lights/lightgrid.h"
+#include "lights/lighttable.h"
+#include "lights/lighttree.h"
 
 class Camera;
 class Light;
@@ -15,7 +19,9 @@ class Light;
 class RayTraceScene
 {
 public:
-    RayTraceScene(int width, int height, const RenderData &metaData);
+    // lightCutoff: lights are not shaded where their contribution falls below it (see Light::influenceRadius); 0 shades
+    // every light everywhere
+    RayTraceScene(int width, int height, const RenderData &metaData, float lightCutoff = 0);
 
     // The getter of the width of the scene
     const int& width() const;
@@ -31,8 +37,21 @@ public:
 
     const RenderData& getRenderData() const;
 
-    std::vector<std::shared_ptr<Primitive>> getPrimitives() const;
-    std::vector<Light> getLights() const;
+    // Moves the camera without reloading primitives or textures (e.g. between frames of a sequence)
+    void setCamera(const SceneCameraData &cameraData);
+    // Rebuilds the light table, grid and tree for another light cutoff (see the constructor), if it differs
+    void setLightCutoff(float lightCutoff);
+
+    const std::vector<std::shared_ptr<Primitive>>& getPrimitives() const;
+    const std::vector<Light>& getLights() const;
+    const BVH& getBVH() const;
+    const MaterialTable& getMaterials() const;
+    const LightTable& getLightTable() const;
+    const LightGrid& getLightGrid() const;
+    const LightTree& getLightTree() const;
+
+    // Blocks until every texture of the scene has been decoded (textures otherwise load in the background)
+    void waitForTextures() const;
 
     
 
@@ -43,7 +62,16 @@ private:
     Camera m_camera;
     std::vector<std::shared_ptr<Primitive>> m_primitiveList{};
     std::vector<Light> m_lights{};
+    float m_lightCutoff;
+    AABB m_sceneBounds{};    // of every primitive: the part of space that gets shaded
+    LightTable m_lightTable; // m_lights compiled for shading
+    LightGrid m_lightGrid;   // the blocks of m_lightTable that may reach each part of the scene
+    LightTree m_lightTree;   // the point and spot lights of m_lightTable, for sampling lights
+    MaterialTable m_materials; // the distinct materials of m_primitiveList
+    BVH m_bvh;
+
+    void buildLights();
 
-    std::map<std::string, Texture> m_textureDictionary{};
+    std::map<std::string, std::shared_ptr<Texture>> m_textureDictionary{};
 
 };
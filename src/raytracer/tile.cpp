@@ -0,0 +1,37 @@
+#include "tile.h"
+#include <algorithm>
+
+/**
+ * @brief splitIntoTiles partitions the canvas into a grid of tiles. Tiles on the right and bottom edges are clipped to the canvas.
+ * @param canvasWidth
+ * @param canvasHeight
+ * @param tileSize side length of a full tile in pixels. Values < 1 produce a single tile covering the whole canvas.
+ * @return tiles in row-major order; each tile's index is its position in the returned list.
+ */
+std::vector<Tile> splitIntoTiles(int canvasWidth, int canvasHeight, int tileSize) {
+    return splitIntoTiles(Tile{0, 0, 0, canvasWidth, canvasHeight}, tileSize);
+}
+
+/**
+ * @brief splitIntoTiles partitions a region of the canvas into a grid of tiles whose top-left corners are offset from the region's by multiples of tileSize
+ */
+std::vector<Tile> splitIntoTiles(const Tile &region, int tileSize) {
+    std::vector<Tile> tiles{};
+    if (region.width <= 0 || region.height <= 0) {
+        return tiles;
+    }
+    if (tileSize < 1) {
+        tiles.push_back(Tile{0, region.x, region.y, region.width, region.height});
+        return tiles;
+    }
+
+    int right = region.x + region.width;
+    int bottom = region.y + region.height;
+    for (int y = region.y; y < bottom; y += tileSize) {
+        for (int x = region.x; x < right; x += tileSize) {
+            int index = tiles.size();
+            tiles.push_back(Tile{index, x, y, std::min(tileSize, right - x), std::min(tileSize, bottom - y)});
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+// A rectangular block of canvas pixels. Coordinates are in canvas pixels where (0,0) is the top-left pixel.
+struct Tile {
+    int index;  // position of this tile in the list returned by splitIntoTiles
+    int x;      // left-most column
+    int y;      // top-most row
+    int width;
+    int height;
+};
+
+// Splits a canvas into tiles of (at most) tileSize x tileSize pixels in row-major order.
+// The result depends only on the arguments, so every process splitting the same canvas gets the same tiles.
+std::vector<Tile> splitIntoTiles(int canvasWidth, int canvasHeight, int tileSize);
+
+// Same as above, but splits only the given region of the canvas. Tiles keep canvas coordinates.
+std::vector<Tile> splitIntoTiles(const Tile &region, int tileSize);
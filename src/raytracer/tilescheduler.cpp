@@ -0,0 +1,123 @@
+#include "tilescheduler.h"
+
+#include <chrono>
+#include <QFuture>
+#include <QtConcurrent>
+#include "stats/perfcounters.h"
+#include "stats/tracing.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::int64_t nanosecondsSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+}
+
+TileScheduler::TileScheduler(int threadCount) :
+    m_threadCount(std::max(1, threadCount))
+{
+    m_pool.setMaxThreadCount(m_threadCount);
+    for (int worker = 0; worker < m_threadCount; worker++) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+}
+
+int TileScheduler::threadCount() const {
+    return m_threadCount;
+}
+
+const TileScheduleStats &TileScheduler::stats() const {
+    return m_stats;
+}
+
+void TileScheduler::run(const std::vector<Tile> &tiles, const std::function<void(const Tile &)> &renderTile) {
+    Clock::time_point start = Clock::now();
+    m_stats.workers.assign(m_threadCount, TileWorkerStats{});
+
+    // hand every worker a contiguous run of tiles
+    for (int worker = 0; worker < m_threadCount; worker++) {
+        std::size_t first = tiles.size() * worker / m_threadCount;
+        std::size_t last = tiles.size() * (worker + 1) / m_threadCount;
+        m_queues[worker]->tiles.clear();
+        for (std::size_t i = first; i < last; i++) {
+            m_queues[worker]->tiles.push_back(int(i));
+        }
+    }
+
+    std::vector<QFuture<void>> workers{};
+    for (int worker = 0; worker < m_threadCount; worker++) {
+        workers.push_back(QtConcurrent::run(&m_pool, [this, worker, &tiles, &renderTile]() {
+            work(worker, tiles, renderTile);
+        }));
+    }
+    for (QFuture<void> &worker : workers) {
+        worker.waitForFinished();
+    }
+    m_stats.wallNs = nanosecondsSince(start);
+}
+
+/**
+ * @brief TileScheduler::work renders tiles from the worker's own queue, then steals until every queue is empty
+ */
+void TileScheduler::work(int worker, const std::vector<Tile> &tiles, const std::function<void(const Tile &)> &renderTile) {
+    TileWorkerStats &stats = m_stats.workers[worker];
+    if (Trace::recording()) {
+        Trace::setThreadName("tile worker " + std::to_string(worker));
+    }
+    int tileIdx;
+    while (true) {
+        bool stolen = false;
+        if (!popOwn(worker, tileIdx)) {
+            if (!steal(worker, tileIdx)) {
+                break;
+            }
+            stolen = true;
+        }
+        // stolen tiles are named apart so that the trace shows where work moved between threads
+        Trace::Span span(stolen ? "stolen tile" : "tile", "tile", tiles[tileIdx].index);
+        PerfCounters::Scope perf(PerfStage::STAGE_RENDER);
+        Clock::time_point start = Clock::now();
+        renderTile(tiles[tileIdx]);
+        stats.busyNs += nanosecondsSince(start);
+        stats.tiles++;
+    }
+}
+
+bool TileScheduler::popOwn(int worker, int &tileIdx) {
+    WorkerQueue &queue = *m_queues[worker];
+    Clock::time_point start = Clock::now();
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    m_stats.workers[worker].lockWaitNs += nanosecondsSince(start);
+    if (queue.tiles.empty()) {
+        return false;
+    }
+    tileIdx = queue.tiles.front();
+    queue.tiles.pop_front();
+    return true;
+}
+
+/**
+ * @brief TileScheduler::steal takes the last tile of the first non-empty queue after the worker's own. Tiles are never
+ *          added once run() has started, so finding every queue empty means all work has been handed out.
+ */
+bool TileScheduler::steal(int worker, int &tileIdx) {
+    TileWorkerStats &stats = m_stats.workers[worker];
+    for (int offset = 1; offset < m_threadCount; offset++) {
+        WorkerQueue &victim = *m_queues[(worker + offset) % m_threadCount];
+        Clock::time_point start = Clock::now();
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        stats.lockWaitNs += nanosecondsSince(start);
+        if (victim.tiles.empty()) {
+            stats.failedSteals++;
+            continue;
+        }
+        tileIdx = victim.tiles.back();
+        victim.tiles.pop_back();
+        stats.steals++;
+        return true;
+    }
+    return false;
+}
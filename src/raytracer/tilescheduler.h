@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QThreadPool>
+#include "tile.h"
+
+// What one worker thread did during TileScheduler::run. Aligned to a cache line so that workers updating their own
+// stats don't slow each other down through false sharing.
+struct alignas(64) TileWorkerStats {
+    std::int64_t busyNs = 0;     // time spent rendering tiles
+    std::int64_t lockWaitNs = 0; // time spent waiting for queue locks held by other workers
+    int tiles = 0;               // tiles rendered
+    int steals = 0;              // tiles taken from another worker's queue
+    int failedSteals = 0;        // other queues found empty while looking for work
+};
+
+struct TileScheduleStats {
+    std::int64_t wallNs = 0;     // from the start of run() until the last tile finished
+    std::vector<TileWorkerStats> workers{};
+};
+
+// Renders tiles on a fixed number of worker threads with work stealing. Every worker owns a queue pre-filled with a
+// contiguous share of the tiles (so neighboring pixels stay on one core) and takes tiles from its front. A worker whose
+// queue runs dry steals from the back of another worker's queue, so expensive regions (e.g. a mirror in one corner)
+// don't leave the other cores idle.
+class TileScheduler {
+public:
+    explicit TileScheduler(int threadCount);
+
+    // Calls renderTile once for every tile, from the worker threads, and returns once all tiles are done
+    void run(const std::vector<Tile> &tiles, const std::function<void(const Tile &)> &renderTile);
+
+    int threadCount() const;
+
+    // Statistics of the last call to run()
+    const TileScheduleStats &stats() const;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<int> tiles{}; // indices into the tiles passed to run()
+    };
+
+    void work(int worker, const std::vector<Tile> &tiles, const std::function<void(const Tile &)> &renderTile);
+    bool popOwn(int worker, int &tileIdx);
+    bool steal(int worker, int &tileIdx);
+
+    int m_threadCount;
+    QThreadPool m_pool;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues{};
+    TileScheduleStats m_stats{};
+};
@@ -0,0 +1,229 @@
+#include "sequence.h"
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <QFileInfo>
+#include <QFuture>
+#include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "output/imageoutput.h"
+
+namespace {
+
+// Camera placement at a given frame of a camera path
+struct CameraKeyframe {
+    int frame;
+    glm::vec3 pos;
+    glm::vec3 focus; // point the camera looks at
+    glm::vec3 up;
+    float heightAngle; // in RADIANS
+};
+
+/**
+ * @brief readVec3 parses a comma-separated triple such as "pos = 1, 2, 3"
+ * @return true if the key exists and holds three numbers
+ */
+bool readVec3(const QSettings &settings, const QString &key, glm::vec3 &out) {
+    QStringList components = settings.value(key).toStringList();
+    if (components.size() != 3) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        bool ok;
+        out[i] = components[i].trimmed().toFloat(&ok);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief readCamera overwrites the fields of camera that are present in the given settings group. The look direction may
+ *          be given either directly ("look") or as a point to look at ("focus").
+ */
+void readCamera(const QSettings &settings, const QString &group, SceneCameraData &camera) {
+    glm::vec3 value;
+    if (readVec3(settings, group + "pos", value)) {
+        camera.pos = glm::vec4(value, 1);
+    }
+    if (readVec3(settings, group + "look", value)) {
+        camera.look = glm::vec4(value, 0);
+    } else if (readVec3(settings, group + "focus", value)) {
+        camera.look = glm::vec4(value - glm::vec3(camera.pos), 0);
+    }
+    if (readVec3(settings, group + "up", value)) {
+        camera.up = glm::vec4(value, 0);
+    }
+    if (settings.contains(group + "heightangle")) {
+        camera.heightAngle = glm::radians(settings.value(group + "heightangle").toFloat());
+    }
+}
+
+/**
+ * @brief catmullRom evaluates a uniform Catmull-Rom spline segment between p1 and p2 at parameter s in [0,1]
+ */
+glm::vec3 catmullRom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float s) {
+    float s2 = s*s;
+    float s3 = s2*s;
+    return 0.5f * ((2.f*p1) + (-p0 + p2)*s + (2.f*p0 - 5.f*p1 + 4.f*p2 - p3)*s2 + (-p0 + 3.f*p1 - 3.f*p2 + p3)*s3);
+}
+
+/**
+ * @brief interpolateCamera computes the camera at the given frame of a camera path. Positions and focus points follow
+ *          a Catmull-Rom spline through the keyframes so that paths with a few keyframes (e.g. a turntable) stay smooth.
+ *          Frames before the first or after the last keyframe hold that keyframe.
+ * @param keyframes sorted by frame, non-empty
+ */
+SceneCameraData interpolateCamera(const std::vector<CameraKeyframe> &keyframes, int frame, SceneCameraData camera) {
+    int next = 0;
+    while (next < int(keyframes.size()) && keyframes[next].frame <= frame) {
+        next++;
+    }
+    int curr = std::max(next - 1, 0);
+    next = std::min(next, int(keyframes.size()) - 1);
+    const CameraKeyframe &k1 = keyframes[curr];
+    const CameraKeyframe &k2 = keyframes[next];
+    const CameraKeyframe &k0 = keyframes[std::max(curr - 1, 0)];
+    const CameraKeyframe &k3 = keyframes[std::min(next + 1, int(keyframes.size()) - 1)];
+
+    float s = (k2.frame == k1.frame) ? 0.f : std::clamp(float(frame - k1.frame) / (k2.frame - k1.frame), 0.f, 1.f);
+    glm::vec3 pos = catmullRom(k0.pos, k1.pos, k2.pos, k3.pos, s);
+    glm::vec3 focus = catmullRom(k0.focus, k1.focus, k2.focus, k3.focus, s);
+
+    camera.pos = glm::vec4(pos, 1);
+    camera.look = glm::vec4(focus - pos, 0);
+    camera.up = glm::vec4(glm::normalize(glm::mix(k1.up, k2.up, s)), 0);
+    camera.heightAngle = glm::mix(k1.heightAngle, k2.heightAngle, s);
+    return camera;
+}
+
+}
+
+std::vector<SequenceFrame> loadSequenceFrames(const QString &configPath, const RenderSettings &settings, const SceneCameraData &sceneCamera) {
+    QSettings sequenceSettings( configPath, QSettings::IniFormat );
+    std::vector<SequenceFrame> frames{};
+
+    // "%1" in the output path is replaced by the frame number; without it, the number is appended to the file name so
+    // that frames don't overwrite each other
+    QString outputPattern = sequenceSettings.value("Sequence/output", settings.outputPath).toString();
+    if (!outputPattern.contains("%1")) {
+        QFileInfo outputInfo(outputPattern);
+        QString suffix = outputInfo.suffix();
+        outputPattern = outputInfo.path() + "/" + outputInfo.completeBaseName() + "_%1" + (suffix.isEmpty() ? "" : "." + suffix);
+    }
+    auto outputPathOf = [&outputPattern](int frameNumber) {
+        return outputPattern.arg(frameNumber, 4, 10, QChar('0'));
+    };
+
+    // 1) one frame per override config file; values missing from an override are taken from the base config
+    QStringList overrides = sequenceSettings.value("Sequence/overrides").toStringList();
+    if (!overrides.isEmpty()) {
+        QString baseDir = QFileInfo(configPath).absolutePath();
+        for (int i = 0; i < overrides.size(); i++) {
+            QString overridePath = overrides[i].trimmed();
+            if (QFileInfo(overridePath).isRelative()) {
+                overridePath = baseDir + "/" + overridePath;
+            }
+            if (!QFileInfo::exists(overridePath)) {
+                std::cerr << "Error: sequence override \"" << overridePath.toStdString() << "\" does not exist" << std::endl;
+                return {};
+            }
+            QSettings overrideSettings( overridePath, QSettings::IniFormat );
+
+            SequenceFrame frame{i, outputPathOf(i), sceneCamera, settings.rtConfig, settings.lightCutoff};
+            frame.outputPath = overrideSettings.value("IO/output", frame.outputPath).toString();
+            readCamera(overrideSettings, "Camera/", frame.camera);
+            readFeatureSettings(overrideSettings, frame.rtConfig, frame.lightCutoff);
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    // 2) camera path
+    std::vector<CameraKeyframe> keyframes{};
+    int keyframeCount = sequenceSettings.beginReadArray("Sequence/keyframes");
+    for (int i = 0; i < keyframeCount; i++) {
+        sequenceSettings.setArrayIndex(i);
+        SceneCameraData camera = sceneCamera;
+        readCamera(sequenceSettings, "", camera);
+        keyframes.push_back(CameraKeyframe{
+            sequenceSettings.value("frame", i).toInt(),
+            glm::vec3(camera.pos),
+            glm::vec3(camera.pos) + glm::vec3(camera.look),
+            glm::vec3(camera.up),
+            camera.heightAngle
+        });
+    }
+    sequenceSettings.endArray();
+    if (keyframes.empty()) {
+        std::cerr << "Error: [Sequence] needs either keyframes or overrides" << std::endl;
+        return {};
+    }
+    std::stable_sort(keyframes.begin(), keyframes.end(), [](const CameraKeyframe &a, const CameraKeyframe &b) {
+        return a.frame < b.frame;
+    });
+
+    int frameCount = sequenceSettings.value("Sequence/frames", keyframes.back().frame + 1).toInt();
+    for (int i = 0; i < frameCount; i++) {
+        frames.push_back(SequenceFrame{i, outputPathOf(i), interpolateCamera(keyframes, i, sceneCamera), settings.rtConfig,
+                                       settings.lightCutoff});
+    }
+    return frames;
+}
+
+bool renderSequence(const std::vector<SequenceFrame> &frames, RayTraceScene &scene, const ImageWriterOptions &imageOptions,
+                    RenderProgress *progress) {
+    // a single I/O thread saves finished frames while the raytracer's tile scheduler renders the next one
+    QThreadPool ioPool;
+    ioPool.setMaxThreadCount(1);
+    std::deque<QFuture<bool>> pendingSaves{};
+    const std::size_t maxPendingSaves = 2; // bounds the number of finished frames held in memory
+    bool success = true;
+
+    auto waitForOldestSave = [&pendingSaves, &success]() {
+        success &= pendingSaves.front().result();
+        pendingSaves.pop_front();
+    };
+
+    // light reservoirs carried from frame to frame (only used when lights are resampled)
+    ReservoirHistory reservoirHistory;
+
+    // kept across frames so that its worker threads are only started again when a frame changes the config
+    std::unique_ptr<RayTracer> raytracer;
+
+    for (const SequenceFrame &frame : frames) {
+        scene.setCamera(frame.camera);
+        scene.setLightCutoff(frame.lightCutoff);
+
+        auto framebuffer = std::make_shared<Framebuffer>(std::size_t(scene.width()) * scene.height(), SceneColor(0, 0, 0, 1));
+
+        if (!raytracer || raytracer->getConfig() != frame.rtConfig) {
+            raytracer = std::make_unique<RayTracer>(frame.rtConfig);
+            raytracer->setProgress(progress);
+            raytracer->setReservoirHistory(&reservoirHistory);
+        }
+        raytracer->render(framebuffer->data(), scene);
+
+        while (pendingSaves.size() >= maxPendingSaves) {
+            waitForOldestSave();
+        }
+        QString outputPath = frame.outputPath;
+        pendingSaves.push_back(QtConcurrent::run(&ioPool, [framebuffer, outputPath, &imageOptions, width = scene.width(), height = scene.height()]() {
+            bool saved = saveFramebuffer(framebuffer->data(), width, height, outputPath, imageOptions);
+            if (saved) {
+                std::cout << "Saved rendered image to \"" << outputPath.toStdString() << "\"" << std::endl;
+            } else {
+                std::cerr << "Error: failed to save image to \"" << outputPath.toStdString() << "\"" << std::endl;
+            }
+            return saved;
+        }));
+    }
+
+    while (!pendingSaves.empty()) {
+        waitForOldestSave();
+    }
+    return success;
+}
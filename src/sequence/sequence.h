@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QString>
+#include <vector>
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "utils/rendersettings.h"
+
+// One frame of a sequence render
+struct SequenceFrame {
+    int number;
+    QString outputPath;
+    SceneCameraData camera;
+    RayTracer::Config rtConfig;
+    float lightCutoff;
+};
+
+// Builds the frames described by the [Sequence] section of the config file. Frames come either from a camera path
+// (keyframes interpolated over `frames` frames) or from a list of override config files (one frame per file).
+// @param configPath path of the base config file
+// @param settings settings read from the base config file
+// @param sceneCamera camera of the loaded scene, used wherever neither a keyframe nor an override specifies a value
+// @return the frames in rendering order; empty if the [Sequence] section is missing or invalid
+std::vector<SequenceFrame> loadSequenceFrames(const QString &configPath, const RenderSettings &settings, const SceneCameraData &sceneCamera);
+
+// Renders the frames back to back, reusing the already loaded scene (primitives and textures) for every frame.
+// Each finished frame is encoded and saved on a separate I/O thread while the next one renders.
+// @param imageOptions tone mapping and encoder settings shared by all frames
+// @param progress if not null, receives the finished tiles of every frame
+// @return true if every frame was saved
+bool renderSequence(const std::vector<SequenceFrame> &frames, RayTraceScene &scene, const ImageWriterOptions &imageOptions,
+                    RenderProgress *progress = nullptr);
@@ -0,0 +1,202 @@
+#include "memstats.h"
+
+#include <QJsonArray>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+namespace {
+
+const char *categoryNames[memoryCategoryCount] = {"sceneGraph", "renderShapes", "primitives", "textures",
+                                                  "acceleration", "framebuffers"};
+
+std::atomic<std::int64_t> currentBytes[memoryCategoryCount] = {};
+std::atomic<std::int64_t> peakBytes[memoryCategoryCount] = {};
+std::atomic<std::int64_t> phasePeakBytes[memoryCategoryCount] = {};
+std::atomic<std::int64_t> totalBytes{0};
+std::atomic<std::int64_t> totalPeakBytes{0};
+std::atomic<std::int64_t> totalPhasePeakBytes{0};
+std::atomic<std::int64_t> capBytes{0};
+
+struct PhaseRecord {
+    std::string phase{};
+    std::int64_t current[memoryCategoryCount] = {};
+    std::int64_t peak[memoryCategoryCount] = {};   // highest value during the phase
+    std::int64_t total = 0;
+    std::int64_t totalPeak = 0;
+};
+
+std::mutex phaseMutex;
+std::vector<PhaseRecord> phases{};
+
+void raiseTo(std::atomic<std::int64_t> &peak, std::int64_t value) {
+    std::int64_t previous = peak.load(std::memory_order_relaxed);
+    while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {}
+}
+
+double toMB(std::int64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Resident set size and its high-water mark from /proc (Linux), in bytes; -1 where unavailable
+void readResidentBytes(std::int64_t &rss, std::int64_t &peakRss) {
+    rss = peakRss = -1;
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while (status >> key) {
+        std::int64_t kb;
+        if (key == "VmRSS:" && status >> kb) {
+            rss = kb * 1024;
+        } else if (key == "VmHWM:" && status >> kb) {
+            peakRss = kb * 1024;
+        }
+    }
+}
+
+/**
+ * @brief reportCapExceeded runs on the thread whose allocation crossed the cap. Only the first thread to get here
+ *          prints; the process then exits without unwinding, because other threads may still be rendering.
+ */
+[[noreturn]] void reportCapExceeded(MemoryCategory category, std::size_t bytes, std::int64_t total) {
+    static std::mutex reportMutex;
+    std::lock_guard<std::mutex> lock(reportMutex);
+    std::cout.flush();
+    std::cerr << std::fixed << std::setprecision(1)
+              << "Error: memory cap of " << toMB(capBytes.load()) << " MB exceeded: allocating " << toMB(bytes)
+              << " MB for " << categoryNames[int(category)] << " would bring the tracked total to " << toMB(total)
+              << " MB" << std::endl;
+    for (int i = 0; i < memoryCategoryCount; i++) {
+        std::cerr << "  " << std::left << std::setw(14) << categoryNames[i] << std::right << std::setw(10)
+                  << toMB(currentBytes[i].load()) << " MB" << std::endl;
+    }
+    std::cerr << "Lower the resolution, use streaming output, or raise --memory-cap" << std::endl;
+    std::_Exit(EXIT_FAILURE);
+}
+
+}
+
+namespace MemoryStats {
+
+void allocate(MemoryCategory category, std::size_t bytes) {
+    std::int64_t total = totalBytes.fetch_add(std::int64_t(bytes), std::memory_order_relaxed) + std::int64_t(bytes);
+    std::int64_t cap = capBytes.load(std::memory_order_relaxed);
+    if (cap > 0 && total > cap) {
+        reportCapExceeded(category, bytes, total);
+    }
+    std::int64_t current = currentBytes[int(category)].fetch_add(std::int64_t(bytes), std::memory_order_relaxed) +
+                           std::int64_t(bytes);
+    raiseTo(peakBytes[int(category)], current);
+    raiseTo(phasePeakBytes[int(category)], current);
+    raiseTo(totalPeakBytes, total);
+    raiseTo(totalPhasePeakBytes, total);
+}
+
+void release(MemoryCategory category, std::size_t bytes) {
+    currentBytes[int(category)].fetch_sub(std::int64_t(bytes), std::memory_order_relaxed);
+    totalBytes.fetch_sub(std::int64_t(bytes), std::memory_order_relaxed);
+}
+
+void setCap(std::size_t bytes) {
+    capBytes.store(std::int64_t(bytes), std::memory_order_relaxed);
+}
+
+void endPhase(const char *phase) {
+    PhaseRecord record{phase};
+    for (int i = 0; i < memoryCategoryCount; i++) {
+        record.current[i] = currentBytes[i].load(std::memory_order_relaxed);
+        record.peak[i] = phasePeakBytes[i].exchange(record.current[i], std::memory_order_relaxed);
+    }
+    record.total = totalBytes.load(std::memory_order_relaxed);
+    record.totalPeak = totalPhasePeakBytes.exchange(record.total, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    phases.push_back(record);
+}
+
+void printSummary(std::ostream &out) {
+    out << "Memory (MB, current/peak):" << std::endl << std::fixed << std::setprecision(1);
+    out << "  " << std::left << std::setw(20) << "phase" << std::right;
+    for (const char *name : categoryNames) {
+        out << std::setw(16) << name;
+    }
+    out << std::setw(16) << "total" << std::endl;
+
+    auto cell = [&out](std::int64_t current, std::int64_t peak) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f/%.2f", toMB(current), toMB(peak));
+        out << std::setw(16) << text;
+    };
+    {
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        for (const PhaseRecord &record : phases) {
+            out << "  " << std::left << std::setw(20) << record.phase << std::right;
+            for (int i = 0; i < memoryCategoryCount; i++) {
+                cell(record.current[i], record.peak[i]);
+            }
+            cell(record.total, record.totalPeak);
+            out << std::endl;
+        }
+    }
+    out << "  " << std::left << std::setw(20) << "overall" << std::right;
+    for (int i = 0; i < memoryCategoryCount; i++) {
+        cell(currentBytes[i].load(), peakBytes[i].load());
+    }
+    cell(totalBytes.load(), totalPeakBytes.load());
+    out << std::endl;
+
+    std::int64_t rss, peakRss;
+    readResidentBytes(rss, peakRss);
+    if (rss >= 0) {
+        out << "  resident set " << toMB(rss) << " MB (peak " << toMB(peakRss) << " MB); the rest is code, Qt, "
+            << "allocator overhead and short-lived buffers" << std::endl;
+    }
+    out << std::defaultfloat;
+}
+
+QJsonObject toJson() {
+    auto categories = [](const std::int64_t *current, const std::int64_t *peak) {
+        QJsonObject json;
+        for (int i = 0; i < memoryCategoryCount; i++) {
+            json.insert(categoryNames[i], QJsonObject{{"current", qint64(current[i])}, {"peak", qint64(peak[i])}});
+        }
+        return json;
+    };
+
+    QJsonArray phaseArray;
+    {
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        for (const PhaseRecord &record : phases) {
+            phaseArray.append(QJsonObject{
+                {"phase", QString::fromStdString(record.phase)},
+                {"categories", categories(record.current, record.peak)},
+                {"total", qint64(record.total)},
+                {"totalPeak", qint64(record.totalPeak)},
+            });
+        }
+    }
+
+    std::int64_t current[memoryCategoryCount];
+    std::int64_t peak[memoryCategoryCount];
+    for (int i = 0; i < memoryCategoryCount; i++) {
+        current[i] = currentBytes[i].load();
+        peak[i] = peakBytes[i].load();
+    }
+    std::int64_t rss, peakRss;
+    readResidentBytes(rss, peakRss);
+    return QJsonObject{
+        {"unit", "bytes"},
+        {"cap", qint64(capBytes.load())},
+        {"categories", categories(current, peak)},
+        {"total", qint64(totalBytes.load())},
+        {"totalPeak", qint64(totalPeakBytes.load())},
+        {"residentBytes", qint64(rss)},
+        {"residentPeakBytes", qint64(peakRss)},
+        {"phases", phaseArray},
+    };
+}
+
+}
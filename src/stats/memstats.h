@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <QJsonObject>
+
+// The main memory consumers of a render
+enum class MemoryCategory {
+    MEM_SCENE_GRAPH,    // nodes, transformations and primitives read by ScenefileReader
+    MEM_RENDER_SHAPES,  // flattened RenderShapeData lists, including the copy each RayTraceScene keeps
+    MEM_PRIMITIVES,     // Primitive objects, the material table they index and the light table
+    MEM_TEXTURES,       // decoded texture pixels (primitives share textures, so each image is counted once)
+    MEM_ACCELERATION,   // BVH nodes and primitive indices
+    MEM_FRAMEBUFFERS    // HDR framebuffers, bands and per-pixel cost buffers
+};
+
+constexpr int memoryCategoryCount = 6;
+
+// Process-wide accounting of the bytes held by each category, with peaks overall and per render phase. An optional
+// cap turns running out of memory into a clear error: the allocation that would cross it ends the process with a
+// breakdown of where the memory went, before the kernel's OOM killer gets involved.
+namespace MemoryStats {
+
+// Accounts bytes to category. Exits the process if this takes the tracked total past the cap.
+void allocate(MemoryCategory category, std::size_t bytes);
+void release(MemoryCategory category, std::size_t bytes);
+
+// 0 disables the cap
+void setCap(std::size_t bytes);
+
+// Records the current and peak bytes of every category under the name of the phase that just ended, then starts
+// tracking the next phase's peak
+void endPhase(const char *phase);
+
+void printSummary(std::ostream &out);
+
+// Totals, peaks and the per-phase records
+QJsonObject toJson();
+
+// Holds bytes accounted to a category for as long as it lives, e.g. next to a buffer whose size is known up front.
+// Copies account the same bytes again.
+class Allocation {
+public:
+    Allocation() = default;
+    Allocation(MemoryCategory category, std::size_t bytes) : m_category(category), m_bytes(bytes) {
+        allocate(m_category, m_bytes);
+    }
+    Allocation(const Allocation &other) : Allocation(other.m_category, other.m_bytes) {}
+    Allocation(Allocation &&other) noexcept : m_category(other.m_category), m_bytes(other.m_bytes) {
+        other.m_bytes = 0;
+    }
+    Allocation &operator=(Allocation other) noexcept {
+        std::swap(m_category, other.m_category);
+        std::swap(m_bytes, other.m_bytes);
+        return *this;
+    }
+    ~Allocation() {
+        if (m_bytes > 0) {
+            release(m_category, m_bytes);
+        }
+    }
+
+private:
+    MemoryCategory m_category = MemoryCategory::MEM_SCENE_GRAPH;
+    std::size_t m_bytes = 0;
+};
+
+// std::allocator that accounts everything it hands out to a category
+template <typename T, MemoryCategory category>
+struct TrackingAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = TrackingAllocator<U, category>;
+    };
+
+    TrackingAllocator() = default;
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U, category> &) {}
+
+    T *allocate(std::size_t n) {
+        MemoryStats::allocate(category, n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) {
+        std::allocator<T>().deallocate(p, n);
+        MemoryStats::release(category, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const TrackingAllocator<U, category> &) const { return true; }
+    template <typename U>
+    bool operator!=(const TrackingAllocator<U, category> &) const { return false; }
+};
+
+// Bytes a string keeps on the heap; short strings live inside the object itself
+inline std::size_t heapBytes(const std::string &text) {
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+}
+
+// A vector whose storage is accounted to category
+template <typename T, MemoryCategory category>
+using TrackedVector = std::vector<T, TrackingAllocator<T, category>>;
+
+}
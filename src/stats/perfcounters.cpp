@@ -0,0 +1,424 @@
+#include "perfcounters.h"
+
+#include <QJsonArray>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *eventNames[perfEventCount] = {"cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses"};
+const char *stageNames[perfStageCount] = {"parse", "textureLoad", "accelerationBuild", "render", "encode",
+                                          "intersection", "shading"};
+
+bool eventAvailable[perfEventCount] = {};
+int sampleInterval = 64;
+
+// Event totals of one thread, scaled for multiplexing
+struct StageTotals {
+    double values[perfStageCount][perfEventCount] = {};
+};
+
+}
+
+namespace PerfCounters {
+
+namespace detail {
+
+struct ThreadPerf {
+    int threadId = 0;
+    int fds[perfEventCount] = {-1, -1, -1, -1, -1};
+    int slots[perfEventCount] = {-1, -1, -1, -1, -1}; // position of each event in a group read, -1 if not counted
+    int slotCount = 0;
+    int leader = -1;                                  // fd read for the whole group
+
+    std::mutex mutex;                                 // guards totals against concurrent snapshots
+    StageTotals totals{};
+
+    int pixelsUntilSample = 0;
+    Reading pixelStart{};
+    Reading intersectionStart{};
+    double pixelIntersection[perfEventCount] = {};
+};
+
+}
+
+}
+
+namespace {
+
+using PerfCounters::Reading;
+using PerfCounters::detail::ThreadPerf;
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadPerf>> registry{};
+
+#ifdef __linux__
+bool eventAttr(PerfEvent event, perf_event_attr &attr) {
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+        case PerfEvent::PERF_CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::PERF_INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfEvent::PERF_LLC_MISSES:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfEvent::PERF_BRANCH_MISSES:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return false;
+    }
+    // user space only: works under perf_event_paranoid = 2 and keeps syscalls out of the numbers
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return true;
+}
+#endif
+
+/**
+ * @brief openCounters opens the events found available by start() (or every event, when probing) for the calling
+ *          thread as one group, so that they are scheduled onto the PMU together
+ * @return errno of the first failure, 0 if every requested event opened
+ */
+int openCounters(ThreadPerf &perf, bool probing) {
+    int firstError = 0;
+#ifdef __linux__
+    for (int event = 0; event < perfEventCount; event++) {
+        perf_event_attr attr;
+        if ((!probing && !eventAvailable[event]) || !eventAttr(PerfEvent(event), attr)) {
+            continue;
+        }
+        int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, perf.leader, PERF_FLAG_FD_CLOEXEC));
+        if (fd < 0) {
+            firstError = firstError ? firstError : errno;
+            continue;
+        }
+        if (perf.leader < 0) {
+            perf.leader = fd;
+        }
+        perf.fds[event] = fd;
+        perf.slots[event] = perf.slotCount++;
+    }
+#else
+    (void) perf;
+    (void) probing;
+    firstError = ENOSYS;
+#endif
+    return firstError;
+}
+
+void closeCounters(ThreadPerf &perf) {
+#ifdef __linux__
+    for (int &fd : perf.fds) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+#endif
+    perf.leader = -1;
+}
+
+// Opens the calling thread's counters the first time it measures something and closes them when it exits. The
+// registry keeps the totals.
+struct ThreadHolder {
+    std::shared_ptr<ThreadPerf> perf = std::make_shared<ThreadPerf>();
+
+    ThreadHolder() {
+        openCounters(*perf, false);
+        perf->pixelsUntilSample = sampleInterval;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        perf->threadId = int(registry.size()) + 1;
+        registry.push_back(perf);
+    }
+
+    ~ThreadHolder() {
+        PerfCounters::detail::localPerf = nullptr;
+        closeCounters(*perf);
+    }
+};
+
+ThreadPerf &localPerf() {
+    if (!PerfCounters::detail::localPerf) {
+        thread_local ThreadHolder holder;
+        PerfCounters::detail::localPerf = holder.perf.get();
+    }
+    return *PerfCounters::detail::localPerf;
+}
+
+// Events counted between two readings, scaled up by the share of time the kernel multiplexed them out
+void difference(const Reading &start, const Reading &end, double out[perfEventCount]) {
+    double enabled = double(end.timeEnabled - start.timeEnabled);
+    double running = double(end.timeRunning - start.timeRunning);
+    double scale = running > 0 && running < enabled ? enabled / running : 1;
+    for (int event = 0; event < perfEventCount; event++) {
+        out[event] = double(end.values[event] - start.values[event]) * scale;
+    }
+}
+
+std::string readParanoidLevel() {
+    std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+    std::string level;
+    return (file >> level) ? level : "unknown";
+}
+
+double perThousand(double count, double instructions) {
+    return instructions > 0 ? 1000 * count / instructions : 0;
+}
+
+StageTotals sumOverThreads() {
+    StageTotals sum{};
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::shared_ptr<ThreadPerf> &perf : registry) {
+        std::lock_guard<std::mutex> threadLock(perf->mutex);
+        for (int stage = 0; stage < perfStageCount; stage++) {
+            for (int event = 0; event < perfEventCount; event++) {
+                sum.values[stage][event] += perf->totals.values[stage][event];
+            }
+        }
+    }
+    return sum;
+}
+
+QJsonObject stageJson(const double values[perfEventCount]) {
+    QJsonObject json;
+    for (int event = 0; event < perfEventCount; event++) {
+        if (eventAvailable[event]) {
+            json.insert(eventNames[event], values[event]);
+        }
+    }
+    double instructions = values[int(PerfEvent::PERF_INSTRUCTIONS)];
+    double cycles = values[int(PerfEvent::PERF_CYCLES)];
+    if (eventAvailable[int(PerfEvent::PERF_CYCLES)] && eventAvailable[int(PerfEvent::PERF_INSTRUCTIONS)]) {
+        json.insert("ipc", cycles > 0 ? instructions / cycles : 0);
+    }
+    return json;
+}
+
+}
+
+namespace PerfCounters {
+
+namespace detail {
+
+std::atomic<bool> active{false};
+thread_local constinit ThreadPerf *localPerf = nullptr;
+thread_local constinit bool samplingPixel = false;
+
+bool read(Reading &reading) {
+#ifdef __linux__
+    ThreadPerf &perf = ::localPerf();
+    if (perf.leader < 0) {
+        return false;
+    }
+    std::uint64_t buffer[3 + perfEventCount];
+    ssize_t expected = ssize_t(sizeof(std::uint64_t) * (3 + perf.slotCount));
+    if (::read(perf.leader, buffer, sizeof(buffer)) != expected) {
+        return false;
+    }
+    reading.timeEnabled = buffer[1];
+    reading.timeRunning = buffer[2];
+    for (int event = 0; event < perfEventCount; event++) {
+        reading.values[event] = perf.slots[event] >= 0 ? buffer[3 + perf.slots[event]] : 0;
+    }
+    return true;
+#else
+    (void) reading;
+    return false;
+#endif
+}
+
+void add(PerfStage stage, const Reading &start, const Reading &end) {
+    double delta[perfEventCount];
+    difference(start, end, delta);
+    ThreadPerf &perf = ::localPerf();
+    std::lock_guard<std::mutex> lock(perf.mutex);
+    for (int event = 0; event < perfEventCount; event++) {
+        perf.totals.values[int(stage)][event] += delta[event];
+    }
+}
+
+bool beginPixel() {
+    ThreadPerf &perf = ::localPerf();
+    if (--perf.pixelsUntilSample > 0 || perf.leader < 0) {
+        return false;
+    }
+    perf.pixelsUntilSample = sampleInterval;
+    std::fill(std::begin(perf.pixelIntersection), std::end(perf.pixelIntersection), 0.0);
+    samplingPixel = read(perf.pixelStart);
+    return samplingPixel;
+}
+
+/**
+ * @brief endPixel splits the sampled pixel's events into intersection work (summed over its rays) and the rest, and
+ *          adds both, scaled by the sampling interval, to the thread's totals
+ */
+void endPixel() {
+    if (!samplingPixel) {
+        return;
+    }
+    samplingPixel = false;
+    ThreadPerf &perf = ::localPerf();
+    Reading end;
+    if (!read(end)) {
+        return;
+    }
+    double total[perfEventCount];
+    difference(perf.pixelStart, end, total);
+    std::lock_guard<std::mutex> lock(perf.mutex);
+    for (int event = 0; event < perfEventCount; event++) {
+        double intersection = std::min(perf.pixelIntersection[event], total[event]);
+        perf.totals.values[int(PerfStage::STAGE_INTERSECTION)][event] += intersection * sampleInterval;
+        perf.totals.values[int(PerfStage::STAGE_SHADING)][event] += (total[event] - intersection) * sampleInterval;
+    }
+}
+
+void beginIntersection() {
+    read(::localPerf().intersectionStart);
+}
+
+void endIntersection() {
+    ThreadPerf &perf = ::localPerf();
+    Reading end;
+    if (!read(end)) {
+        return;
+    }
+    double delta[perfEventCount];
+    difference(perf.intersectionStart, end, delta);
+    for (int event = 0; event < perfEventCount; event++) {
+        perf.pixelIntersection[event] += delta[event];
+    }
+}
+
+}
+
+/**
+ * @brief start probes every event on the calling thread. Events the kernel or CPU refuses (e.g. cache events inside
+ *          many VMs) are left out; counting is only turned on if at least one event opened.
+ */
+bool start(int pixelSampleInterval, std::string &error) {
+#if RAYTRACER_INSTRUMENTATION
+    sampleInterval = std::max(1, pixelSampleInterval);
+    ThreadPerf &perf = ::localPerf();
+    closeCounters(perf);
+    perf.slotCount = 0;
+    std::fill(std::begin(perf.slots), std::end(perf.slots), -1);
+    int firstError = openCounters(perf, true);
+    for (int event = 0; event < perfEventCount; event++) {
+        eventAvailable[event] = perf.fds[event] >= 0;
+    }
+    perf.pixelsUntilSample = sampleInterval;
+    if (perf.leader < 0) {
+        error = std::string("perf_event_open failed: ") + std::strerror(firstError) +
+                " (perf_event_paranoid = " + readParanoidLevel() + ")";
+        return false;
+    }
+    if (firstError) {
+        error = std::string("some events are unavailable: ") + std::strerror(firstError);
+    }
+    detail::active.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    (void) pixelSampleInterval;
+    error = "instrumentation is compiled out (RAYTRACER_INSTRUMENTATION=0)";
+    return false;
+#endif
+}
+
+bool available(PerfEvent event) {
+    return eventAvailable[int(event)];
+}
+
+void printSummary(std::ostream &out) {
+    if (!active()) {
+        return;
+    }
+    StageTotals totals = sumOverThreads();
+    out << "Hardware counters (user space, all threads; intersection and shading estimated from every "
+        << sampleInterval << "th pixel):" << std::endl;
+    out << "  " << std::left << std::setw(20) << "stage" << std::right << std::setw(16) << "cycles"
+        << std::setw(16) << "instructions" << std::setw(7) << "IPC" << std::setw(15) << "L1D miss/kI"
+        << std::setw(15) << "LLC miss/kI" << std::setw(17) << "branch miss/kI" << std::endl;
+    out << std::fixed;
+    for (int stage = 0; stage < perfStageCount; stage++) {
+        const double *values = totals.values[stage];
+        double cycles = values[int(PerfEvent::PERF_CYCLES)];
+        double instructions = values[int(PerfEvent::PERF_INSTRUCTIONS)];
+        if (cycles == 0 && instructions == 0) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(20) << stageNames[stage] << std::right << std::setprecision(0)
+            << std::setw(16) << cycles << std::setw(16) << instructions << std::setprecision(2)
+            << std::setw(7) << (cycles > 0 ? instructions / cycles : 0)
+            << std::setw(15) << perThousand(values[int(PerfEvent::PERF_L1D_MISSES)], instructions)
+            << std::setw(15) << perThousand(values[int(PerfEvent::PERF_LLC_MISSES)], instructions)
+            << std::setw(17) << perThousand(values[int(PerfEvent::PERF_BRANCH_MISSES)], instructions) << std::endl;
+    }
+    out << std::defaultfloat;
+    for (int event = 0; event < perfEventCount; event++) {
+        if (!eventAvailable[event]) {
+            out << "  (" << eventNames[event] << " unavailable, reported as 0)" << std::endl;
+        }
+    }
+}
+
+QJsonObject toJson() {
+    if (!active()) {
+        return QJsonObject{{"available", false}};
+    }
+    StageTotals totals = sumOverThreads();
+    QJsonObject stages;
+    for (int stage = 0; stage < perfStageCount; stage++) {
+        stages.insert(stageNames[stage], stageJson(totals.values[stage]));
+    }
+
+    QJsonArray threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::shared_ptr<ThreadPerf> &perf : registry) {
+            std::lock_guard<std::mutex> threadLock(perf->mutex);
+            QJsonObject threadStages;
+            for (int stage = 0; stage < perfStageCount; stage++) {
+                const double *values = perf->totals.values[stage];
+                if (std::any_of(values, values + perfEventCount, [](double value) { return value > 0; })) {
+                    threadStages.insert(stageNames[stage], stageJson(values));
+                }
+            }
+            threads.append(QJsonObject{{"thread", perf->threadId}, {"stages", threadStages}});
+        }
+    }
+
+    return QJsonObject{
+        {"available", true},
+        {"pixelSampleInterval", sampleInterval},
+        {"stages", stages},
+        {"threads", threads},
+    };
+}
+
+}
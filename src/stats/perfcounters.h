@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <QJsonObject>
+
+// see raystats.h; hardware counters are compiled out together with the other instrumentation
+#ifndef RAYTRACER_INSTRUMENTATION
+#define RAYTRACER_INSTRUMENTATION 1
+#endif
+
+// Hardware events counted with perf_event_open
+enum class PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,     // L1 data cache read misses
+    PERF_LLC_MISSES,     // last level cache misses, i.e. trips to memory
+    PERF_BRANCH_MISSES
+};
+
+constexpr int perfEventCount = 5;
+
+// Where counted events are attributed. The first five match RenderPhase; intersection and shading split the render
+// stage by the work a ray does.
+enum class PerfStage {
+    STAGE_PARSE,
+    STAGE_TEXTURE_LOAD,
+    STAGE_ACCELERATION_BUILD,
+    STAGE_RENDER,
+    STAGE_ENCODE,
+    STAGE_INTERSECTION,  // finding the closest primitive: BVH traversal and quadratic solves
+    STAGE_SHADING        // everything else done for a pixel: lighting, texture lookups, spawning rays
+};
+
+constexpr int perfStageCount = 7;
+
+// Per-thread hardware counters (Linux only). Counting is off until start() succeeds; when the kernel refuses the
+// counters (other platforms, containers without CAP_PERFMON, a strict perf_event_paranoid) every hook stays a cheap
+// no-op. Each thread opens its counters the first time it measures something and only counts its own user-space
+// work, so threads never share counters.
+namespace PerfCounters {
+
+// A reading of the calling thread's counters
+struct Reading {
+    std::uint64_t values[perfEventCount] = {};
+    std::uint64_t timeEnabled = 0; // the kernel multiplexes counters when there are too few; the ratio of
+    std::uint64_t timeRunning = 0; // these two times scales the values back up
+};
+
+namespace detail {
+
+struct ThreadPerf;
+
+extern std::atomic<bool> active;
+extern thread_local constinit ThreadPerf *localPerf;
+extern thread_local constinit bool samplingPixel;
+
+bool read(Reading &reading);
+void add(PerfStage stage, const Reading &start, const Reading &end);
+bool beginPixel();
+void endPixel();
+void beginIntersection();
+void endIntersection();
+
+}
+
+// Opens the counters on the calling thread and turns counting on.
+// @param pixelSampleInterval the intersection/shading split is measured on every n-th pixel of each thread and
+//          scaled up, because reading the counters around every ray would cost more than the ray
+// @param error receives the reason if no counter could be opened
+// @return whether any counter is available
+bool start(int pixelSampleInterval, std::string &error);
+
+inline bool active() {
+#if RAYTRACER_INSTRUMENTATION
+    return detail::active.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+// Whether event could be opened; unavailable events read as zero
+bool available(PerfEvent event);
+
+// Counts the calling thread's events from construction to destruction toward stage
+class Scope {
+public:
+    explicit Scope(PerfStage stage) : m_stage(stage), m_start(), m_active(active() && detail::read(m_start)) {}
+
+    ~Scope() {
+        Reading end;
+        if (m_active && detail::read(end)) {
+            detail::add(m_stage, m_start, end);
+        }
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    PerfStage m_stage;
+    Reading m_start;
+    bool m_active; // declared after m_start, which the constructor reads into
+};
+
+// Called around each pixel: returns true for the pixels whose intersection and shading work is measured
+inline bool beginPixel() {
+    return active() && detail::beginPixel();
+}
+
+inline void endPixel() {
+#if RAYTRACER_INSTRUMENTATION
+    if (detail::samplingPixel) {
+        detail::endPixel();
+    }
+#endif
+}
+
+// Called around the closest-hit search of every ray; only reads the counters inside a sampled pixel
+inline void beginIntersection() {
+#if RAYTRACER_INSTRUMENTATION
+    if (detail::samplingPixel) {
+        detail::beginIntersection();
+    }
+#endif
+}
+
+inline void endIntersection() {
+#if RAYTRACER_INSTRUMENTATION
+    if (detail::samplingPixel) {
+        detail::endIntersection();
+    }
+#endif
+}
+
+// Writes per-stage totals over all threads, with IPC and misses per thousand instructions
+void printSummary(std::ostream &out);
+
+// Totals per stage and the same broken down per thread
+QJsonObject toJson();
+
+}
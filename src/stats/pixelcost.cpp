@@ -0,0 +1,41 @@
+#include "pixelcost.h"
+
+CostMetric costMetricFromName(const std::string &name) {
+    if (name == "time") {
+        return CostMetric::COST_TIME;
+    } else if (name == "rays") {
+        return CostMetric::COST_RAYS;
+    } else if (name == "intersections") {
+        return CostMetric::COST_INTERSECTIONS;
+    }
+    return CostMetric::COST_NONE;
+}
+
+const char *costMetricName(CostMetric metric) {
+    switch (metric) {
+        case CostMetric::COST_TIME:          return "time";
+        case CostMetric::COST_RAYS:          return "rays";
+        case CostMetric::COST_INTERSECTIONS: return "intersections";
+        case CostMetric::COST_NONE:          break;
+    }
+    return "none";
+}
+
+const char *costMetricUnit(CostMetric metric) {
+    switch (metric) {
+        case CostMetric::COST_TIME:
+#ifdef RAYTRACER_HAS_RDTSC
+            return "cycles";
+#else
+            return "ns";
+#endif
+        case CostMetric::COST_RAYS:          return "rays";
+        case CostMetric::COST_INTERSECTIONS: return "tests";
+        case CostMetric::COST_NONE:          break;
+    }
+    return "";
+}
+
+bool costMetricAvailable(CostMetric metric) {
+    return metric == CostMetric::COST_TIME || (metric != CostMetric::COST_NONE && RayStats::enabled);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "raystats.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RAYTRACER_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RAYTRACER_HAS_RDTSC 1
+#endif
+
+// What the per-pixel cost heatmap measures
+enum class CostMetric {
+    COST_NONE,
+    COST_TIME,          // wall-clock time spent on the pixel: TSC cycles on x86, nanoseconds elsewhere
+    COST_RAYS,          // rays of every type traced for the pixel
+    COST_INTERSECTIONS  // primitive intersection tests made for the pixel
+};
+
+// Parses "time", "rays" or "intersections"; anything else disables the heatmap
+CostMetric costMetricFromName(const std::string &name);
+
+const char *costMetricName(CostMetric metric);
+
+// Unit of the values measured for metric, e.g. "cycles"
+const char *costMetricUnit(CostMetric metric);
+
+// Ray and intersection counts come from RayStats, so only time can be measured without instrumentation
+bool costMetricAvailable(CostMetric metric);
+
+// A counter of the calling thread that grows with the metric. The cost of a pixel is the difference between samples
+// taken before and after it is rendered.
+inline std::uint64_t sampleCost(CostMetric metric) {
+    switch (metric) {
+        case CostMetric::COST_TIME:
+#ifdef RAYTRACER_HAS_RDTSC
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        case CostMetric::COST_RAYS:
+            return RayStats::threadRayCount();
+        case CostMetric::COST_INTERSECTIONS:
+            return RayStats::threadCount(RenderEvent::EVENT_INTERSECTION_TEST);
+        case CostMetric::COST_NONE:
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "progress.h"
+
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTcpSocket>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// e.g. "1.5 M"
+std::string withSuffix(double value) {
+    const char *suffixes[] = {"", " k", " M", " G"};
+    int i = 0;
+    while (value >= 1000 && i < 3) {
+        value /= 1000;
+        i++;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f%s", value, suffixes[i]);
+    return text;
+}
+
+// e.g. "1h 02m 05s"
+std::string duration(double seconds) {
+    long total = long(seconds + 0.5);
+    char text[32];
+    if (total >= 3600) {
+        std::snprintf(text, sizeof(text), "%ldh %02ldm %02lds", total / 3600, total / 60 % 60, total % 60);
+    } else if (total >= 60) {
+        std::snprintf(text, sizeof(text), "%ldm %02lds", total / 60, total % 60);
+    } else {
+        std::snprintf(text, sizeof(text), "%lds", total);
+    }
+    return text;
+}
+
+}
+
+void RenderProgress::expectPixels(std::uint64_t pixels) {
+    m_pixelsExpected.store(pixels, std::memory_order_relaxed);
+}
+
+void RenderProgress::planTiles(std::uint64_t tiles, std::uint64_t pixels, double estimatedCost) {
+    std::int64_t unset = -1;
+    m_startNs.compare_exchange_strong(unset, nowNs(), std::memory_order_relaxed);
+    m_tilesPlanned.fetch_add(tiles, std::memory_order_relaxed);
+    m_pixelsPlanned.fetch_add(pixels, std::memory_order_relaxed);
+    m_costPlanned.fetch_add(std::uint64_t(estimatedCost), std::memory_order_relaxed);
+}
+
+/**
+ * @brief RenderProgress::snapshot reads the counters and derives the rates. The fraction done is the estimated cost of
+ *          the finished tiles over the estimated cost of the whole job; the ETA assumes the remaining cost is worked
+ *          off at the rate seen so far.
+ */
+RenderProgress::Snapshot RenderProgress::snapshot() const {
+    Snapshot snapshot;
+    snapshot.tilesDone = m_tilesDone.load(std::memory_order_relaxed);
+    snapshot.tilesPlanned = m_tilesPlanned.load(std::memory_order_relaxed);
+    snapshot.pixelsDone = m_pixelsDone.load(std::memory_order_relaxed);
+    snapshot.rays = m_rays.load(std::memory_order_relaxed);
+    std::uint64_t pixelsPlanned = m_pixelsPlanned.load(std::memory_order_relaxed);
+    std::uint64_t pixelsExpected = m_pixelsExpected.load(std::memory_order_relaxed);
+    snapshot.pixelsTotal = std::max(pixelsPlanned, pixelsExpected);
+
+    std::int64_t startNs = m_startNs.load(std::memory_order_relaxed);
+    if (startNs < 0 || pixelsPlanned == 0) {
+        return snapshot;
+    }
+    snapshot.elapsedSeconds = (nowNs() - startNs) / 1e9;
+    if (snapshot.elapsedSeconds > 0) {
+        snapshot.raysPerSecond = snapshot.rays / snapshot.elapsedSeconds;
+    }
+
+    double costDone = double(m_costDone.load(std::memory_order_relaxed));
+    double costPlanned = double(m_costPlanned.load(std::memory_order_relaxed));
+    // unplanned pixels (later bands or frames) are assumed to cost the planned average
+    double costTotal = costPlanned + double(snapshot.pixelsTotal - pixelsPlanned) * costPlanned / pixelsPlanned;
+    if (costTotal > 0) {
+        snapshot.fraction = std::min(1.0, costDone / costTotal);
+    } else {
+        snapshot.fraction = double(snapshot.pixelsDone) / snapshot.pixelsTotal;
+    }
+    if (snapshot.tilesDone > 0 && snapshot.fraction > 0) {
+        snapshot.etaSeconds = snapshot.elapsedSeconds * (1 - snapshot.fraction) / snapshot.fraction;
+    }
+    return snapshot;
+}
+
+QJsonObject progressToJson(const RenderProgress::Snapshot &snapshot, bool done) {
+    return QJsonObject{
+        {"state", done ? "done" : "rendering"},
+        {"fraction", snapshot.fraction},
+        {"etaSeconds", snapshot.etaSeconds},
+        {"elapsedSeconds", snapshot.elapsedSeconds},
+        {"tilesDone", qint64(snapshot.tilesDone)},
+        {"tilesPlanned", qint64(snapshot.tilesPlanned)},
+        {"pixelsDone", qint64(snapshot.pixelsDone)},
+        {"pixelsTotal", qint64(snapshot.pixelsTotal)},
+        {"rays", qint64(snapshot.rays)},
+        {"raysPerSecond", snapshot.raysPerSecond},
+    };
+}
+
+ProgressReporter::ProgressReporter(const RenderProgress &progress, const ProgressOptions &options) :
+    m_progress(progress),
+    m_options(options)
+{}
+
+ProgressReporter::~ProgressReporter() {
+    finish();
+}
+
+void ProgressReporter::start() {
+    if (!m_options.enabled() || m_thread.joinable()) {
+        return;
+    }
+    m_finishing = false;
+    m_thread = std::thread(&ProgressReporter::run, this);
+}
+
+void ProgressReporter::finish() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finishing = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+/**
+ * @brief ProgressReporter::run is the reporter thread. The socket is created here because Qt sockets belong to the
+ *          thread that creates them. A socket or status file that fails is reported once and then left alone, so a
+ *          missing listener never disturbs the render.
+ */
+void ProgressReporter::run() {
+    std::unique_ptr<QTcpSocket> socket;
+    if (!m_options.socketAddress.isEmpty()) {
+        QStringList hostAndPort = m_options.socketAddress.split(":");
+        bool validPort = false;
+        int port = hostAndPort.size() == 2 ? hostAndPort[1].toInt(&validPort) : 0;
+        if (!validPort) {
+            std::cerr << "Warning: expected the progress socket as host:port, got \""
+                      << m_options.socketAddress.toStdString() << "\"" << std::endl;
+        } else {
+            socket = std::make_unique<QTcpSocket>();
+            socket->connectToHost(hostAndPort[0], port);
+            if (!socket->waitForConnected(1000)) {
+                std::cerr << "Warning: could not connect to progress listener at "
+                          << m_options.socketAddress.toStdString() << ": " << socket->errorString().toStdString()
+                          << std::endl;
+                socket.reset();
+            }
+        }
+    }
+    bool statusFileFailed = false;
+
+    bool done = false;
+    while (!done) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(std::max(1, m_options.intervalMs)),
+                            [this]() { return m_finishing; });
+            done = m_finishing;
+        }
+        RenderProgress::Snapshot snapshot = m_progress.snapshot();
+
+        if (m_options.console) {
+            // formatted first so that the line reaches stderr in one piece
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(1) << "Progress: " << 100 * snapshot.fraction << "% ("
+                 << snapshot.tilesDone << "/" << snapshot.tilesPlanned << " tiles";
+            if (snapshot.rays > 0) {
+                line << ", " << withSuffix(snapshot.raysPerSecond) << "rays/s";
+            }
+            line << "), elapsed " << duration(snapshot.elapsedSeconds);
+            if (done) {
+                line << ", done";
+            } else if (snapshot.etaSeconds >= 0) {
+                line << ", ETA " << duration(snapshot.etaSeconds);
+            }
+            std::cerr << line.str() << std::endl;
+        }
+
+        QByteArray json = QJsonDocument(progressToJson(snapshot, done)).toJson(QJsonDocument::Compact);
+        json.append('\n');
+        if (!m_options.statusPath.isEmpty() && !statusFileFailed) {
+            QSaveFile file(m_options.statusPath);
+            if (!file.open(QIODevice::WriteOnly) || file.write(json) < 0 || !file.commit()) {
+                std::cerr << "Warning: failed to write progress to \"" << m_options.statusPath.toStdString() << "\""
+                          << std::endl;
+                statusFileFailed = true;
+            }
+        }
+        if (socket) {
+            socket->write(json);
+            if (!socket->waitForBytesWritten(1000)) {
+                std::cerr << "Warning: lost the progress listener: " << socket->errorString().toStdString() << std::endl;
+                socket.reset();
+            }
+        }
+    }
+    if (socket) {
+        socket->disconnectFromHost();
+    }
+}
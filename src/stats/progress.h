@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <QJsonObject>
+#include <QString>
+
+// Progress of a render, shared between the render threads that complete tiles and a reporter that reads it. Workers
+// only do relaxed atomic adds, so they never wait for the reporter.
+//
+// Completion is measured in estimated cost rather than pixels: before rendering, RayTracer traces a sparse grid of
+// pixels in every tile and times them, so a tile full of reflective spheres counts for more than a tile of background.
+class RenderProgress {
+public:
+    struct Snapshot {
+        std::uint64_t tilesDone = 0;
+        std::uint64_t tilesPlanned = 0;
+        std::uint64_t pixelsDone = 0;
+        std::uint64_t pixelsTotal = 0;
+        std::uint64_t rays = 0;       // 0 when instrumentation is compiled out
+        double elapsedSeconds = 0;    // since the first tiles were planned
+        double raysPerSecond = 0;
+        double fraction = 0;          // of the estimated cost of the whole job
+        double etaSeconds = -1;       // -1 until the first tile is done
+    };
+
+    // Total pixels of the whole job, e.g. every band of a streamed image or every frame of a sequence. Pixels beyond
+    // the tiles planned so far are assumed to cost as much per pixel as the planned ones. Without it, only planned
+    // tiles count.
+    void expectPixels(std::uint64_t pixels);
+
+    // Announces tiles about to be rendered, with their summed estimated cost
+    void planTiles(std::uint64_t tiles, std::uint64_t pixels, double estimatedCost);
+
+    // Called by render threads when a tile is finished
+    void completeTile(std::uint64_t pixels, double estimatedCost, std::uint64_t rays) {
+        m_tilesDone.fetch_add(1, std::memory_order_relaxed);
+        m_pixelsDone.fetch_add(pixels, std::memory_order_relaxed);
+        m_costDone.fetch_add(std::uint64_t(estimatedCost), std::memory_order_relaxed);
+        m_rays.fetch_add(rays, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const;
+
+private:
+    std::atomic<std::uint64_t> m_tilesDone{0};
+    std::atomic<std::uint64_t> m_pixelsDone{0};
+    std::atomic<std::uint64_t> m_costDone{0};
+    std::atomic<std::uint64_t> m_rays{0};
+    std::atomic<std::uint64_t> m_tilesPlanned{0};
+    std::atomic<std::uint64_t> m_pixelsPlanned{0};
+    std::atomic<std::uint64_t> m_costPlanned{0};
+    std::atomic<std::uint64_t> m_pixelsExpected{0};
+    std::atomic<std::int64_t> m_startNs{-1};
+};
+
+// Where progress reports go
+struct ProgressOptions {
+    bool console = false;     // a line on stderr per report
+    QString statusPath{};     // if set, rewritten as a JSON object on every report (atomically, via a temporary file)
+    QString socketAddress{};  // host:port; if set, every report is sent there as one line of JSON
+    int intervalMs = 1000;
+
+    bool enabled() const { return console || !statusPath.isEmpty() || !socketAddress.isEmpty(); }
+};
+
+// Converts a snapshot into the object written to the status file and socket
+QJsonObject progressToJson(const RenderProgress::Snapshot &snapshot, bool done);
+
+// Reports a RenderProgress at a fixed interval from its own thread until finish() is called or it is destroyed,
+// then sends a last report marked done.
+class ProgressReporter {
+public:
+    ProgressReporter(const RenderProgress &progress, const ProgressOptions &options);
+    ~ProgressReporter();
+
+    ProgressReporter(const ProgressReporter &) = delete;
+    ProgressReporter &operator=(const ProgressReporter &) = delete;
+
+    // Does nothing if no output is enabled
+    void start();
+    void finish();
+
+private:
+    void run();
+
+    const RenderProgress &m_progress;
+    ProgressOptions m_options;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_finishing = false;
+};
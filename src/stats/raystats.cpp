@@ -0,0 +1,183 @@
+#include "raystats.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace {
+
+using RayStats::detail::ThreadCounters;
+
+std::mutex registryMutex;
+
+// counters of every thread, kept after the thread exits so totals never decrease
+std::vector<std::shared_ptr<ThreadCounters>> &registry() {
+    static std::vector<std::shared_ptr<ThreadCounters>> threadCounters{};
+    return threadCounters;
+}
+
+// phases are timed a handful of times per render, so shared atomics are cheap enough
+std::atomic<std::int64_t> phaseNs[renderPhaseCount] = {};
+
+double percentOf(std::uint64_t part, std::uint64_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+double perRay(std::uint64_t count, const RenderCounts &counts) {
+    return counts.rays.total() > 0 ? double(count) / counts.rays.total() : 0;
+}
+
+}
+
+RenderCounts RenderCounts::operator-(const RenderCounts &earlier) const {
+    return RenderCounts{
+        rays - earlier.rays,
+        intersectionTests - earlier.intersectionTests,
+        intersectionHits - earlier.intersectionHits,
+        bvhNodesVisited - earlier.bvhNodesVisited,
+        textureFetches - earlier.textureFetches,
+        lightEvaluations - earlier.lightEvaluations,
+        occluderCacheLookups - earlier.occluderCacheLookups,
+        occluderCacheHits - earlier.occluderCacheHits,
+    };
+}
+
+RenderStats RenderStats::operator-(const RenderStats &earlier) const {
+    RenderStats difference{counts - earlier.counts};
+    for (int phase = 0; phase < renderPhaseCount; phase++) {
+        difference.phaseMs[phase] = phaseMs[phase] - earlier.phaseMs[phase];
+    }
+    return difference;
+}
+
+namespace RayStats {
+
+namespace detail {
+
+thread_local constinit ThreadCounters *localCounters = nullptr;
+
+/**
+ * @brief registerThread creates the calling thread's counters. The registry shares ownership, so the counts survive
+ *          the thread.
+ */
+ThreadCounters &registerThread() {
+    thread_local std::shared_ptr<ThreadCounters> counters = []() {
+        auto created = std::make_shared<ThreadCounters>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry().push_back(created);
+        return created;
+    }();
+    localCounters = counters.get();
+    return *counters;
+}
+
+}
+
+void addPhaseTime(RenderPhase phase, std::int64_t ns) {
+    phaseNs[int(phase)].fetch_add(ns, std::memory_order_relaxed);
+}
+
+RayCounts snapshot() {
+    return snapshotStats().counts.rays;
+}
+
+RenderStats snapshotStats() {
+    std::uint64_t totals[detail::counterCount] = {};
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::shared_ptr<ThreadCounters> &counters : registry()) {
+            for (int counter = 0; counter < detail::counterCount; counter++) {
+                totals[counter] += counters->counts[counter].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    auto event = [&totals](RenderEvent event) { return totals[3 + int(event)]; };
+    RenderStats stats{};
+    stats.counts.rays = RayCounts{totals[int(RayType::RAY_PRIMARY)], totals[int(RayType::RAY_SHADOW)],
+                                  totals[int(RayType::RAY_REFLECTION)]};
+    stats.counts.intersectionTests = event(RenderEvent::EVENT_INTERSECTION_TEST);
+    stats.counts.intersectionHits = event(RenderEvent::EVENT_INTERSECTION_HIT);
+    stats.counts.bvhNodesVisited = event(RenderEvent::EVENT_BVH_NODE);
+    stats.counts.textureFetches = event(RenderEvent::EVENT_TEXTURE_FETCH);
+    stats.counts.lightEvaluations = event(RenderEvent::EVENT_LIGHT_EVALUATION);
+    stats.counts.occluderCacheLookups = event(RenderEvent::EVENT_OCCLUDER_CACHE_LOOKUP);
+    stats.counts.occluderCacheHits = event(RenderEvent::EVENT_OCCLUDER_CACHE_HIT);
+    for (int phase = 0; phase < renderPhaseCount; phase++) {
+        stats.phaseMs[phase] = phaseNs[phase].load(std::memory_order_relaxed) / 1e6;
+    }
+    return stats;
+}
+
+const char *phaseName(RenderPhase phase) {
+    switch (phase) {
+        case RenderPhase::PHASE_PARSE:              return "parse";
+        case RenderPhase::PHASE_TEXTURE_LOAD:       return "textureLoad";
+        case RenderPhase::PHASE_ACCELERATION_BUILD: return "accelerationBuild";
+        case RenderPhase::PHASE_RENDER:             return "render";
+        case RenderPhase::PHASE_ENCODE:             return "encode";
+    }
+    return "unknown";
+}
+
+void printSummary(std::ostream &out, const RenderStats &stats) {
+    if (!enabled) {
+        out << "Render stats: instrumentation is compiled out (RAYTRACER_INSTRUMENTATION=0)" << std::endl;
+        return;
+    }
+    const RenderCounts &counts = stats.counts;
+    out << "Render stats:" << std::endl;
+    out << std::fixed << std::setprecision(1);
+    for (int phase = 0; phase < renderPhaseCount; phase++) {
+        out << "  " << std::left << std::setw(20) << phaseName(RenderPhase(phase)) << std::right
+            << std::setw(12) << stats.phaseMs[phase] << " ms" << std::endl;
+    }
+    out << "  " << std::left << std::setw(20) << "rays" << std::right << std::setw(12) << counts.rays.total()
+        << "  (primary " << counts.rays.primary << ", shadow " << counts.rays.shadow
+        << ", reflection " << counts.rays.reflection << ")" << std::endl;
+    out << std::setprecision(2);
+    out << "  " << std::left << std::setw(20) << "intersection tests" << std::right << std::setw(12)
+        << counts.intersectionTests << "  (" << perRay(counts.intersectionTests, counts) << " per ray)" << std::endl;
+    out << "  " << std::left << std::setw(20) << "intersection hits" << std::right << std::setw(12)
+        << counts.intersectionHits << "  (" << percentOf(counts.intersectionHits, counts.intersectionTests)
+        << "% of tests)" << std::endl;
+    out << "  " << std::left << std::setw(20) << "BVH nodes visited" << std::right << std::setw(12)
+        << counts.bvhNodesVisited << "  (" << perRay(counts.bvhNodesVisited, counts) << " per ray)" << std::endl;
+    out << "  " << std::left << std::setw(20) << "texture fetches" << std::right << std::setw(12)
+        << counts.textureFetches << std::endl;
+    out << "  " << std::left << std::setw(20) << "light evaluations" << std::right << std::setw(12)
+        << counts.lightEvaluations << std::endl;
+    out << "  " << std::left << std::setw(20) << "occluder cache hits" << std::right << std::setw(12)
+        << counts.occluderCacheHits << "  (" << percentOf(counts.occluderCacheHits, counts.occluderCacheLookups)
+        << "% of " << counts.occluderCacheLookups << " lookups)" << std::endl;
+    out << std::defaultfloat;
+}
+
+QJsonObject toJson(const RenderStats &stats) {
+    QJsonObject phases;
+    for (int phase = 0; phase < renderPhaseCount; phase++) {
+        phases.insert(phaseName(RenderPhase(phase)), stats.phaseMs[phase]);
+    }
+    const RenderCounts &counts = stats.counts;
+    return QJsonObject{
+        {"instrumentation", enabled},
+        {"phasesMs", phases},
+        {"rays", QJsonObject{
+            {"primary", qint64(counts.rays.primary)},
+            {"shadow", qint64(counts.rays.shadow)},
+            {"reflection", qint64(counts.rays.reflection)},
+            {"total", qint64(counts.rays.total())},
+        }},
+        {"intersectionTests", qint64(counts.intersectionTests)},
+        {"intersectionHits", qint64(counts.intersectionHits)},
+        {"bvhNodesVisited", qint64(counts.bvhNodesVisited)},
+        {"textureFetches", qint64(counts.textureFetches)},
+        {"lightEvaluations", qint64(counts.lightEvaluations)},
+        {"occluderCacheLookups", qint64(counts.occluderCacheLookups)},
+        {"occluderCacheHits", qint64(counts.occluderCacheHits)},
+    };
+}
+
+}
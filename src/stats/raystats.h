@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <QJsonObject>
+#include "memstats.h"
+#include "perfcounters.h"
+#include "tracing.h"
+
+// Instrumentation is compiled in unless the build sets RAYTRACER_INSTRUMENTATION=0 (CMake option of the same name).
+// When it is off every counting hook below is an empty inline function and all snapshots are zero.
+#ifndef RAYTRACER_INSTRUMENTATION
+#define RAYTRACER_INSTRUMENTATION 1
+#endif
+
+// Kinds of rays shot by the ray tracer
+enum class RayType {
+    RAY_PRIMARY,    // from the camera through a pixel
+    RAY_SHADOW,     // from a surface point toward a light
+    RAY_REFLECTION  // mirrored about a surface normal
+};
+
+// Per-ray work counted besides the rays themselves
+enum class RenderEvent {
+    EVENT_INTERSECTION_TEST,  // a ray tested against one primitive
+    EVENT_INTERSECTION_HIT,   // a tested primitive that the ray hits within its (tMin, tMax) interval
+    EVENT_BVH_NODE,           // a BVH node visited during traversal
+    EVENT_TEXTURE_FETCH,      // a texture sampled at an intersection
+    EVENT_LIGHT_EVALUATION,   // a light evaluated by the shading model
+    EVENT_OCCLUDER_CACHE_LOOKUP, // a shadow ray tested against the last primitive that blocked its light
+    EVENT_OCCLUDER_CACHE_HIT     // ... which blocked it again, so no full occlusion query was needed
+};
+
+// Stages of a render that are timed as a whole
+enum class RenderPhase {
+    PHASE_PARSE,              // reading the scene file
+    PHASE_TEXTURE_LOAD,       // decoding textures, summed over the decoder threads; overlaps the other phases
+    PHASE_ACCELERATION_BUILD, // building the BVH
+    PHASE_RENDER,             // tracing rays
+    PHASE_ENCODE              // tone mapping and writing the image
+};
+
+constexpr int renderPhaseCount = 5;
+
+// Number of rays traced, by type
+struct RayCounts {
+    std::uint64_t primary = 0;
+    std::uint64_t shadow = 0;
+    std::uint64_t reflection = 0;
+
+    std::uint64_t total() const { return primary + shadow + reflection; }
+    RayCounts operator-(const RayCounts &earlier) const {
+        return RayCounts{primary - earlier.primary, shadow - earlier.shadow, reflection - earlier.reflection};
+    }
+};
+
+// Rays and the per-ray work they caused
+struct RenderCounts {
+    RayCounts rays;
+    std::uint64_t intersectionTests = 0;
+    std::uint64_t intersectionHits = 0;
+    std::uint64_t bvhNodesVisited = 0;
+    std::uint64_t textureFetches = 0;
+    std::uint64_t lightEvaluations = 0;
+    std::uint64_t occluderCacheLookups = 0;
+    std::uint64_t occluderCacheHits = 0;
+
+    RenderCounts operator-(const RenderCounts &earlier) const;
+};
+
+// Counters plus the time spent in each phase
+struct RenderStats {
+    RenderCounts counts;
+    double phaseMs[renderPhaseCount] = {};
+
+    RenderStats operator-(const RenderStats &earlier) const;
+};
+
+// Process-wide render counters. Every thread increments counters of its own, so counting needs no synchronization
+// between render threads; totals are summed over all threads on demand. Counts only grow: measure an interval by
+// subtracting the snapshot taken at its start.
+namespace RayStats {
+
+constexpr bool enabled = RAYTRACER_INSTRUMENTATION;
+
+namespace detail {
+
+constexpr int counterCount = 3 + 7; // ray types, then render events
+
+// Counters written by a single thread; atomics only so that snapshots can read them while rays are traced.
+// Each block gets its own cache line so that threads counting rays never invalidate each other's caches.
+struct alignas(64) ThreadCounters {
+    std::atomic<std::uint64_t> counts[counterCount] = {};
+};
+
+// null until the thread first counts something
+extern thread_local constinit ThreadCounters *localCounters;
+
+ThreadCounters &registerThread();
+
+inline void increment(int counter, std::uint64_t n) {
+    ThreadCounters *counters = localCounters ? localCounters : &registerThread();
+    std::atomic<std::uint64_t> &count = counters->counts[counter];
+    // this thread is the only writer, so a plain load and store replace the locked read-modify-write
+    count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline std::uint64_t localValue(int counter) {
+    return localCounters ? localCounters->counts[counter].load(std::memory_order_relaxed) : 0;
+}
+
+}
+
+inline void countRay(RayType type) {
+#if RAYTRACER_INSTRUMENTATION
+    detail::increment(int(type), 1);
+#else
+    (void) type;
+#endif
+}
+
+inline void count(RenderEvent event, std::uint64_t n = 1) {
+#if RAYTRACER_INSTRUMENTATION
+    detail::increment(3 + int(event), n);
+#else
+    (void) event;
+    (void) n;
+#endif
+}
+
+// Counts of the calling thread alone, e.g. to attribute work to a single pixel
+inline std::uint64_t threadRayCount() {
+    return detail::localValue(int(RayType::RAY_PRIMARY)) + detail::localValue(int(RayType::RAY_SHADOW)) +
+           detail::localValue(int(RayType::RAY_REFLECTION));
+}
+
+inline std::uint64_t threadCount(RenderEvent event) {
+    return detail::localValue(3 + int(event));
+}
+
+void addPhaseTime(RenderPhase phase, std::int64_t ns);
+
+// Ray totals over every thread that has traced rays so far
+RayCounts snapshot();
+
+// All counters and phase times accumulated so far
+RenderStats snapshotStats();
+
+const char *phaseName(RenderPhase phase);
+
+// Writes a human-readable table of the stats
+void printSummary(std::ostream &out, const RenderStats &stats);
+
+QJsonObject toJson(const RenderStats &stats);
+
+// Adds the time from construction to destruction to a phase, and records it as a span if tracing is on. The calling
+// thread's hardware counters (if started) are attributed to the phase as well, and memory use is recorded when the
+// phase ends.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(RenderPhase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+#if RAYTRACER_INSTRUMENTATION
+    RenderPhase m_phase;
+    PerfCounters::Scope m_perf;
+    std::chrono::steady_clock::time_point m_start;
+#endif
+};
+
+// Sends the calling thread's counts to a scratch block that no total includes, from construction to destruction.
+// For rays traced only to estimate costs, which would otherwise inflate the stats and rays/s of the render.
+class UncountedScope {
+public:
+    UncountedScope();
+    ~UncountedScope();
+
+    UncountedScope(const UncountedScope &) = delete;
+    UncountedScope &operator=(const UncountedScope &) = delete;
+
+private:
+#if RAYTRACER_INSTRUMENTATION
+    detail::ThreadCounters *m_counters;
+#endif
+};
+
+static_assert(int(RenderPhase::PHASE_ENCODE) == int(PerfStage::STAGE_ENCODE), "phases map onto the first perf stages");
+
+#if RAYTRACER_INSTRUMENTATION
+inline PhaseTimer::PhaseTimer(RenderPhase phase) :
+    m_phase(phase), m_perf(PerfStage(int(phase))), m_start(std::chrono::steady_clock::now())
+{}
+
+inline PhaseTimer::~PhaseTimer() {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    addPhaseTime(m_phase, std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count());
+    if (Trace::recording()) {
+        Trace::recordSpan(phaseName(m_phase), "phase", m_start, end);
+    }
+    MemoryStats::endPhase(phaseName(m_phase));
+}
+
+inline UncountedScope::UncountedScope() : m_counters(detail::localCounters) {
+    thread_local detail::ThreadCounters scratch{};
+    detail::localCounters = &scratch;
+}
+
+inline UncountedScope::~UncountedScope() {
+    detail::localCounters = m_counters;
+}
+#else
+inline PhaseTimer::PhaseTimer(RenderPhase) {}
+inline PhaseTimer::~PhaseTimer() {}
+inline UncountedScope::UncountedScope() {}
+inline UncountedScope::~UncountedScope() {}
+#endif
+
+}
@@ -0,0 +1,160 @@
+#include "tracing.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    const char *category;
+    std::int64_t startNs;    // since Trace::start()
+    std::int64_t durationNs;
+    std::int64_t arg;        // -1 if unused
+    std::string detail;
+};
+
+// Events of one thread. The mutex is only ever contended while the trace is written or restarted.
+struct ThreadBuffer {
+    std::mutex mutex;
+    int threadId = 0;
+    std::string name{};
+    std::vector<TraceEvent> events{}; // grows up to the capacity, then wraps around
+    std::size_t next = 0;             // slot of the next event once the buffer has wrapped
+    std::uint64_t dropped = 0;        // events overwritten after wrapping
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry{};
+std::atomic<std::size_t> capacity{16384};
+std::atomic<std::int64_t> epochNs{0};
+
+std::int64_t toNs(Trace::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+ThreadBuffer &localBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        created->threadId = int(registry.size()) + 1;
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+}
+
+namespace Trace {
+
+namespace detail {
+std::atomic<bool> recording{false};
+}
+
+void start(std::size_t eventsPerThread) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::shared_ptr<ThreadBuffer> &buffer : registry) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+        buffer->next = 0;
+        buffer->dropped = 0;
+    }
+    capacity.store(std::max<std::size_t>(1, eventsPerThread), std::memory_order_relaxed);
+    epochNs.store(toNs(Clock::now()), std::memory_order_relaxed);
+    detail::recording.store(true, std::memory_order_release);
+}
+
+void setThreadName(const std::string &name) {
+    ThreadBuffer &buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void recordSpan(const char *name, const char *category, Clock::time_point start, Clock::time_point end,
+                std::int64_t arg, std::string detail) {
+    if (!recording()) {
+        return;
+    }
+    std::int64_t startNs = toNs(start) - epochNs.load(std::memory_order_relaxed);
+    TraceEvent event{name, category, startNs, toNs(end) - toNs(start), arg, std::move(detail)};
+
+    ThreadBuffer &buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() < capacity.load(std::memory_order_relaxed)) {
+        buffer.events.push_back(std::move(event));
+        return;
+    }
+    buffer.events[buffer.next] = std::move(event);
+    buffer.next = (buffer.next + 1) % buffer.events.size();
+    buffer.dropped++;
+}
+
+/**
+ * @brief writeChromeTrace writes complete ("X") events with microsecond timestamps, one row per thread, plus
+ *          thread_name metadata events for the rows. Events overwritten in full ring buffers are reported as
+ *          droppedEvents.
+ */
+bool writeChromeTrace(const QString &path) {
+    QJsonArray events;
+    std::uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::shared_ptr<ThreadBuffer> &buffer : registry) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            if (buffer->events.empty()) {
+                continue;
+            }
+            dropped += buffer->dropped;
+            std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->threadId) : buffer->name;
+            events.append(QJsonObject{
+                {"name", "thread_name"},
+                {"ph", "M"},
+                {"pid", 1},
+                {"tid", buffer->threadId},
+                {"args", QJsonObject{{"name", QString::fromStdString(name)}}},
+            });
+            // oldest first: after wrapping, the oldest event sits at next
+            for (std::size_t i = 0; i < buffer->events.size(); i++) {
+                const TraceEvent &event = buffer->events[(buffer->next + i) % buffer->events.size()];
+                QJsonObject args;
+                if (event.arg >= 0) {
+                    args.insert("index", qint64(event.arg));
+                }
+                if (!event.detail.empty()) {
+                    args.insert("detail", QString::fromStdString(event.detail));
+                }
+                events.append(QJsonObject{
+                    {"name", event.name},
+                    {"cat", event.category},
+                    {"ph", "X"},
+                    {"ts", event.startNs / 1e3},
+                    {"dur", event.durationNs / 1e3},
+                    {"pid", 1},
+                    {"tid", buffer->threadId},
+                    {"args", args},
+                });
+            }
+        }
+    }
+
+    QJsonObject trace{
+        {"traceEvents", events},
+        {"displayTimeUnit", "ms"},
+        {"otherData", QJsonObject{{"droppedEvents", qint64(dropped)}}},
+    };
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(trace).toJson()) < 0) {
+        std::cerr << "Error: failed to write trace to \"" << path.toStdString() << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
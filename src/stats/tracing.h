@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <QString>
+
+// see raystats.h; tracing is compiled out together with the counters
+#ifndef RAYTRACER_INSTRUMENTATION
+#define RAYTRACER_INSTRUMENTATION 1
+#endif
+
+// Timeline of what every thread did during a render, exported in Chrome's trace event format (open the file in
+// ui.perfetto.dev or chrome://tracing). Each thread records into a ring buffer of its own, so recording takes no
+// shared lock; once a buffer is full the oldest events are overwritten. Nothing is recorded until start() is called.
+namespace Trace {
+
+namespace detail {
+extern std::atomic<bool> recording;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Starts recording. Timestamps in the trace are relative to this call.
+void start(std::size_t eventsPerThread = 16384);
+
+inline bool recording() {
+#if RAYTRACER_INSTRUMENTATION
+    return detail::recording.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+// Labels the calling thread's row in the trace
+void setThreadName(const std::string &name);
+
+// Records a finished span on the calling thread. name and category are not copied and must be string literals;
+// detail (e.g. a file name) is shown with the span's arguments.
+void recordSpan(const char *name, const char *category, Clock::time_point start, Clock::time_point end,
+                std::int64_t arg = -1, std::string detail = {});
+
+// Writes the events of every thread to path
+// @return true if the file was written
+bool writeChromeTrace(const QString &path);
+
+// Records a span from construction to destruction if tracing is on
+class Span {
+public:
+    Span(const char *name, const char *category, std::int64_t arg = -1) :
+        m_name(name), m_category(category), m_arg(arg), m_active(recording())
+    {
+        if (m_active) {
+            m_start = Clock::now();
+        }
+    }
+
+    ~Span() {
+        if (m_active) {
+            recordSpan(m_name, m_category, m_start, Clock::now(), m_arg, std::move(m_detail));
+        }
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+    void setDetail(std::string detail) {
+        if (m_active) {
+            m_detail = std::move(detail);
+        }
+    }
+
+private:
+    const char *m_name;
+    const char *m_category;
+    std::int64_t m_arg;
+    bool m_active;
+    Clock::time_point m_start;
+    std::string m_detail{};
+};
+
+}
@@ -1,10 +1,56 @@
 #include "texture.h"
 
+#include <QImage>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "stats/perfcounters.h"
+#include "stats/raystats.h"
+#include "stats/tracing.h"
+
+namespace {
+
+// textures are decoded on their own pool so that render threads waiting on a texture never hold up its decoding
+QThreadPool &decodePool() {
+    static QThreadPool pool;
+    return pool;
+}
+
+}
+
 Texture::Texture(std::string filename) {
     m_filename = filename;
+    decode();
+}
+
+Texture::Texture(int width, int height, std::vector<RGBA> pixels) :
+    m_imgData(pixels.begin(), pixels.end()),
+    m_width(width),
+    m_height(height),
+    m_resident(true)
+{}
+
+std::shared_ptr<Texture> Texture::loadAsync(std::string filename) {
+    auto texture = std::make_shared<Texture>();
+    texture->m_filename = filename;
+    texture->m_decoding = QtConcurrent::run(&decodePool(), [texture]() {
+        texture->decode();
+    });
+    return texture;
+}
 
-    // load texture img once into memory
-    const QString file = QString::fromStdString(filename);
+/**
+ * @brief Texture::decode loads the texture img once into memory and marks it as resident. The decode time is added to
+ *          the texture load phase, whether it runs in the background or not.
+ */
+void Texture::decode() {
+    if (Trace::recording()) {
+        Trace::setThreadName("texture decoder");
+    }
+    Trace::Span span("decode texture", "texture");
+    span.setDetail(m_filename);
+    PerfCounters::Scope perf(PerfStage::STAGE_TEXTURE_LOAD);
+    auto start = std::chrono::steady_clock::now();
+    const QString file = QString::fromStdString(m_filename);
     QImage myImage;
     myImage.load(file);
     myImage = myImage.convertToFormat(QImage::Format_RGBX8888);
@@ -17,18 +63,34 @@ Texture::Texture(std::string filename) {
     for (int i = 0; i < arr.size() / 4.f; i++) {
         m_imgData.push_back(RGBA{(std::uint8_t) arr[4*i], (std::uint8_t) arr[4*i+1], (std::uint8_t) arr[4*i+2], (std::uint8_t) arr[4*i+3]});
     }
+    if (RayStats::enabled) {
+        RayStats::addPhaseTime(RenderPhase::PHASE_TEXTURE_LOAD,
+                               std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    m_resident.store(true, std::memory_order_release);
 }
 
 std::string Texture::getFilename() {
     return m_filename;
 };
 
+bool Texture::isResident() const {
+    return m_resident.load(std::memory_order_acquire);
+}
+
+void Texture::waitUntilResident() const {
+    if (!isResident()) {
+        QFuture<void> decoding = m_decoding;
+        decoding.waitForFinished();
+    }
+}
+
 RGBA Texture::getTextureColorAtUV(glm::vec2 UV, int repeatU, int repeatV) {
+    waitUntilResident();
     auto [row, col] = UVtoImgCoord(UV, repeatU, repeatV);
     return m_imgData[row*m_width + col];
 }
 
-
 std::tuple<int, int> Texture::UVtoImgCoord(glm::vec2 UV, int repeatU, int repeatV) {
     float U = UV[0]; 
     float V = UV[1]; 
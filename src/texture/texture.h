@@ -1,20 +1,37 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <vector>
+#include <QFuture>
 #include "utils/rgba.h"
+#include "stats/memstats.h"
 
 class Texture {
 public:
     Texture() = default;
     Texture(std::string filename);
+    // Creates a texture from pixels already in memory (row-major, top row first)
+    Texture(int width, int height, std::vector<RGBA> pixels);
+
+    // Creates a texture whose image is decoded in the background. The texture can be sampled right away;
+    // sampling blocks until the pixels are resident.
+    static std::shared_ptr<Texture> loadAsync(std::string filename);
+
     std::string getFilename();
+    bool isResident() const;
+    void waitUntilResident() const;
     RGBA getTextureColorAtUV(glm::vec2 UV, int repeatU, int repeatV);
     std::tuple<int, int> UVtoImgCoord(glm::vec2 UV, int repeatU, int repeatV);
 private:
-    std::vector<RGBA> m_imgData; // texture img
+    void decode();
+
+    MemoryStats::TrackedVector<RGBA, MemoryCategory::MEM_TEXTURES> m_imgData; // texture img
     int m_width = 0;
     int m_height = 0;
     std::string m_filename;
+    std::atomic<bool> m_resident = false; // true once m_imgData holds the decoded image
+    QFuture<void> m_decoding;
 };
@@ -0,0 +1,93 @@
+#include "rendersettings.h"
+
+#include <iostream>
+#include <QSettings>
+
+void readFeatureSettings(const QSettings &settings, RayTracer::Config &rtConfig, float &lightCutoff) {
+    auto readFlag = [&settings](const char *key, bool &flag) {
+        if (settings.contains(key)) {
+            flag = settings.value(key).toBool();
+        }
+    };
+    auto readCount = [&settings](const char *key, int &count) {
+        if (settings.contains(key)) {
+            count = std::max(0, settings.value(key).toInt());
+        }
+    };
+    auto readAmount = [&settings](const char *key, float &amount) {
+        if (settings.contains(key)) {
+            amount = std::max(0.f, settings.value(key).toFloat());
+        }
+    };
+    readFlag("Feature/shadows",          rtConfig.enableShadow);
+    readFlag("Feature/reflect",          rtConfig.enableReflection);
+    readFlag("Feature/refract",          rtConfig.enableRefraction);
+    readFlag("Feature/texture",          rtConfig.enableTextureMap);
+    readFlag("Feature/texture-filter",   rtConfig.enableTextureFilter);
+    readFlag("Feature/parallel",         rtConfig.enableParallelism);
+    readFlag("Feature/super-sample",     rtConfig.enableSuperSample);
+    readFlag("Feature/acceleration",     rtConfig.enableAcceleration);
+    readFlag("Feature/depthoffield",     rtConfig.enableDepthOfField);
+    readFlag("Feature/deferred-shading", rtConfig.enableDeferredShading);
+    readCount("Feature/threads",          rtConfig.threadCount);
+    readCount("Feature/max-depth",        rtConfig.maxDepth);
+    readAmount("Feature/min-throughput",  rtConfig.minThroughput);
+    readCount("Feature/roulette-depth",   rtConfig.rouletteDepth);
+    readCount("Feature/light-samples",    rtConfig.lightSamples);
+    readCount("Feature/light-candidates", rtConfig.lightCandidates);
+    readAmount("Feature/light-cutoff",    lightCutoff);
+}
+
+RenderSettings loadRenderSettings(const QString &configPath) {
+    QSettings settings( configPath, QSettings::IniFormat );
+    RenderSettings renderSettings{};
+
+    renderSettings.scenePath  = settings.value("IO/scene").toString();
+    renderSettings.outputPath = settings.value("IO/output").toString();
+
+    renderSettings.width  = settings.value("Canvas/width").toInt();
+    renderSettings.height = settings.value("Canvas/height").toInt();
+
+    renderSettings.crop = Tile{0, 0, 0, renderSettings.width, renderSettings.height};
+    if (settings.contains("Canvas/crop")) {
+        QStringList window = settings.value("Canvas/crop").toStringList();
+        int values[4] = {};
+        bool valid = window.size() == 4;
+        for (int i = 0; valid && i < 4; i++) {
+            values[i] = window[i].trimmed().toInt(&valid);
+        }
+        Tile crop{0, values[0], values[1], values[2], values[3]};
+        valid = valid && crop.x >= 0 && crop.y >= 0 && crop.width > 0 && crop.height > 0 &&
+                crop.x + crop.width <= renderSettings.width && crop.y + crop.height <= renderSettings.height;
+        if (valid) {
+            renderSettings.crop = crop;
+        } else {
+            std::cerr << "Warning: ignoring Canvas/crop, expected x, y, width, height inside the canvas" << std::endl;
+        }
+    }
+
+    // missing [Feature] keys keep the defaults of RayTracer::Config, and no light cutoff
+    RayTracer::Config &rtConfig = renderSettings.rtConfig;
+    readFeatureSettings(settings, rtConfig, renderSettings.lightCutoff);
+
+    renderSettings.streaming  = settings.value("Output/streaming", false).toBool();
+    renderSettings.bandHeight = std::max(1, settings.value("Output/band-height", 64).toInt());
+    renderSettings.maxBands   = std::max(1, settings.value("Output/max-bands", 2).toInt());
+
+    ImageWriterOptions &imageOptions = renderSettings.imageOptions;
+    imageOptions.toneMap.op       = toneMapOperatorFromName(settings.value("Output/tonemap", "clamp").toString().toStdString());
+    imageOptions.toneMap.exposure = settings.value("Output/exposure", 0).toFloat();
+    imageOptions.pngLevel         = std::clamp(settings.value("Output/png-level", 6).toInt(), 0, 9);
+    rtConfig.costMetric           = costMetricFromName(settings.value("Output/heatmap", "none").toString().toStdString());
+
+    renderSettings.sequence = settings.value("Sequence/enabled", false).toBool();
+
+    renderSettings.distributed     = settings.value("Distributed/enabled", false).toBool();
+    renderSettings.host            = settings.value("Distributed/host", "127.0.0.1").toString();
+    renderSettings.port            = settings.value("Distributed/port", 0).toInt();
+    renderSettings.localWorkers    = settings.value("Distributed/local-workers", 4).toInt();
+    renderSettings.tileSize        = settings.value("Distributed/tile-size", 64).toInt();
+    renderSettings.tileTimeoutSecs = settings.value("Distributed/tile-timeout", 60).toInt();
+
+    return renderSettings;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QSettings>
+#include <QString>
+#include "raytracer/raytracer.h"
+#include "raytracer/tile.h"
+#include "output/imagestreamwriter.h"
+
+// Struct which contains everything read from a config (.ini) file that is needed to render a scene
+struct RenderSettings {
+    QString scenePath;  // [IO] scene
+    QString outputPath; // [IO] output
+
+    int width;          // [Canvas] width
+    int height;         // [Canvas] height
+    Tile crop;          // [Canvas] crop = x, y, width, height: the part of the canvas to render and save (the whole canvas by default)
+
+    RayTracer::Config rtConfig; // [Feature] flags
+    float lightCutoff;          // [Feature] light-cutoff: lights are skipped where they'd add less than this (0 keeps every light)
+
+    // [Output] streaming options
+    bool streaming;       // write the image to disk band by band instead of holding all of it in memory
+    int bandHeight;       // rows of pixels per band
+    int maxBands;         // bands held in memory at once
+    ImageWriterOptions imageOptions; // [Output] tonemap, exposure and png-level
+    // [Output] heatmap (time, rays or intersections) is stored in rtConfig.costMetric
+
+    bool sequence;        // [Sequence] enabled: render the frames described in the [Sequence] section (see sequence.h)
+
+    // [Distributed] coordinator options
+    bool distributed;
+    QString host;         // address the coordinator listens on
+    int port;             // 0 lets the OS pick a free port
+    int localWorkers;     // number of worker processes to spawn on this machine
+    int tileSize;         // side length of a tile handed to a worker, in pixels
+    int tileTimeoutSecs;  // a tile is reassigned if its worker has not returned it after this long
+};
+
+// Reads the config file at the given path. Missing values fall back to their defaults.
+RenderSettings loadRenderSettings(const QString &configPath);
+
+// Overwrites the [Feature] values present in settings; missing keys keep the values rtConfig and lightCutoff already
+// hold. loadRenderSettings applies it to the defaults, sequences to the base config's values for each override file.
+void readFeatureSettings(const QSettings &settings, RayTracer::Config &rtConfig, float &lightCutoff);
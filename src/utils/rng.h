@@ -0,0 +1,46 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+// A small, fast random number generator (PCG32) for stochastic shading. Generators are seeded from what is being
+// shaded (pixel coordinates, hit positions, frame numbers) rather than from shared state, so renders are repeatable
+// no matter how pixels are distributed over threads.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed) :
+        m_state(0)
+    {
+        next();
+        m_state += seed;
+        next();
+    }
+
+    std::uint32_t next() {
+        std::uint64_t old = m_state;
+        m_state = old * 6364136223846793005ull + 1442695040888963407ull;
+        std::uint32_t xorShifted = std::uint32_t(((old >> 18) ^ old) >> 27);
+        std::uint32_t rotation = std::uint32_t(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    // uniform in [0, 1)
+    float nextFloat() {
+        return float(next() >> 8) * (1.f / 16777216.f);
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+// Mixes value into seed (splitmix64 finalizer), for building seeds out of several coordinates
+inline std::uint64_t hashSeed(std::uint64_t seed, std::uint64_t value) {
+    std::uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline std::uint64_t hashSeed(std::uint64_t seed, float value) {
+    return hashSeed(seed, std::uint64_t(std::bit_cast<std::uint32_t>(value)));
+}
@@ -141,10 +141,32 @@ bool ScenefileReader::readXML() {
        childNode = childNode.nextSibling();
    }
 
+   m_memory = MemoryStats::Allocation(MemoryCategory::MEM_SCENE_GRAPH, sceneGraphBytes());
    std::cout << "Finished reading " << file_name << std::endl;
    return true;
 }
 
+/**
+ * @brief ScenefileReader::sceneGraphBytes estimates the heap memory held by the parsed scene graph: every node with
+ *        its transformations and primitives, the lights, and the pointer arrays holding them
+ */
+std::size_t ScenefileReader::sceneGraphBytes() const {
+   std::size_t bytes = m_nodes.capacity() * sizeof(SceneNode*) + m_lights.capacity() * sizeof(SceneLightData*) +
+                       m_lights.size() * sizeof(SceneLightData);
+   for (const SceneNode *node : m_nodes) {
+       bytes += sizeof(SceneNode) + node->children.capacity() * sizeof(SceneNode*) +
+                node->transformations.capacity() * sizeof(SceneTransformation*) +
+                node->transformations.size() * sizeof(SceneTransformation) +
+                node->primitives.capacity() * sizeof(ScenePrimitive*);
+       for (const ScenePrimitive *primitive : node->primitives) {
+           bytes += sizeof(ScenePrimitive) + MemoryStats::heapBytes(primitive->meshfile) +
+                    MemoryStats::heapBytes(primitive->material.textureMap.filename) +
+                    MemoryStats::heapBytes(primitive->material.bumpMap.filename);
+       }
+   }
+   return bytes;
+}
+
 /**
 * Helper function to parse a single value, the name of which is stored in
 * name.  For example, to parse <length v="0"/>, name would need to be "v".
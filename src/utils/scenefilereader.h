@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scenedata.h"
+#include "stats/memstats.h"
 
 #include <vector>
 #include <map>
@@ -36,6 +37,7 @@ private:
     bool parseObjectData(const QDomElement &object);
     bool parseTransBlock(const QDomElement &transblock, SceneNode* node);
     bool parsePrimitive(const QDomElement &prim, SceneNode* node);
+    std::size_t sceneGraphBytes() const;
 
     std::string file_name;
     mutable std::map<std::string, SceneNode*> m_objects;
@@ -43,4 +45,5 @@ private:
     SceneCameraData m_cameraData;
     std::vector<SceneLightData*> m_lights;
     std::vector<SceneNode*> m_nodes;
+    MemoryStats::Allocation m_memory; // the nodes, transformations, primitives and lights above
 };
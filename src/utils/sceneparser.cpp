@@ -28,7 +28,7 @@ bool SceneParser::parse(std::string filepath, RenderData &renderData) {
 }
 
 // depth-first tree traversal: populates the RenderShapeData list in-place
-void SceneParser::calculateCTM(glm::mat4& parentCTM, SceneNode* currNode, std::vector<RenderShapeData>& renderShapesList) {
+void SceneParser::calculateCTM(glm::mat4& parentCTM, SceneNode* currNode, RenderShapeList& renderShapesList) {
     // general case: the CTM of currNode is the product of its parent's CTM and currNode's local tranformation(s)
     glm::mat4 currCTM = parentCTM; // store copy of parent CTM
     glm::mat4 currTransformMatrix = glm::mat4(); // will be initialized during loop
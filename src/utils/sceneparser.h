@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scenedata.h"
+#include "stats/memstats.h"
 #include <vector>
 #include <string>
 
@@ -10,13 +11,15 @@ struct RenderShapeData {
     glm::mat4 ctm; // the cumulative transformation matrix
 };
 
+using RenderShapeList = MemoryStats::TrackedVector<RenderShapeData, MemoryCategory::MEM_RENDER_SHAPES>;
+
 // Struct which contains all the data needed to render a scene
 struct RenderData {
     SceneGlobalData globalData;
     SceneCameraData cameraData;
 
     std::vector<SceneLightData> lights;
-    std::vector<RenderShapeData> shapes;
+    RenderShapeList shapes;
 };
 
 class SceneParser {
@@ -30,6 +33,6 @@ public:
     // helpers
 
     // recursive fn to add the current node to the render data list along with its CTM by multiplying the current CTM with the node's local transformation
-    static void calculateCTM(glm::mat4& parentCTM, SceneNode* currNode, std::vector<RenderShapeData>& renderShapesList);
+    static void calculateCTM(glm::mat4& parentCTM, SceneNode* currNode, RenderShapeList& renderShapesList);
 };
 
@@ -0,0 +1,330 @@
+// Procedural scene generator for scalability benchmarks. Writes a scene file in the XML format of scenefiles/xml with a
+// chosen number of primitives, mix of primitive types, spatial distribution, lights, reflectivity and texturing.
+// Generated scenes can be rendered directly or benchmarked with raytracer_renderbench --scenes <dir>.
+//
+// usage: raytracer_scenegen --output <file.xml> [--count <n>] [--mix sphere=1,cube=1,cone=1,cylinder=1]
+//                           [--distribution uniform|clustered|nested] [--lights <n>] [--reflective <fraction>]
+//                           [--reflectivity <0..1>] [--textured <fraction>] [--texture <image>] [--seed <n>]
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef RAYTRACER_SOURCE_DIR
+#define RAYTRACER_SOURCE_DIR "."
+#endif
+
+namespace {
+
+enum class Distribution {
+    UNIFORM,   // scattered evenly through a cube
+    CLUSTERED, // gathered in tight Gaussian clusters with empty space between them
+    NESTED     // recursive groups of 8 inside nested <object type="tree"> blocks, so transforms compose at every level
+};
+
+struct GeneratorOptions {
+    std::string outputPath;
+    long long count = 1000;
+    double mix[4] = {1, 1, 1, 1}; // relative weights of sphere, cube, cone, cylinder
+    Distribution distribution = Distribution::UNIFORM;
+    int lights = 4;
+    double reflectiveFraction = 0.2;
+    double reflectivity = 0.5;
+    double texturedFraction = 0;
+    std::string texturePath = RAYTRACER_SOURCE_DIR "/scenefiles/image/check.png";
+    unsigned seed = 1;
+};
+
+const char *primitiveNames[4] = {"sphere", "cube", "cone", "cylinder"};
+
+class SceneGenerator {
+public:
+    SceneGenerator(const GeneratorOptions &options, std::ostream &out) :
+        m_options(options),
+        m_out(out),
+        m_rng(options.seed),
+        m_typeDistribution(std::begin(options.mix), std::end(options.mix)),
+        // primitives are about a unit wide; spacing them ~2 units apart keeps the density independent of the count
+        m_extent(2.0 * std::cbrt(double(std::max(1LL, options.count))))
+    {}
+
+    void write();
+
+private:
+    double uniform(double min, double max) { return std::uniform_real_distribution<double>(min, max)(m_rng); }
+    bool chance(double probability) { return uniform(0, 1) < probability; }
+
+    void writeGlobalData();
+    void writeCamera();
+    void writeLights();
+    void writePrimitive(double x, double y, double z, double scale, const std::string &indent);
+    void writeUniform();
+    void writeClustered();
+    void writeNested(long long count, const std::string &indent);
+
+    const GeneratorOptions &m_options;
+    std::ostream &m_out;
+    std::mt19937_64 m_rng;
+    std::discrete_distribution<int> m_typeDistribution;
+    double m_extent; // side length of the cube containing the scene
+};
+
+void SceneGenerator::write() {
+    m_out << "<scenefile>\n";
+    writeGlobalData();
+    writeCamera();
+    writeLights();
+    m_out << "\t<object type=\"tree\" name=\"root\">\n";
+    switch (m_options.distribution) {
+        case Distribution::UNIFORM:
+            writeUniform();
+            break;
+        case Distribution::CLUSTERED:
+            writeClustered();
+            break;
+        case Distribution::NESTED:
+            // the nested groups fill [-1,1]^3; scale them up to the scene extent
+            m_out << "\t\t<transblock>\n"
+                  << "\t\t\t<scale x=\"" << m_extent / 2 << "\" y=\"" << m_extent / 2 << "\" z=\"" << m_extent / 2 << "\"/>\n"
+                  << "\t\t\t<object type=\"tree\">\n";
+            writeNested(m_options.count, "\t\t\t\t");
+            m_out << "\t\t\t</object>\n"
+                  << "\t\t</transblock>\n";
+            break;
+    }
+    m_out << "\t</object>\n"
+          << "</scenefile>\n";
+}
+
+void SceneGenerator::writeGlobalData() {
+    m_out << "\t<globaldata>\n"
+          << "\t\t<diffusecoeff v=\"0.5\"/>\n"
+          << "\t\t<specularcoeff v=\"0.5\"/>\n"
+          << "\t\t<ambientcoeff v=\"0.5\"/>\n"
+          << "\t</globaldata>\n\n";
+}
+
+void SceneGenerator::writeCamera() {
+    // look at the center of the scene from far enough away to see all of it
+    double distance = 1.2 * m_extent;
+    m_out << "\t<cameradata>\n"
+          << "\t\t<pos x=\"" << distance << "\" y=\"" << 0.8 * distance << "\" z=\"" << distance << "\"/>\n"
+          << "\t\t<up x=\"0\" y=\"1\" z=\"0\"/>\n"
+          << "\t\t<focus x=\"0\" y=\"0\" z=\"0\"/>\n"
+          << "\t\t<heightangle v=\"45\"/>\n"
+          << "\t</cameradata>\n\n";
+}
+
+void SceneGenerator::writeLights() {
+    // point, directional and spot lights in turn; their total intensity stays roughly constant as the count grows
+    const char *types[3] = {"point", "directional", "spot"};
+    double intensity = 1.5 / std::max(1, m_options.lights);
+    for (int i = 0; i < m_options.lights; i++) {
+        const char *type = types[i % 3];
+        double x = uniform(-m_extent, m_extent);
+        double y = uniform(0.75, 1.25) * m_extent;
+        double z = uniform(-m_extent, m_extent);
+        m_out << "\t<lightdata>\n"
+              << "\t\t<id v=\"" << i << "\"/>\n"
+              << "\t\t<type v=\"" << type << "\"/>\n"
+              << "\t\t<color r=\"" << intensity * uniform(0.5, 1) << "\" g=\"" << intensity * uniform(0.5, 1)
+              << "\" b=\"" << intensity * uniform(0.5, 1) << "\"/>\n";
+        if (std::strcmp(type, "directional") != 0) {
+            m_out << "\t\t<function v1=\"1\" v2=\"0\" v3=\"0\"/>\n"
+                  << "\t\t<position x=\"" << x << "\" y=\"" << y << "\" z=\"" << z << "\"/>\n";
+        }
+        if (std::strcmp(type, "point") != 0) {
+            // aim at the center of the scene
+            m_out << "\t\t<direction x=\"" << -x << "\" y=\"" << -y << "\" z=\"" << -z << "\"/>\n";
+        }
+        if (std::strcmp(type, "spot") == 0) {
+            m_out << "\t\t<angle v=\"30\"/>\n"
+                  << "\t\t<penumbra v=\"10\"/>\n";
+        }
+        m_out << "\t</lightdata>\n\n";
+    }
+}
+
+/**
+ * @brief SceneGenerator::writePrimitive writes one randomly oriented primitive of a random type and material
+ * @param scale approximate size of the primitive
+ */
+void SceneGenerator::writePrimitive(double x, double y, double z, double scale, const std::string &indent) {
+    int type = m_typeDistribution(m_rng);
+    m_out << indent << "<transblock>\n"
+          << indent << "\t<translate x=\"" << x << "\" y=\"" << y << "\" z=\"" << z << "\"/>\n"
+          << indent << "\t<rotate x=\"" << uniform(-1, 1) << "\" y=\"" << uniform(-1, 1) << "\" z=\"" << uniform(-1, 1)
+          << "\" angle=\"" << uniform(0, 360) << "\"/>\n"
+          << indent << "\t<scale x=\"" << scale * uniform(0.6, 1) << "\" y=\"" << scale * uniform(0.6, 1)
+          << "\" z=\"" << scale * uniform(0.6, 1) << "\"/>\n"
+          << indent << "\t<object type=\"primitive\" name=\"" << primitiveNames[type] << "\">\n"
+          << indent << "\t\t<diffuse r=\"" << uniform(0.2, 1) << "\" g=\"" << uniform(0.2, 1) << "\" b=\"" << uniform(0.2, 1) << "\"/>\n"
+          << indent << "\t\t<specular r=\"1\" g=\"1\" b=\"1\"/>\n"
+          << indent << "\t\t<shininess v=\"" << int(uniform(5, 50)) << "\"/>\n";
+    if (chance(m_options.reflectiveFraction)) {
+        double r = m_options.reflectivity;
+        m_out << indent << "\t\t<reflective r=\"" << r << "\" g=\"" << r << "\" b=\"" << r << "\"/>\n";
+    }
+    if (chance(m_options.texturedFraction)) {
+        m_out << indent << "\t\t<texture file=\"" << m_options.texturePath << "\" u=\"1\" v=\"1\"/>\n"
+              << indent << "\t\t<blend v=\"0.5\"/>\n";
+    }
+    m_out << indent << "\t</object>\n"
+          << indent << "</transblock>\n";
+}
+
+void SceneGenerator::writeUniform() {
+    double half = m_extent / 2;
+    for (long long i = 0; i < m_options.count; i++) {
+        writePrimitive(uniform(-half, half), uniform(-half, half), uniform(-half, half), 1, "\t\t");
+    }
+}
+
+void SceneGenerator::writeClustered() {
+    // about 100 primitives per cluster, packed 4 times more densely than the uniform distribution
+    long long clusterCount = std::max(1LL, m_options.count / 100);
+    double half = m_extent / 2;
+    double spread = 0.25 * m_extent / std::cbrt(double(clusterCount));
+    std::vector<std::array<double, 3>> centers(clusterCount);
+    for (auto &center : centers) {
+        center = {uniform(-half, half), uniform(-half, half), uniform(-half, half)};
+    }
+    std::normal_distribution<double> offset(0, spread);
+    for (long long i = 0; i < m_options.count; i++) {
+        const auto &center = centers[i % clusterCount];
+        writePrimitive(center[0] + offset(m_rng), center[1] + offset(m_rng), center[2] + offset(m_rng), 1, "\t\t");
+    }
+}
+
+/**
+ * @brief SceneGenerator::writeNested writes count primitives inside [-1,1]^3. Groups of more than 8 are split into 8
+ *          subgroups, each in its own transformed tree that is shrunk into one octant of the parent.
+ */
+void SceneGenerator::writeNested(long long count, const std::string &indent) {
+    if (count <= 8) {
+        for (long long i = 0; i < count; i++) {
+            writePrimitive(uniform(-0.6, 0.6), uniform(-0.6, 0.6), uniform(-0.6, 0.6), 0.6, indent);
+        }
+        return;
+    }
+    for (int octant = 0; octant < 8; octant++) {
+        long long childCount = count / 8 + (octant < count % 8);
+        double x = (octant & 1) ? 0.5 : -0.5;
+        double y = (octant & 2) ? 0.5 : -0.5;
+        double z = (octant & 4) ? 0.5 : -0.5;
+        m_out << indent << "<transblock>\n"
+              << indent << "\t<translate x=\"" << x << "\" y=\"" << y << "\" z=\"" << z << "\"/>\n"
+              << indent << "\t<rotate x=\"0\" y=\"1\" z=\"0\" angle=\"" << uniform(0, 90) << "\"/>\n"
+              << indent << "\t<scale x=\"0.45\" y=\"0.45\" z=\"0.45\"/>\n"
+              << indent << "\t<object type=\"tree\">\n";
+        writeNested(childCount, indent + "\t\t");
+        m_out << indent << "\t</object>\n"
+              << indent << "</transblock>\n";
+    }
+}
+
+/**
+ * @brief parseMix reads weights such as "sphere=2,cube=1". Types that are not listed get weight 0.
+ */
+bool parseMix(const std::string &text, double mix[4]) {
+    std::fill(mix, mix + 4, 0.0);
+    std::size_t start = 0;
+    while (start < text.size()) {
+        std::size_t end = text.find(',', start);
+        std::string entry = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        std::size_t equals = entry.find('=');
+        std::string name = entry.substr(0, equals);
+        double weight = equals == std::string::npos ? 1 : std::atof(entry.c_str() + equals + 1);
+        auto found = std::find(std::begin(primitiveNames), std::end(primitiveNames), name);
+        if (found == std::end(primitiveNames) || weight < 0) {
+            return false;
+        }
+        mix[found - std::begin(primitiveNames)] = weight;
+        start = (end == std::string::npos) ? text.size() : end + 1;
+    }
+    return mix[0] + mix[1] + mix[2] + mix[3] > 0;
+}
+
+void printUsage() {
+    std::cerr << "usage: raytracer_scenegen --output <file.xml> [--count <n>] [--mix sphere=1,cube=1,cone=1,cylinder=1]\n"
+                 "                          [--distribution uniform|clustered|nested] [--lights <n>] [--reflective <fraction>]\n"
+                 "                          [--reflectivity <0..1>] [--textured <fraction>] [--texture <image>] [--seed <n>]"
+              << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    GeneratorOptions options{};
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--output") {
+            options.outputPath = value;
+        } else if (option == "--count") {
+            options.count = std::atoll(value.c_str());
+        } else if (option == "--mix") {
+            if (!parseMix(value, options.mix)) {
+                std::cerr << "Error: invalid --mix \"" << value << "\"" << std::endl;
+                return 1;
+            }
+        } else if (option == "--distribution") {
+            if (value == "uniform") {
+                options.distribution = Distribution::UNIFORM;
+            } else if (value == "clustered") {
+                options.distribution = Distribution::CLUSTERED;
+            } else if (value == "nested") {
+                options.distribution = Distribution::NESTED;
+            } else {
+                std::cerr << "Error: unknown distribution \"" << value << "\"" << std::endl;
+                return 1;
+            }
+        } else if (option == "--lights") {
+            options.lights = std::max(0, std::atoi(value.c_str()));
+        } else if (option == "--reflective") {
+            options.reflectiveFraction = std::atof(value.c_str());
+        } else if (option == "--reflectivity") {
+            options.reflectivity = std::atof(value.c_str());
+        } else if (option == "--textured") {
+            options.texturedFraction = std::atof(value.c_str());
+        } else if (option == "--texture") {
+            options.texturePath = value;
+        } else if (option == "--seed") {
+            options.seed = unsigned(std::atoll(value.c_str()));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (options.outputPath.empty() || options.count < 1) {
+        printUsage();
+        return 1;
+    }
+
+    std::ofstream out(options.outputPath);
+    if (!out) {
+        std::cerr << "Error: cannot write \"" << options.outputPath << "\"" << std::endl;
+        return 1;
+    }
+    out.precision(5);
+    SceneGenerator(options, out).write();
+    out.flush();
+    if (!out) {
+        std::cerr << "Error: failed to write \"" << options.outputPath << "\"" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << options.count << " primitives and " << options.lights << " lights to \""
+              << options.outputPath << "\"" << std::endl;
+    return 0;
+}